@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <cstdint>
+#include "decoder.hpp"
+
+namespace LightVideoDecoder
+{
+  class BatchDecoderPrivate;
+
+  struct DecodedFrame
+  {
+    uint32_t frameNumber;
+    std::vector<ImageChannel<uint8_t>> channelList;
+  };
+
+  /*
+    Decodes a whole video on the CPU without an OpenGL context.
+    The video is split into segments at key frames, every segment is decoded by its own worker with its own reference state,
+    and frames are delivered in order on the calling thread.
+    Workers decode ahead of delivery until a frame budget of a few frames per thread, counted across all segments, is used up.
+  */
+  class BatchDecoder final
+  {
+  public:
+    typedef Decoder::ReadFunc ReadFunc;
+    typedef Decoder::SeekFunc SeekFunc;
+    typedef Decoder::PosFunc PosFunc;
+    typedef std::function<void(const DecodedFrame&)> FrameFunc;
+
+    BatchDecoder(ReadFunc readFunc, SeekFunc seekFunc, PosFunc posFunc, uint32_t threadCount = 0);
+    ~BatchDecoder();
+
+    /* property getter */
+    uint32_t width() const;
+    uint32_t height() const;
+    uint32_t framerate() const;
+    uint32_t frameCount() const;
+    ColorFormat colorFormat() const;
+    uint8_t formatVersion() const;
+
+    double duration() const;
+    uint32_t channelCount() const;
+    uint32_t threadCount() const;
+    uint32_t segmentCount() const;
+
+    /* method */
+    void decode(FrameFunc frameFunc);
+
+    // see Decoder::setChannelMask, channels outside the mask are left undefined in DecodedFrame
+    void setChannelMask(uint32_t mask);
+    uint32_t channelMask() const;
+
+  private:
+    BatchDecoderPrivate *m_dptr;
+  };
+} // namespace LightVideoDecoder
\ No newline at end of file
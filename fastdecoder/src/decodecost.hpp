@@ -0,0 +1,31 @@
+#pragma once
+
+#include "struct.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace LightVideoDecoder
+{
+  /*
+    Nanoseconds the CPU stages of decoding a frame take on this machine, per sample, byte or block.
+    The encoder keeps its own copy of this struct, a model measured on the weakest player is handed to it by toDecodeCostModel().
+  */
+  struct DecodeCostModel
+  {
+    float intraCost[_INTRAPREDICTMODE_ENUM_MAX]; // defilterIntra() per sample, indexed by IntraPredictMode
+    float deltaCost; // adding the reference per sample
+    float motionCost; // adding the reference through a global motion per sample
+    float decompressCost; // LZ4 decompression per uncompressed byte
+    float blockCost; // defiltering a 16 x 16 block of a skip map frame on its own, on top of its samples
+  };
+
+  static_assert(sizeof(DecodeCostModel) == 36, "DecodeCostModel layout changed.");
+  static_assert(offsetof(DecodeCostModel, deltaCost) == 20 && offsetof(DecodeCostModel, motionCost) == 24 && offsetof(DecodeCostModel, decompressCost) == 28 &&
+    offsetof(DecodeCostModel, blockCost) == 32, "DecodeCostModel layout changed.");
+
+  /*
+    Times the kernels frames are decoded with on a width x height plane of synthetic content, the best of nRun runs each.
+    Runs on the calling thread for a few times nRun frame decodes.
+  */
+  DecodeCostModel measureDecodeCost(uint32_t width, uint32_t height, uint32_t nRun = 5);
+} // namespace LightVideoDecoder
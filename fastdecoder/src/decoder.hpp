@@ -10,6 +10,35 @@ namespace LightVideoDecoder
 {
   class DecoderPrivate;
 
+  /* bit i selects channel i of ColorFormatInfo::channelList */
+  enum ChannelMask : uint32_t
+  {
+    LumaChannel = 0x1,
+    ChromaChannel = 0x6,
+    AlphaChannel = 0x8,
+    AllChannel = 0xFF
+  };
+
+  struct FrameCacheStats
+  {
+    uint64_t hitCount, missCount;
+    uint64_t usedBytes, budgetBytes;
+    uint32_t frameCount;
+  };
+
+  enum PacketMode : uint8_t
+  {
+    BufferedPacket = 0x0, // a packet is decompressed as a whole when it is loaded
+    StreamedPacket // a packet is decompressed one frame at a time, memory doesn't grow with maxPacketSize
+  };
+
+  enum OutputScale : uint8_t
+  {
+    FullScale = 0x0,
+    HalfScale,
+    QuarterScale
+  };
+
   class Decoder final
   {
   public:
@@ -17,7 +46,12 @@ namespace LightVideoDecoder
     typedef std::function<void(int64_t)> SeekFunc;
     typedef std::function<void()> PosFunc;
 
-    Decoder(ReadFunc readFunc, SeekFunc seekFunc, PosFunc posFunc);
+    /*
+      StreamedPacket reads and decompresses each frame on demand and keeps only a few frames resident,
+      which opens streams whose packets are too large to buffer and returns the first frame of a packet early.
+      Seeking back inside a packet decompresses it again from its start.
+    */
+    Decoder(ReadFunc readFunc, SeekFunc seekFunc, PosFunc posFunc, PacketMode packetMode = BufferedPacket);
     ~Decoder();
 
     /* property getter */
@@ -27,16 +61,58 @@ namespace LightVideoDecoder
     uint32_t frameCount() const;
     ColorFormat colorFormat() const;
     uint8_t formatVersion() const;
+    PacketMode packetMode() const;
+    // 0 for untiled streams, in both packet modes tiles outside the region of interest are neither decompressed nor defiltered
+    uint32_t tileWidth() const;
+    uint32_t tileHeight() const;
 
     double duration() const;
     uint32_t channelCount() const;
+    // each slot keeps one more reference frame resident
+    uint32_t longTermSlotCount() const;
 
     /* method */
     void seekFrame(uint32_t pos);
     void nextFrame();
     void decodeCurrentFrame();
 
+    /*
+      Channels outside the mask are neither defiltered nor uploaded, their texture content is undefined.
+      Removing channels takes effect immediately, adding channels takes effect at the next full frame.
+    */
+    void setChannelMask(uint32_t mask);
+    uint32_t channelMask() const;
+
+    /*
+      Only the given rectangle is reconstructed and the textures shrink to its size.
+      The rectangle is expanded to even bounds and takes effect at the next full frame, since reference frames are kept at its size.
+    */
+    void setRegionOfInterest(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+    void resetRegionOfInterest();
+
+    /*
+      Reduced outputs are box filtered on the CPU and only the small planes are uploaded.
+      Reference frames stay at region size, the scale takes effect at the next full frame.
+    */
+    void setOutputScale(OutputScale scale);
+    OutputScale outputScale() const;
+
+    /*
+      Keeps decoded frames as textures up to budget bytes, 0 disables the cache.
+      While it is enabled any frame can be seeked to. Cached frames are served without reading or decoding anything,
+      other frames are decoded from the closest key frame. Key frames are never evicted.
+      Changing the channel mask, the region or the output scale clears the cache.
+    */
+    void setFrameCacheBudget(uint64_t budget);
+    FrameCacheStats frameCacheStats() const;
+
     /* status getter */
+    // origin of the decoded region in luma samples and the size of the FS texture
+    uint32_t outputX() const;
+    uint32_t outputY() const;
+    uint32_t outputWidth() const;
+    uint32_t outputHeight() const;
+
     uint32_t currentFrameNumber() const;
     bool isCurrentFrameDecoded() const;
 
@@ -47,6 +123,14 @@ namespace LightVideoDecoder
     /* func */
     void loadPacket();
     void loadFrame();
+    void loadNextFrame();
+    void rewindPacket(uint32_t frameIndex);
+    void decompressPacketRange(uint32_t begin, uint32_t end);
+    void decodeLoadedFrame();
+    void restoreSlot(uint32_t slot, uint32_t pos);
+    void seekKeyFrame(uint32_t pos);
+    void decodeCachedFrame();
+    void invalidateFrameCache();
     ReadFunc m_read;
     SeekFunc m_seek;
     PosFunc m_pos;
@@ -54,16 +138,20 @@ namespace LightVideoDecoder
     /* info */
     MainStruct m_mainStruct;
     ColorFormatInfo m_colorFormatInfo;
+    PacketMode m_packetMode;
     
     /* status */
     VideoFramePacket m_currentPacket;
     VideoFrameStruct m_currentFrameStruct;
     uint32_t m_currentFrameNumber, m_prevFullFrameNumber;
+    uint32_t m_packetFrameIndex; // frames of the current packet loaded so far
     bool m_packetLoaded, m_frameLoaded, m_currentFrameDecoded;
 
     /* buffer */
-    char *m_compressedDataBuffer, *m_uncompressedDataBuffer, *m_frameDataBuffer;
+    char *m_compressedDataBuffer, *m_uncompressedDataBuffer;
+    const char *m_frameDataBuffer;
     uint32_t m_uncompressedDataBufferPos;
+    int64_t m_nextPacketOffset;
 
     /* private */
     DecoderPrivate *m_dptr;
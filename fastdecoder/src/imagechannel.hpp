@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <utility>
+#include <algorithm>
 #include "util.hpp"
 
 namespace LightVideoDecoder
@@ -30,7 +32,7 @@ namespace LightVideoDecoder
     { *this = other; }
 
     constexpr ImageChannel(ImageChannel &&other) : ImageChannel()
-    { *this = other; }
+    { *this = std::move(other); }
 
     inline ~ImageChannel()
     {
@@ -0,0 +1,391 @@
+#include "batchdecoder_p.hpp"
+#include "../error.hpp"
+#include "util_p.hpp"
+#include "tile_p.hpp"
+#include "longterm_p.hpp"
+#include <thread>
+
+namespace LightVideoDecoder
+{
+  // decoded frames waiting for delivery across all segments, so workers can run ahead of the segment being delivered
+  constexpr static uint32_t queuedFramePerThread = 8;
+  constexpr static uint32_t segmentPerThread = 4;
+
+  BatchDecoderPrivate::BatchDecoderPrivate(BatchDecoder::ReadFunc readFunc, BatchDecoder::SeekFunc seekFunc, BatchDecoder::PosFunc posFunc, uint32_t threadCount)
+    : m_read(readFunc), m_seek(seekFunc), m_pos(posFunc),
+    m_mainStruct({0}), m_colorFormatInfo({0}), m_nThread(threadCount), m_channelMask(AllChannel),
+    m_maxCompressedPacketDataSize(0), m_maxUncompressedPacketDataSize(0),
+    m_maxQueuedFrame(0), m_nQueuedFrame(0), m_deliveringSegment(0), m_nextSegment(0), m_aborted(false)
+  {
+    lvdAssert(readFunc && seekFunc && posFunc);
+    if(m_nThread == 0)
+      m_nThread = std::max(1U, std::thread::hardware_concurrency());
+    m_maxQueuedFrame = m_nThread * queuedFramePerThread;
+
+    m_seek(0);
+    m_read(reinterpret_cast<char*>(&m_mainStruct), sizeof(MainStruct));
+    if(!verifyMainStruct(m_mainStruct))
+      throw DataError("Video main structure is broken.");
+    m_colorFormatInfo = getColorFormatInfo(m_mainStruct.colorFormat, m_mainStruct.width, m_mainStruct.height);
+
+    uint64_t maxUncompressedPacketDataSize = static_cast<uint64_t>(getMaxFrameRecordSize(m_mainStruct, m_colorFormatInfo)) * m_mainStruct.maxPacketSize;
+    if(maxUncompressedPacketDataSize > 0x7E000000 || maxUncompressedPacketDataSize == 0)
+      throw DataError("Uncompressed packet size is too large.");
+    m_maxUncompressedPacketDataSize = static_cast<int>(maxUncompressedPacketDataSize);
+    m_maxCompressedPacketDataSize = static_cast<int>(getMaxCompressedPacketSize(m_maxUncompressedPacketDataSize));
+
+    m_packetIndex = scanPacketIndex(m_mainStruct, m_read, m_seek);
+    m_seek(0);
+
+    // cut segments only in front of packets which contain a key frame, so every segment owns at least one decode chain
+    uint32_t nPacket = static_cast<uint32_t>(m_packetIndex.size());
+    uint32_t targetSegmentSize = std::max(1U, m_mainStruct.nFrame / (m_nThread * segmentPerThread));
+    uint32_t segmentBeginFrame = 0;
+    m_segmentList.push_back({0, nPacket});
+    for(uint32_t iPacket = 1; iPacket < nPacket; ++iPacket)
+    {
+      const PacketIndexEntry &entry = m_packetIndex[iPacket];
+      if(entry.vfpk.nFullFrame > 0 && entry.firstFrame - segmentBeginFrame >= targetSegmentSize)
+      {
+        m_segmentList.back().endPacket = iPacket;
+        m_segmentList.push_back({iPacket, nPacket});
+        segmentBeginFrame = entry.firstFrame;
+      }
+    }
+  }
+
+  BatchDecoderPrivate::~BatchDecoderPrivate()
+  {}
+
+  void BatchDecoderPrivate::reset()
+  {
+    std::unique_lock<std::mutex> locker(m_queueLock);
+    for(DecodeSegmentState &state : m_segmentStateList)
+    {
+      for(std::unique_ptr<DecodedFrame> &frame : state.frameQueue)
+        m_freeFrameList.push_back(std::move(frame));
+    }
+    m_segmentStateList = std::vector<DecodeSegmentState>(m_segmentList.size());
+    for(DecodeSegmentState &state : m_segmentStateList)
+      state.finished = false;
+    m_error = nullptr;
+    m_nQueuedFrame = 0;
+    m_deliveringSegment = 0;
+    m_nextSegment = 0;
+    m_aborted = false;
+  }
+
+  void BatchDecoderPrivate::abort()
+  {
+    std::unique_lock<std::mutex> locker(m_queueLock);
+    m_aborted = true;
+    m_queueNotFull.notify_all();
+    m_frameReady.notify_all();
+  }
+
+  void BatchDecoderPrivate::work()
+  {
+    char *compressedDataBuffer = nullptr, *uncompressedDataBuffer = nullptr;
+    try
+    {
+      compressedDataBuffer = LVDALLOC(char, m_maxCompressedPacketDataSize);
+      uncompressedDataBuffer = LVDALLOC(char, m_maxUncompressedPacketDataSize);
+      FrameReconstructor<uint8_t> reconstructor(m_mainStruct, m_colorFormatInfo);
+      SkipMap skipMap(m_mainStruct, m_colorFormatInfo);
+      while(true)
+      {
+        uint32_t iSegment;
+        {
+          std::unique_lock<std::mutex> locker(m_queueLock);
+          if(m_aborted || m_nextSegment >= m_segmentList.size())
+            break;
+          iSegment = m_nextSegment++;
+        }
+        reconstructor.reset();
+        decodeSegment(iSegment, reconstructor, skipMap, compressedDataBuffer, uncompressedDataBuffer);
+      }
+    }
+    catch(...)
+    {
+      critical("Batch decoder worker failed.");
+      std::unique_lock<std::mutex> locker(m_queueLock);
+      if(!m_error)
+        m_error = std::current_exception();
+      m_aborted = true;
+      m_queueNotFull.notify_all();
+      m_frameReady.notify_all();
+    }
+
+    if(uncompressedDataBuffer)
+      lvdFree(uncompressedDataBuffer);
+    if(compressedDataBuffer)
+      lvdFree(compressedDataBuffer);
+  }
+
+  std::unique_ptr<DecodedFrame> BatchDecoderPrivate::takeFrame(uint32_t iSegment)
+  {
+    std::unique_lock<std::mutex> locker(m_queueLock);
+    DecodeSegmentState &state = m_segmentStateList[iSegment];
+    if(m_deliveringSegment != iSegment)
+    {
+      m_deliveringSegment = iSegment;
+      m_queueNotFull.notify_all();
+    }
+    m_frameReady.wait(locker, [&]() { return m_error || !state.frameQueue.empty() || state.finished; });
+    if(m_error)
+      std::rethrow_exception(m_error);
+    if(state.frameQueue.empty())
+      return nullptr;
+
+    std::unique_ptr<DecodedFrame> frame = std::move(state.frameQueue.front());
+    state.frameQueue.pop_front();
+    --m_nQueuedFrame;
+    m_queueNotFull.notify_all();
+    return frame;
+  }
+
+  void BatchDecoderPrivate::recycleFrame(std::unique_ptr<DecodedFrame> frame)
+  {
+    std::unique_lock<std::mutex> locker(m_queueLock);
+    m_freeFrameList.push_back(std::move(frame));
+  }
+
+  // returns the size of the packet data
+  uint32_t BatchDecoderPrivate::readPacket(const PacketIndexEntry &entry, char *compressedDataBuffer, char *uncompressedDataBuffer)
+  {
+    uint32_t maxUncompressedPacketSize = getMaxUncompressedPacketSize(m_mainStruct, m_colorFormatInfo, entry.vfpk);
+    if(entry.vfpk.compressionMethod == NoCompression && entry.vfpk.size > maxUncompressedPacketSize)
+      throw DataError("Invalid uncompressed data size.");
+    if(entry.vfpk.size > static_cast<uint32_t>(m_maxCompressedPacketDataSize))
+      throw DataError("Video packet is too large.");
+
+    {
+      std::unique_lock<std::mutex> locker(m_ioLock);
+      m_seek(entry.offset + sizeof(VideoFramePacket));
+      if(entry.vfpk.compressionMethod == NoCompression)
+        m_read(uncompressedDataBuffer, entry.vfpk.size);
+      else
+        m_read(compressedDataBuffer, entry.vfpk.size);
+    }
+    if(entry.vfpk.compressionMethod == NoCompression)
+      return entry.vfpk.size;
+    return decompressPacketData(entry.vfpk, compressedDataBuffer, uncompressedDataBuffer, maxUncompressedPacketSize);
+  }
+
+  /*
+    A segment starts at the first key frame of its first packet and ends in front of the first key frame
+    at or after its end packet, so the tail of a segment may be decoded from the next segment's first packet.
+  */
+  void BatchDecoderPrivate::decodeSegment(uint32_t iSegment, FrameReconstructor<uint8_t> &reconstructor, SkipMap &skipMap, char *compressedDataBuffer, char *uncompressedDataBuffer)
+  {
+    const DecodeSegment &segment = m_segmentList[iSegment];
+    uint32_t modeTableSize = getTileCount(m_mainStruct) * static_cast<uint32_t>(m_colorFormatInfo.channelList.size());
+    uint32_t nPacket = static_cast<uint32_t>(m_packetIndex.size());
+    int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+    bool started = false;
+    for(uint32_t iPacket = segment.firstPacket; iPacket < nPacket; ++iPacket)
+    {
+      const PacketIndexEntry &entry = m_packetIndex[iPacket];
+      bool pastEnd = iPacket >= segment.endPacket;
+      uint32_t packetDataSize = readPacket(entry, compressedDataBuffer, uncompressedDataBuffer);
+      uint32_t recordOffset = 0, i = 0;
+      for(; i < entry.vfpk.nFrame && entry.firstFrame + i < m_mainStruct.nFrame; ++i)
+      {
+        // records vary in size, the header and the skip map tell where the next one starts
+        const char *record = uncompressedDataBuffer + recordOffset;
+        VideoFrameStruct vfrm;
+        if(packetDataSize - recordOffset < sizeof(VideoFrameStruct))
+          throw DataError("Video packet holds fewer frames than it claims.");
+        std::copy(record, record + sizeof(VideoFrameStruct), reinterpret_cast<char*>(&vfrm));
+        if(!verifyVFRM(m_mainStruct, vfrm))
+          throw DataError("Video frame is invalid");
+        if(vfrm.storeSlotMask & ~entry.vfpk.storeSlotMask)
+          throw DataError("Video packet doesn't list the slots its frames store.");
+        uint32_t frameModeTableSize = vfrm.referenceType == RepeatPreviousReference ? 0 : modeTableSize;
+        uint32_t headerSize = static_cast<uint32_t>(sizeof(VideoFrameStruct)) + frameModeTableSize + skipMap.bitmapSize(vfrm);
+        if(packetDataSize - recordOffset < headerSize)
+          throw DataError("Video packet holds fewer frames than it claims.");
+        uint32_t recordSize = headerSize + skipMap.load(vfrm, record + sizeof(VideoFrameStruct) + frameModeTableSize);
+        if(packetDataSize - recordOffset < recordSize)
+          throw DataError("Video packet holds fewer frames than it claims.");
+        recordOffset += recordSize;
+
+        bool isFull = vfrm.referenceType == NoReference;
+        if(!started)
+        {
+          if(!isFull)
+          {
+            if(entry.firstFrame + i == 0)
+              throw DataError("Frame 0 must be full frame.");
+            continue;
+          }
+          started = true;
+        }
+        else if(pastEnd && isFull)
+        {
+          finishSegment(iSegment);
+          return;
+        }
+
+        // a slot stored in front of the segment is decoded on first use, its packet is read into buffers of its own
+        if(vfrm.referenceType == LongTermReference && !reconstructor.hasSlot(vfrm.referenceSlot))
+        {
+          SlotFrame slotFrame;
+          {
+            std::unique_lock<std::mutex> locker(m_ioLock);
+            slotFrame = readSlotFrame(m_mainStruct, m_colorFormatInfo, m_packetIndex, vfrm.referenceSlot, entry.firstFrame + i, m_read, m_seek);
+          }
+          reconstructor.restoreSlot(vfrm.referenceSlot, slotFrame.vfrm, slotFrame.data.data(), m_channelMask);
+        }
+        reconstructor.reconstruct(vfrm, record + sizeof(VideoFrameStruct), skipMap, m_channelMask);
+        std::unique_ptr<DecodedFrame> frame = acquireFrame(iSegment);
+        if(!frame)
+          return;
+        frame->frameNumber = entry.firstFrame + i;
+        for(int iChannel = 0; iChannel < nChannel; ++iChannel)
+        {
+          if(m_channelMask & (1U << iChannel))
+            frame->channelList[iChannel] = reconstructor.channel(iChannel);
+        }
+        pushFrame(iSegment, std::move(frame));
+      }
+      if(i == entry.vfpk.nFrame && recordOffset != packetDataSize)
+        throw DataError("Video packet size doesn't match its frames.");
+      if(!started)
+        throw DataError("Video packet doesn't contain the full frame it claims.");
+    }
+    finishSegment(iSegment);
+  }
+
+  /*
+    The frame budget is shared by all segments, so a worker keeps decoding ahead while earlier segments are delivered.
+    The segment being delivered may go over it by queuedFramePerThread frames, otherwise segments ahead could take the whole budget
+    and stall delivery.
+  */
+  std::unique_ptr<DecodedFrame> BatchDecoderPrivate::acquireFrame(uint32_t iSegment)
+  {
+    std::unique_lock<std::mutex> locker(m_queueLock);
+    DecodeSegmentState &state = m_segmentStateList[iSegment];
+    m_queueNotFull.wait(locker, [&]()
+    {
+      return m_aborted || m_nQueuedFrame < m_maxQueuedFrame || (iSegment == m_deliveringSegment && state.frameQueue.size() < queuedFramePerThread);
+    });
+    if(m_aborted)
+      return nullptr;
+    // counted from here on, so frames being decoded hold their place in the budget
+    ++m_nQueuedFrame;
+    if(!m_freeFrameList.empty())
+    {
+      std::unique_ptr<DecodedFrame> frame = std::move(m_freeFrameList.back());
+      m_freeFrameList.pop_back();
+      return frame;
+    }
+    locker.unlock();
+
+    std::unique_ptr<DecodedFrame> frame(new DecodedFrame);
+    for(const Size &s : m_colorFormatInfo.channelList)
+      frame->channelList.emplace_back(s.width, s.height);
+    return frame;
+  }
+
+  void BatchDecoderPrivate::pushFrame(uint32_t iSegment, std::unique_ptr<DecodedFrame> frame)
+  {
+    std::unique_lock<std::mutex> locker(m_queueLock);
+    m_segmentStateList[iSegment].frameQueue.push_back(std::move(frame));
+    m_frameReady.notify_all();
+  }
+
+  void BatchDecoderPrivate::finishSegment(uint32_t iSegment)
+  {
+    std::unique_lock<std::mutex> locker(m_queueLock);
+    m_segmentStateList[iSegment].finished = true;
+    m_frameReady.notify_all();
+  }
+
+  BatchDecoder::BatchDecoder(ReadFunc readFunc, SeekFunc seekFunc, PosFunc posFunc, uint32_t threadCount)
+    : m_dptr(nullptr)
+  {
+    try
+    { m_dptr = new BatchDecoderPrivate(readFunc, seekFunc, posFunc, threadCount); }
+    catch(const std::exception &)
+    {
+      critical("Cannot initialize a batch decoder.");
+      seekFunc(0);
+      throw;
+    }
+  }
+
+  BatchDecoder::~BatchDecoder()
+  {
+    delete m_dptr;
+    m_dptr = nullptr;
+  }
+
+  /* property getter */
+  uint32_t BatchDecoder::width() const
+  { return m_dptr->m_mainStruct.width; }
+  uint32_t BatchDecoder::height() const
+  { return m_dptr->m_mainStruct.height; }
+  uint32_t BatchDecoder::framerate() const
+  { return m_dptr->m_mainStruct.framerate; }
+  uint32_t BatchDecoder::frameCount() const
+  { return m_dptr->m_mainStruct.nFrame; }
+  ColorFormat BatchDecoder::colorFormat() const
+  { return m_dptr->m_mainStruct.colorFormat; }
+  uint8_t BatchDecoder::formatVersion() const
+  { return m_dptr->m_mainStruct.version; }
+  double BatchDecoder::duration() const
+  { return static_cast<double>(m_dptr->m_mainStruct.nFrame) / static_cast<double>(m_dptr->m_mainStruct.framerate); }
+  uint32_t BatchDecoder::channelCount() const
+  { return static_cast<uint32_t>(m_dptr->m_colorFormatInfo.channelList.size()); }
+  uint32_t BatchDecoder::threadCount() const
+  { return m_dptr->m_nThread; }
+  uint32_t BatchDecoder::segmentCount() const
+  { return static_cast<uint32_t>(m_dptr->m_segmentList.size()); }
+
+  /* method */
+  void BatchDecoder::setChannelMask(uint32_t mask)
+  { m_dptr->m_channelMask = mask; }
+
+  uint32_t BatchDecoder::channelMask() const
+  { return m_dptr->m_channelMask; }
+
+  void BatchDecoder::decode(FrameFunc frameFunc)
+  {
+    lvdAssert(frameFunc);
+    BatchDecoderPrivate &d = *m_dptr;
+    d.reset();
+
+    uint32_t nSegment = static_cast<uint32_t>(d.m_segmentList.size());
+    std::vector<std::thread> workerList;
+    for(uint32_t i = 0; i < std::min(d.m_nThread, nSegment); ++i)
+      workerList.emplace_back(&BatchDecoderPrivate::work, &d);
+
+    try
+    {
+      uint32_t expectedFrameNumber = 0;
+      for(uint32_t iSegment = 0; iSegment < nSegment; ++iSegment)
+      {
+        while(std::unique_ptr<DecodedFrame> frame = d.takeFrame(iSegment))
+        {
+          if(frame->frameNumber != expectedFrameNumber)
+            throw DataError("Video key frame layout is inconsistent.");
+          frameFunc(*frame);
+          d.recycleFrame(std::move(frame));
+          ++expectedFrameNumber;
+        }
+      }
+      if(expectedFrameNumber != d.m_mainStruct.nFrame)
+        throw DataError("Video frame count is inconsistent.");
+    }
+    catch(...)
+    {
+      d.abort();
+      for(std::thread &worker : workerList)
+        worker.join();
+      throw;
+    }
+    for(std::thread &worker : workerList)
+      worker.join();
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
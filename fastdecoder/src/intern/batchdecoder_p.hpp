@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../batchdecoder.hpp"
+#include "packet_p.hpp"
+#include "reconstructor_p.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <exception>
+
+namespace LightVideoDecoder
+{
+  struct DecodeSegment
+  {
+    uint32_t firstPacket, endPacket;
+  };
+
+  struct DecodeSegmentState
+  {
+    std::deque<std::unique_ptr<DecodedFrame>> frameQueue;
+    bool finished;
+  };
+
+  class BatchDecoderPrivate final
+  {
+  public:
+    BatchDecoderPrivate(BatchDecoder::ReadFunc readFunc, BatchDecoder::SeekFunc seekFunc, BatchDecoder::PosFunc posFunc, uint32_t threadCount);
+    ~BatchDecoderPrivate();
+
+    void reset();
+    void abort();
+    void work();
+
+    std::unique_ptr<DecodedFrame> takeFrame(uint32_t iSegment);
+    void recycleFrame(std::unique_ptr<DecodedFrame> frame);
+
+    BatchDecoder::ReadFunc m_read;
+    BatchDecoder::SeekFunc m_seek;
+    BatchDecoder::PosFunc m_pos;
+
+    /* info */
+    MainStruct m_mainStruct;
+    ColorFormatInfo m_colorFormatInfo;
+    std::vector<PacketIndexEntry> m_packetIndex;
+    std::vector<DecodeSegment> m_segmentList;
+    uint32_t m_nThread;
+    uint32_t m_channelMask;
+    int m_maxCompressedPacketDataSize, m_maxUncompressedPacketDataSize;
+
+  private:
+    uint32_t readPacket(const PacketIndexEntry &entry, char *compressedDataBuffer, char *uncompressedDataBuffer);
+    void decodeSegment(uint32_t iSegment, FrameReconstructor<uint8_t> &reconstructor, SkipMap &skipMap, char *compressedDataBuffer, char *uncompressedDataBuffer);
+    std::unique_ptr<DecodedFrame> acquireFrame(uint32_t iSegment);
+    void pushFrame(uint32_t iSegment, std::unique_ptr<DecodedFrame> frame);
+    void finishSegment(uint32_t iSegment);
+
+    /* status */
+    std::mutex m_ioLock, m_queueLock;
+    std::condition_variable m_frameReady, m_queueNotFull;
+    std::vector<DecodeSegmentState> m_segmentStateList;
+    std::vector<std::unique_ptr<DecodedFrame>> m_freeFrameList;
+    std::exception_ptr m_error;
+    uint32_t m_maxQueuedFrame, m_nQueuedFrame;
+    uint32_t m_deliveringSegment, m_nextSegment;
+    bool m_aborted;
+  };
+} // namespace LightVideoDecoder
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "../decodecost.hpp"
+#include "../imagechannel.hpp"
+#include "defilter_dispatcher_p.hpp"
+#include "motion_p.hpp"
+#include "tile_p.hpp"
+#include "util_p.hpp"
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+extern "C"
+{
+  extern int LZ4_compress_default(const char* source, char* dest, int sourceSize, int maxDestSize);
+  extern int LZ4_decompress_safe(const char* source, char* dest, int compressedSize, int maxDecompressedSize);
+  extern int LZ4_compressBound(int inputSize);
+}
+
+namespace LightVideoDecoder
+{
+  namespace
+  {
+    // small residuals with sparse larger ones, close to what delta frames carry
+    void fillSynthetic(ImageChannel<uint8_t> &img)
+    {
+      uint32_t state = 0x12345678;
+      for(uint32_t y = 0; y < img.height(); ++y)
+      {
+        for(uint32_t x = 0; x < img.width(); ++x)
+        {
+          state = state * 1664525 + 1013904223;
+          uint8_t noise = static_cast<uint8_t>(state >> 24);
+          img(y, x) = static_cast<uint8_t>((x + y) / 4 + (noise < 32 ? noise : noise % 3));
+        }
+      }
+    }
+
+    // best time of nRun runs of func per unit, prepare runs untimed before each of them
+    template<typename Prepare, typename Func>double bestTime(uint32_t nRun, double nUnit, Prepare prepare, Func func)
+    {
+      double best = 0.0;
+      for(uint32_t i = 0; i < nRun; ++i)
+      {
+        prepare();
+        auto begin = std::chrono::steady_clock::now();
+        func();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        if(i == 0 || ns < best)
+          best = ns;
+      }
+      return best / nUnit;
+    }
+  } // namespace
+
+  DecodeCostModel measureDecodeCost(uint32_t width, uint32_t height, uint32_t nRun)
+  {
+    lvdAssert(width > 0 && height > 0 && width <= 32767 && height <= 32767 && nRun > 0);
+    ImageChannel<uint8_t> source(width, height), img(width, height), ref(width, height);
+    fillSynthetic(source);
+    fillSynthetic(ref);
+    double nSample = static_cast<double>(width) * height;
+    auto restore = [&]() { std::copy(source.begin(), source.end(), img.begin()); };
+
+    DecodeCostModel model;
+    for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+      model.intraCost[mode] = static_cast<float>(bestTime(nRun, nSample, restore, [&]() { defilterIntra<uint8_t>(img, static_cast<IntraPredictMode>(mode)); }));
+    MotionMap identity = getMotionMap(static_cast<int>(width), static_cast<int>(height), 0, 0, 0);
+    MotionMap motion = getMotionMap(static_cast<int>(width), static_cast<int>(height), static_cast<int>(std::min(width, height) / 16), 3, -2);
+    model.deltaCost = static_cast<float>(bestTime(nRun, nSample, restore, [&]() { defilterDelta<uint8_t>(img, ref, identity); }));
+    model.motionCost = static_cast<float>(bestTime(nRun, nSample, restore, [&]() { defilterDelta<uint8_t>(img, ref, motion); }));
+
+    int srcSize = static_cast<int>(width * height);
+    std::vector<char> compressed(LZ4_compressBound(srcSize));
+    int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(source.data()), compressed.data(), srcSize, static_cast<int>(compressed.size()));
+    lvdAssert(compressedSize > 0);
+    model.decompressCost = static_cast<float>(bestTime(nRun, nSample, []() {},
+      [&]() { LZ4_decompress_safe(compressed.data(), reinterpret_cast<char*>(img.data()), compressedSize, srcSize); }));
+
+    // the changed blocks of a skip map are defiltered one by one through a work block, less the same mode over the whole plane
+    std::vector<Rect> blockList;
+    for(uint32_t y = 0; y < height; y += 16)
+    {
+      for(uint32_t x = 0; x < width; x += 16)
+        blockList.push_back({x, y, std::min(16U, width - x), std::min(16U, height - y)});
+    }
+    std::vector<uint8_t> work(16 * 16);
+    Rect full = {0, 0, width, height};
+    double blocked = bestTime(nRun, static_cast<double>(blockList.size()), restore, [&]()
+    {
+      const uint8_t *src = source.data();
+      for(const Rect &rect : blockList)
+      {
+        defilterTile<uint8_t>(src, SubLeft, rect, full, work.data(), img);
+        src += rect.width * rect.height;
+      }
+    });
+    double perBlock = static_cast<double>(model.intraCost[SubLeft]) * nSample / static_cast<double>(blockList.size());
+    model.blockCost = static_cast<float>(std::max(0.0, blocked - perBlock));
+    return model;
+  }
+} // namespace LightVideoDecoder
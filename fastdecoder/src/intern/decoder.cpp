@@ -1,22 +1,19 @@
 #include "../decoder.hpp"
 #include "../error.hpp"
 #include "decoderimpl_p.hpp"
+#include "packet_p.hpp"
+#include "tile_p.hpp"
+#include "longterm_p.hpp"
 #include "util_p.hpp"
 
-extern "C"
-{
-  extern int LZ4_decompress_safe(const char* source, char* dest, int compressedSize, int maxDecompressedSize);
-  extern int LZ4_compressBound(int inputSize);
-}
-
 namespace LightVideoDecoder
 {
-  Decoder::Decoder(ReadFunc readFunc, SeekFunc seekFunc, PosFunc posFunc)
+  Decoder::Decoder(ReadFunc readFunc, SeekFunc seekFunc, PosFunc posFunc, PacketMode packetMode)
     : m_read(readFunc), m_seek(seekFunc), m_pos(posFunc),
-    m_mainStruct({0}), m_colorFormatInfo({0}), m_currentPacket({0}), m_currentFrameStruct({0}),
-    m_currentFrameNumber(0), m_prevFullFrameNumber(0), m_packetLoaded(false), m_frameLoaded(false), m_currentFrameDecoded(false),
+    m_mainStruct({0}), m_colorFormatInfo({0}), m_packetMode(packetMode), m_currentPacket({0}), m_currentFrameStruct({0}),
+    m_currentFrameNumber(0), m_prevFullFrameNumber(0), m_packetFrameIndex(0), m_packetLoaded(false), m_frameLoaded(false), m_currentFrameDecoded(false),
     m_compressedDataBuffer(nullptr), m_uncompressedDataBuffer(nullptr), m_frameDataBuffer(nullptr),
-    m_uncompressedDataBufferPos(0),
+    m_uncompressedDataBufferPos(0), m_nextPacketOffset(sizeof(MainStruct)),
     m_dptr(nullptr)
   {
     lvdAssert(readFunc && seekFunc && posFunc);
@@ -28,14 +25,26 @@ namespace LightVideoDecoder
         throw DataError("Video main structure is broken.");
       m_colorFormatInfo = getColorFormatInfo(m_mainStruct.colorFormat, m_mainStruct.width, m_mainStruct.height);
 
-      int maxUncompressedPacketDataSize = (sizeof(VideoFrameStruct) + m_colorFormatInfo.dataSize) * m_mainStruct.maxPacketSize;
-      if(maxUncompressedPacketDataSize > 0x7E000000 || maxUncompressedPacketDataSize <= 0)
-        throw DataError("Uncompressed packet size is too large.");
-      int maxCompressedPacketDataSize = std::max(maxUncompressedPacketDataSize, LZ4_compressBound(maxUncompressedPacketDataSize));
+      uint64_t frameRecordSize = getMaxFrameRecordSize(m_mainStruct, m_colorFormatInfo);
+      if(m_packetMode == StreamedPacket)
+      {
+        // only one frame record is resident at a time
+        if(frameRecordSize > 0x7E000000)
+          throw DataError("Uncompressed frame size is too large.");
+      }
+      else
+      {
+        uint64_t maxUncompressedPacketDataSize = frameRecordSize * m_mainStruct.maxPacketSize;
+        if(maxUncompressedPacketDataSize > 0x7E000000 || maxUncompressedPacketDataSize == 0)
+          throw DataError("Uncompressed packet size is too large.");
+        uint32_t maxCompressedPacketDataSize = getMaxCompressedPacketSize(static_cast<uint32_t>(maxUncompressedPacketDataSize));
 
-      m_compressedDataBuffer = LVDALLOC(char, maxCompressedPacketDataSize);
-      m_uncompressedDataBuffer = LVDALLOC(char, maxUncompressedPacketDataSize);
+        m_compressedDataBuffer = LVDALLOC(char, maxCompressedPacketDataSize);
+        m_uncompressedDataBuffer = LVDALLOC(char, maxUncompressedPacketDataSize);
+      }
       m_dptr = new DecoderImpl<uint8_t>(m_mainStruct);
+      if(m_packetMode == StreamedPacket)
+        m_dptr->m_packetStream = new PacketStream(m_read, m_seek, static_cast<uint32_t>(frameRecordSize));
     }
     catch(const std::exception &)
     {
@@ -82,16 +91,35 @@ namespace LightVideoDecoder
   { return m_mainStruct.colorFormat; }
   uint8_t Decoder::formatVersion() const
   { return m_mainStruct.version; }
+  PacketMode Decoder::packetMode() const
+  { return m_packetMode; }
+  uint32_t Decoder::tileWidth() const
+  { return m_mainStruct.tileWidth; }
+  uint32_t Decoder::tileHeight() const
+  { return m_mainStruct.tileHeight; }
   double Decoder::duration() const
   { return static_cast<double>(m_mainStruct.nFrame) / static_cast<double>(m_mainStruct.framerate); }
   uint32_t Decoder::channelCount() const
   { return static_cast<uint32_t>(m_colorFormatInfo.channelList.size()); }
+  uint32_t Decoder::longTermSlotCount() const
+  { return m_mainStruct.nLongTermSlot; }
 
   /* method */
   void Decoder::seekFrame(uint32_t pos)
   {
     if(pos >= m_mainStruct.nFrame)
       throw EOFError("EOF");
+    // with the frame cache the frame is only looked up or loaded by decodeCurrentFrame
+    if(m_dptr->m_frameCache)
+    {
+      if(pos != m_currentFrameNumber)
+      {
+        m_currentFrameNumber = pos;
+        m_currentFrameDecoded = false;
+        m_dptr->m_cachedFrame = nullptr;
+      }
+      return;
+    }
     if(m_frameLoaded && pos == m_currentFrameNumber)
       return;
     m_frameLoaded = false;
@@ -99,12 +127,8 @@ namespace LightVideoDecoder
     if(pos == m_currentFrameNumber + 1)
     {
       bool prevIsFull = m_currentFrameStruct.referenceType == NoReference;
-      if(m_packetLoaded)
-      {
-        uint32_t currentUncompressedPacketSize = (sizeof(VideoFrameStruct) + m_colorFormatInfo.dataSize) * m_currentPacket.nFrame;
-        if(m_uncompressedDataBufferPos >= currentUncompressedPacketSize)
-          m_packetLoaded = false;
-      }
+      if(m_packetLoaded && m_packetFrameIndex >= m_currentPacket.nFrame)
+        m_packetLoaded = false;
       if(!m_packetLoaded)
         loadPacket();
       loadFrame();
@@ -116,19 +140,20 @@ namespace LightVideoDecoder
     else if(pos == 0)
     {
       m_packetLoaded = false;
-      m_seek(sizeof(MainStruct));
+      m_nextPacketOffset = sizeof(MainStruct);
 
       loadPacket();
       loadFrame();
 
       if(m_currentFrameStruct.referenceType != NoReference)
         throw DataError("Frame 0 must be full frame.");
+      static_cast<DecoderImpl<uint8_t>*>(m_dptr)->clearSlots();
 
       m_currentFrameNumber = 0;
       m_prevFullFrameNumber = 0;
     }
     else
-      lvdAssert(false, "You can only seek to start or next frame.");
+      lvdAssert(false, "You can only seek to start or next frame unless the frame cache is enabled.");
   }
 
   void Decoder::nextFrame()
@@ -139,12 +164,86 @@ namespace LightVideoDecoder
     if(!m_currentFrameDecoded)
     {
       DecoderImpl<uint8_t> &decoderImpl = static_cast<DecoderImpl<uint8_t>&>(*m_dptr);
-      decoderImpl.decodeCurrentFrameData(m_currentFrameStruct, m_frameDataBuffer);
+      if(decoderImpl.m_frameCache)
+        decodeCachedFrame();
+      else
+      {
+        decodeLoadedFrame();
+        decoderImpl.m_decodedFrameNumber = m_currentFrameNumber;
+      }
       m_currentFrameDecoded = true;
     }
   }
 
+  void Decoder::setChannelMask(uint32_t mask)
+  {
+    invalidateFrameCache();
+    static_cast<DecoderImpl<uint8_t>*>(m_dptr)->setChannelMask(mask);
+  }
+
+  uint32_t Decoder::channelMask() const
+  { return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->channelMask(); }
+
+  void Decoder::setRegionOfInterest(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+  {
+    invalidateFrameCache();
+    static_cast<DecoderImpl<uint8_t>*>(m_dptr)->setRegion({x, y, width, height});
+  }
+
+  void Decoder::resetRegionOfInterest()
+  { setRegionOfInterest(0, 0, m_mainStruct.width, m_mainStruct.height); }
+
+  void Decoder::setOutputScale(OutputScale scale)
+  {
+    invalidateFrameCache();
+    static_cast<DecoderImpl<uint8_t>*>(m_dptr)->setScaleShift(static_cast<int>(scale));
+  }
+
+  void Decoder::setFrameCacheBudget(uint64_t budget)
+  {
+    DecoderPrivate &d = *m_dptr;
+    invalidateFrameCache();
+    delete d.m_frameCache;
+    d.m_frameCache = nullptr;
+    if(budget > 0)
+    {
+      d.m_frameCache = new FrameCache(budget);
+      d.m_loadedFrameNumber = m_frameLoaded ? m_currentFrameNumber : -1;
+      if(d.m_packetIndex.empty())
+        d.m_packetIndex = scanPacketIndex(m_mainStruct, m_read, m_seek);
+    }
+    else
+    {
+      // back to sequential decoding, which always starts over from frame 0
+      m_packetLoaded = false;
+      m_frameLoaded = false;
+      m_currentFrameDecoded = false;
+      m_currentFrameNumber = 0;
+      m_nextPacketOffset = sizeof(MainStruct);
+      d.m_loadedFrameNumber = d.m_decodedFrameNumber = -1;
+    }
+  }
+
+  FrameCacheStats Decoder::frameCacheStats() const
+  {
+    if(m_dptr->m_frameCache)
+      return m_dptr->m_frameCache->stats();
+    return {0, 0, 0, 0, 0};
+  }
+
+  OutputScale Decoder::outputScale() const
+  { return static_cast<OutputScale>(static_cast<DecoderImpl<uint8_t>*>(m_dptr)->scaleShift()); }
+
   /* status getter */
+  uint32_t Decoder::outputX() const
+  { return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->region().x; }
+  uint32_t Decoder::outputY() const
+  { return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->region().y; }
+  uint32_t Decoder::outputWidth() const
+  { return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->outputSize().width; }
+  uint32_t Decoder::outputHeight() const
+  { return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->outputSize().height; }
+
   uint32_t Decoder::currentFrameNumber() const
   { return m_currentFrameNumber; }
 
@@ -155,19 +254,44 @@ namespace LightVideoDecoder
   {
     if(!m_packetLoaded)
     {
+      m_seek(m_nextPacketOffset);
       m_read(reinterpret_cast<char*>(&m_currentPacket), sizeof(VideoFramePacket));
       if(!verifyVFPK(m_mainStruct, m_currentPacket))
         throw DataError("Video packet is invalid.");
-      if(m_currentPacket.compressionMethod == NoCompression)
-        m_read(m_uncompressedDataBuffer, m_currentPacket.size);
-      else // LZ4Compression
+      uint32_t maxUncompressedPacketSize = getMaxUncompressedPacketSize(m_mainStruct, m_colorFormatInfo, m_currentPacket);
+      if(m_packetMode == StreamedPacket)
+      {
+        // the payload is read by loadFrame()
+        m_dptr->m_packetStream->open(m_currentPacket, m_nextPacketOffset + sizeof(VideoFramePacket), maxUncompressedPacketSize);
+      }
+      else
       {
-        uint32_t uncompressedPacketSize = (sizeof(VideoFrameStruct) + m_colorFormatInfo.dataSize) * m_currentPacket.nFrame;
-        m_read(m_compressedDataBuffer, m_currentPacket.size);
-        if(LZ4_decompress_safe(m_compressedDataBuffer, m_uncompressedDataBuffer, m_currentPacket.size, uncompressedPacketSize) == -1)
-          throw DataError("Invalid compressed data.");
+        if(m_currentPacket.size > getMaxCompressedPacketSize(getMaxFrameRecordSize(m_mainStruct, m_colorFormatInfo) * m_mainStruct.maxPacketSize))
+          throw DataError("Video packet is too large.");
+        if(m_currentPacket.compressionMethod == NoCompression)
+        {
+          if(m_currentPacket.size > maxUncompressedPacketSize)
+            throw DataError("Invalid uncompressed data size.");
+          m_read(m_uncompressedDataBuffer, m_currentPacket.size);
+          m_dptr->m_packetDataSize = m_currentPacket.size;
+        }
+        else
+        {
+          m_read(m_compressedDataBuffer, m_currentPacket.size);
+          if(m_currentPacket.compressionMethod == ChunkedLZ4Compression)
+          {
+            m_dptr->m_chunkTable = readChunkTable(m_currentPacket, m_compressedDataBuffer, maxUncompressedPacketSize);
+            m_dptr->m_chunkDecompressed.assign(m_dptr->m_chunkTable.size(), false);
+            m_dptr->m_packetDataSize = m_dptr->m_chunkTable.back().uncompressedEnd;
+          }
+          else
+            m_dptr->m_packetDataSize = decompressPacketData(m_currentPacket, m_compressedDataBuffer, m_uncompressedDataBuffer, maxUncompressedPacketSize);
+        }
       }
+      m_dptr->m_recordOffsetList.clear();
       m_uncompressedDataBufferPos = 0;
+      m_packetFrameIndex = 0;
+      m_nextPacketOffset += sizeof(VideoFramePacket) + m_currentPacket.size;
       m_packetLoaded = true;
     }
   }
@@ -177,20 +301,265 @@ namespace LightVideoDecoder
     lvdAssert(m_packetLoaded);
     if(!m_frameLoaded)
     {
-      char *begin = m_uncompressedDataBuffer + m_uncompressedDataBufferPos;
-      char *end = begin + sizeof(VideoFrameStruct);
-      std::copy(begin, end, reinterpret_cast<char*>(&m_currentFrameStruct));
+      DecoderPrivate &d = *m_dptr;
+      if(m_packetFrameIndex >= m_currentPacket.nFrame)
+        throw DataError("Video packet has no more frames.");
+      uint64_t recordOffset = m_packetMode == StreamedPacket ? d.m_packetStream->position() : m_uncompressedDataBufferPos;
+      if(m_packetFrameIndex == d.m_recordOffsetList.size())
+        d.m_recordOffsetList.push_back(recordOffset);
+
+      // the record is read in parts, each part tells the size of the next one
+      const char *begin = nullptr;
+      uint32_t recordSize = 0;
+      auto extendRecord = [&](uint32_t size, bool decompress)
+      {
+        if(m_packetMode == StreamedPacket)
+        {
+          PacketStream &stream = *d.m_packetStream;
+          begin = !recordSize ? stream.nextRecord(size) : decompress ? stream.extendRecord(size) : stream.reserveRecord(size);
+        }
+        else
+        {
+          uint32_t end = m_uncompressedDataBufferPos + recordSize + size;
+          if(end > d.m_packetDataSize)
+            throw DataError("Video packet holds fewer frames than it claims.");
+          if(decompress && m_currentPacket.compressionMethod == ChunkedLZ4Compression)
+            decompressPacketRange(m_uncompressedDataBufferPos + recordSize, end);
+          begin = m_uncompressedDataBuffer + m_uncompressedDataBufferPos;
+        }
+        recordSize += size;
+      };
+
+      extendRecord(sizeof(VideoFrameStruct), true);
+      std::copy(begin, begin + sizeof(VideoFrameStruct), reinterpret_cast<char*>(&m_currentFrameStruct));
       if(!verifyVFRM(m_mainStruct, m_currentFrameStruct))
         throw DataError("Video frame is invalid");
-      m_uncompressedDataBufferPos += sizeof(VideoFrameStruct) + m_colorFormatInfo.dataSize;
+      // slots are looked up by the packet header, see readSlotFrame
+      if(m_currentFrameStruct.storeSlotMask & ~m_currentPacket.storeSlotMask)
+        throw DataError("Video packet doesn't list the slots its frames store.");
+      uint32_t modeTableSize = m_currentFrameStruct.referenceType == RepeatPreviousReference ? 0 :
+        getTileCount(m_mainStruct) * static_cast<uint32_t>(m_colorFormatInfo.channelList.size());
+      extendRecord(modeTableSize + d.m_skipMap->bitmapSize(m_currentFrameStruct), true);
+      uint32_t dataSize = d.m_skipMap->load(m_currentFrameStruct, begin + sizeof(VideoFrameStruct) + modeTableSize);
+      // tiles are decompressed or decoded by decodeLoadedFrame(), only the header and the mode table are needed here
+      extendRecord(dataSize, !isTiled(m_mainStruct));
+
+      if(m_packetMode == BufferedPacket)
+        m_uncompressedDataBufferPos += recordSize;
+      if(++m_packetFrameIndex == m_currentPacket.nFrame)
+      {
+        if(m_packetMode == StreamedPacket)
+          d.m_packetStream->finish();
+        else if(m_uncompressedDataBufferPos != d.m_packetDataSize)
+          throw DataError("Video packet size doesn't match its frames.");
+      }
       m_frameDataBuffer = begin + sizeof(VideoFrameStruct);
       m_frameLoaded = true;
       m_currentFrameDecoded = false;
     }
   }
 
+  void Decoder::loadNextFrame()
+  {
+    if(m_packetLoaded && m_packetFrameIndex >= m_currentPacket.nFrame)
+      m_packetLoaded = false;
+    if(!m_packetLoaded)
+      loadPacket();
+    m_frameLoaded = false;
+    loadFrame();
+    ++m_dptr->m_loadedFrameNumber;
+  }
+
+  // makes frameIndex the next frame loaded from the current packet
+  void Decoder::rewindPacket(uint32_t frameIndex)
+  {
+    DecoderPrivate &d = *m_dptr;
+    lvdAssert(m_packetLoaded && frameIndex < d.m_recordOffsetList.size(), "Only loaded frames can be rewound to.");
+    m_frameLoaded = false;
+    if(m_packetMode == StreamedPacket)
+      d.m_packetStream->seekRecord(d.m_recordOffsetList[frameIndex]);
+    else
+      m_uncompressedDataBufferPos = static_cast<uint32_t>(d.m_recordOffsetList[frameIndex]);
+    m_packetFrameIndex = frameIndex;
+  }
+
+  // decompresses the chunks of the current packet which overlap [begin, end) and are not decompressed yet
+  void Decoder::decompressPacketRange(uint32_t begin, uint32_t end)
+  {
+    DecoderPrivate &d = *m_dptr;
+    const std::vector<LZ4ChunkEntry> &table = d.m_chunkTable;
+    const char *chunkData = m_compressedDataBuffer + getChunkTableSize(static_cast<uint32_t>(table.size()));
+    auto it = std::upper_bound(table.begin(), table.end(), begin,
+      [](uint32_t v, const LZ4ChunkEntry &entry) { return v < entry.uncompressedEnd; });
+    for(size_t i = it - table.begin(); i < table.size(); ++i)
+    {
+      if(!d.m_chunkDecompressed[i])
+      {
+        decompressChunk(table, i, chunkData, m_uncompressedDataBuffer);
+        d.m_chunkDecompressed[i] = true;
+      }
+      if(table[i].uncompressedEnd >= end)
+        break;
+    }
+  }
+
+  void Decoder::decodeLoadedFrame()
+  {
+    DecoderImpl<uint8_t> &d = static_cast<DecoderImpl<uint8_t>&>(*m_dptr);
+    DecoderImpl<uint8_t>::FetchFunc fetch;
+    if(m_packetMode == BufferedPacket && m_currentPacket.compressionMethod == ChunkedLZ4Compression && isTiled(m_mainStruct))
+    {
+      // the chunks of all tiles in the region are decompressed together, on the thread pool when there is one
+      uint32_t dataOffset = static_cast<uint32_t>(m_frameDataBuffer - m_uncompressedDataBuffer);
+      fetch = [this, &d, dataOffset](const std::vector<DecoderImpl<uint8_t>::DataRange> &rangeList)
+      {
+        const std::vector<LZ4ChunkEntry> &table = d.m_chunkTable;
+        const char *chunkData = m_compressedDataBuffer + getChunkTableSize(static_cast<uint32_t>(table.size()));
+        std::vector<size_t> chunkList;
+        for(const DecoderImpl<uint8_t>::DataRange &range : rangeList)
+        {
+          auto it = std::upper_bound(table.begin(), table.end(), dataOffset + range.begin,
+            [](uint32_t v, const LZ4ChunkEntry &entry) { return v < entry.uncompressedEnd; });
+          for(size_t i = it - table.begin(); i < table.size(); ++i)
+          {
+            if(!d.m_chunkDecompressed[i] && (chunkList.empty() || chunkList.back() != i))
+              chunkList.push_back(i);
+            if(table[i].uncompressedEnd >= dataOffset + range.end)
+              break;
+          }
+        }
+        auto run = [&](uint32_t index, uint32_t) { decompressChunk(table, chunkList[index], chunkData, m_uncompressedDataBuffer); };
+        uint32_t nChunk = static_cast<uint32_t>(chunkList.size());
+        if(d.threadPool() && nChunk > 1)
+          d.threadPool()->parallelFor(nChunk, run);
+        else
+        {
+          for(uint32_t i = 0; i < nChunk; ++i)
+            run(i, 0);
+        }
+        for(size_t i : chunkList)
+          d.m_chunkDecompressed[i] = true;
+      };
+    }
+    else if(m_packetMode == StreamedPacket && isTiled(m_mainStruct))
+    {
+      // the tile data was only reserved by loadFrame(), tiles outside of the region are skipped
+      fetch = [this](const std::vector<DecoderImpl<uint8_t>::DataRange> &rangeList)
+      {
+        for(const DecoderImpl<uint8_t>::DataRange &range : rangeList)
+          m_dptr->m_packetStream->fetchRecord(sizeof(VideoFrameStruct) + range.begin, sizeof(VideoFrameStruct) + range.end);
+      };
+    }
+    if(m_currentFrameStruct.referenceType == LongTermReference && !d.hasSlot(m_currentFrameStruct.referenceSlot))
+      restoreSlot(m_currentFrameStruct.referenceSlot, d.m_frameCache ? static_cast<uint32_t>(d.m_loadedFrameNumber) : m_currentFrameNumber);
+    d.decodeCurrentFrameData(m_currentFrameStruct, m_frameDataBuffer, fetch);
+  }
+
+  /*
+    Slots are empty after a seek or a layout change, then the key frame that last stored the slot is decoded into it.
+    It is read into buffers of its own, so the loaded packet stays valid.
+  */
+  void Decoder::restoreSlot(uint32_t slot, uint32_t pos)
+  {
+    DecoderImpl<uint8_t> &d = static_cast<DecoderImpl<uint8_t>&>(*m_dptr);
+    if(d.m_packetIndex.empty())
+      d.m_packetIndex = scanPacketIndex(m_mainStruct, m_read, m_seek);
+    SlotFrame slotFrame = readSlotFrame(m_mainStruct, m_colorFormatInfo, d.m_packetIndex, slot, pos, m_read, m_seek);
+    d.restoreSlot(slot, slotFrame.vfrm, slotFrame.data.data());
+  }
+
+  // positions the stream so that loadNextFrame() returns the last key frame at or before pos
+  void Decoder::seekKeyFrame(uint32_t pos)
+  {
+    DecoderPrivate &d = *m_dptr;
+    // the slots may hold key frames from behind pos
+    static_cast<DecoderImpl<uint8_t>&>(d).clearSlots();
+    auto it = std::upper_bound(d.m_packetIndex.begin(), d.m_packetIndex.end(), pos,
+      [](uint32_t v, const PacketIndexEntry &entry) { return v < entry.firstFrame; });
+    for(size_t iPacket = it - d.m_packetIndex.begin(); iPacket-- > 0;)
+    {
+      const PacketIndexEntry &entry = d.m_packetIndex[iPacket];
+      if(entry.vfpk.nFullFrame == 0)
+        continue;
+      m_packetLoaded = false;
+      m_nextPacketOffset = entry.offset;
+      loadPacket();
+
+      int64_t keyFrame = -1;
+      for(uint32_t i = 0; i < entry.vfpk.nFrame && entry.firstFrame + i <= pos; ++i)
+      {
+        m_frameLoaded = false;
+        loadFrame();
+        if(m_currentFrameStruct.referenceType == NoReference)
+          keyFrame = i;
+      }
+      if(keyFrame >= 0)
+      {
+        rewindPacket(static_cast<uint32_t>(keyFrame));
+        d.m_loadedFrameNumber = entry.firstFrame + keyFrame - 1;
+        return;
+      }
+    }
+    throw DataError("No key frame in front of the frame.");
+  }
+
+  void Decoder::decodeCachedFrame()
+  {
+    DecoderImpl<uint8_t> &d = static_cast<DecoderImpl<uint8_t>&>(*m_dptr);
+    int64_t pos = m_currentFrameNumber;
+    d.m_cachedFrame = nullptr;
+    if(d.m_decodedFrameNumber == pos)
+      return;
+    d.m_cachedFrame = d.m_frameCache->find(m_currentFrameNumber);
+    if(d.m_cachedFrame)
+      return;
+
+    // continue the running decode chain if possible, restart it at the closest key frame otherwise
+    if(!m_frameLoaded || d.m_decodedFrameNumber != d.m_loadedFrameNumber || d.m_loadedFrameNumber + 1 != pos)
+      seekKeyFrame(m_currentFrameNumber);
+    do
+    {
+      loadNextFrame();
+      decodeLoadedFrame();
+      d.m_decodedFrameNumber = d.m_loadedFrameNumber;
+      // a repeated frame shares the entry of the frame in front of it instead of duplicating its textures
+      if(d.isLayoutSettled() && m_currentFrameStruct.referenceType == RepeatPreviousReference)
+        d.m_frameCache->alias(static_cast<uint32_t>(d.m_decodedFrameNumber), static_cast<uint32_t>(d.m_decodedFrameNumber - 1));
+      else if(d.isLayoutSettled())
+      {
+        GLuint texFS, texHS;
+        Size sizeFS(0, 0), sizeHS(0, 0);
+        int nFS, nHS;
+        d.getOutput(texFS, sizeFS, nFS, texHS, sizeHS, nHS);
+        d.m_frameCache->insert(static_cast<uint32_t>(d.m_decodedFrameNumber), m_currentFrameStruct.referenceType == NoReference, texFS, sizeFS, nFS, texHS, sizeHS, nHS);
+      }
+    } while(d.m_decodedFrameNumber < pos);
+  }
+
+  // cached textures must not outlive the layout they were decoded with
+  void Decoder::invalidateFrameCache()
+  {
+    DecoderPrivate &d = *m_dptr;
+    if(!d.m_frameCache)
+      return;
+    if(d.m_cachedFrame)
+    {
+      d.m_cachedFrame = nullptr;
+      m_currentFrameDecoded = false;
+    }
+    d.m_frameCache->clear();
+  }
+
   uint32_t Decoder::getCurrentFrameFS() const
-  { return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->currentTextureFS(); }
+  {
+    if(m_dptr->m_cachedFrame)
+      return m_dptr->m_cachedFrame->texFS;
+    return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->currentTextureFS();
+  }
   uint32_t Decoder::getCurrentFrameHS() const
-  { return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->currentTextureHS(); }
+  {
+    if(m_dptr->m_cachedFrame)
+      return m_dptr->m_cachedFrame->texHS;
+    return static_cast<DecoderImpl<uint8_t>*>(m_dptr)->currentTextureHS();
+  }
 } // namespace LightVideoDecoder
\ No newline at end of file
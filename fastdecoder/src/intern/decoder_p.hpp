@@ -1,9 +1,44 @@
 #pragma once
 
 #include "../decoder.hpp"
+#include "packet_p.hpp"
+#include "framecache_p.hpp"
+#include "packetstream_p.hpp"
+#include "skipmap_p.hpp"
+#include <vector>
 
 namespace LightVideoDecoder
 {
   class DecoderPrivate
-  {};
+  {
+  public:
+    inline DecoderPrivate() : m_packetDataSize(0), m_skipMap(nullptr), m_packetStream(nullptr), m_frameCache(nullptr), m_cachedFrame(nullptr), m_loadedFrameNumber(-1), m_decodedFrameNumber(-1)
+    {}
+
+    inline ~DecoderPrivate()
+    {
+      delete m_frameCache;
+      delete m_packetStream;
+      delete m_skipMap;
+    }
+
+    /* packet data, records vary in size */
+    uint32_t m_packetDataSize; // buffered packet
+    std::vector<uint64_t> m_recordOffsetList; // records of the current packet loaded so far
+    SkipMap *m_skipMap; // map of the loaded frame
+
+    /* chunked packet, chunks are decompressed when a frame in them is loaded */
+    std::vector<LZ4ChunkEntry> m_chunkTable;
+    std::vector<bool> m_chunkDecompressed;
+
+    /* streamed packet */
+    PacketStream *m_packetStream;
+
+    /* frame cache */
+    std::vector<PacketIndexEntry> m_packetIndex;
+    FrameCache *m_frameCache;
+    const CachedFrame *m_cachedFrame; // frame served as current frame, if any
+    int64_t m_loadedFrameNumber; // frame in Decoder::m_currentFrameStruct
+    int64_t m_decodedFrameNumber; // frame held by the reference textures
+  };
 } // namespace LightVideoDecoder
\ No newline at end of file
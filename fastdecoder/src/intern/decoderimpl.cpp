@@ -36,12 +36,16 @@ namespace LightVideoDecoder
     "noperspective in vec2 texCoord;\n"
     "\n"
     "uniform sampler2D curr, ref;\n"
+    "// global motion of the reference, see MotionMap, unsigned keeps the products of a bounded motion in range\n"
+    "uniform ivec2 size, scaledSize, halfDiff, move;\n"
     "layout (location = 0) out vec4 color;\n"
     "\n"
     "void main()\n"
     "{\n"
-    "  vec4 uc = texture(curr, texCoord) * 255.0f;\n"
-    "  vec4 rc = texture(ref, texCoord) * 255.0f;\n"
+    "  ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "  uvec2 m = min(uvec2(max(p + halfDiff - move, ivec2(0))) * uvec2(size) / uvec2(scaledSize), uvec2(size - 1));\n"
+    "  vec4 uc = texelFetch(curr, p, 0) * 255.0f;\n"
+    "  vec4 rc = texelFetch(ref, ivec2(m), 0) * 255.0f;\n"
     "  color = mod(uc + rc, 256.0f) / 255.0f;\n"
     "}";
 
@@ -108,13 +112,60 @@ namespace LightVideoDecoder
     }
   }
 
-  void drawNMS()
+  void drawNMS(const MotionMap &motion)
   {
     glUseProgram(progNMS);
     glUniform1i(glGetUniformLocation(progNMS, "curr"), 0);
     glUniform1i(glGetUniformLocation(progNMS, "ref"), 1);
+    glUniform2i(glGetUniformLocation(progNMS, "size"), motion.width, motion.height);
+    glUniform2i(glGetUniformLocation(progNMS, "scaledSize"), motion.scaledWidth, motion.scaledHeight);
+    glUniform2i(glGetUniformLocation(progNMS, "halfDiff"), motion.halfDiffW, motion.halfDiffH);
+    glUniform2i(glGetUniformLocation(progNMS, "move"), motion.moveX, motion.moveY);
     
     glBindVertexArray(vaoRect);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
   }
+
+  // the bound framebuffer gets ref outside the rectangles and curr + ref inside, rectangles are in pixels of the target
+  void drawNMSRects(GLuint ref, const Size &size, const std::vector<Rect> &rectList)
+  {
+    GLuint readBuffer;
+    glGenFramebuffers(1, &readBuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readBuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ref, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBlitFramebuffer(0, 0, size.width, size.height, 0, 0, size.width, size.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &readBuffer);
+
+    glEnable(GL_SCISSOR_TEST);
+    for(const Rect &rect : rectList)
+    {
+      glScissor(rect.x, rect.y, rect.width, rect.height);
+      drawNMS(getMotionMap(static_cast<int>(size.width), static_cast<int>(size.height), 0, 0, 0));
+    }
+    glDisable(GL_SCISSOR_TEST);
+  }
+
+  // reallocates dst at size and copies src into it without a round trip through the CPU
+  void copyTexture(GLuint src, GLuint dst, const Size &size, GLuint internalFormat, GLuint format)
+  {
+    glBindTexture(GL_TEXTURE_2D, dst);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.width, size.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+
+    GLuint attachments[1] = {GL_COLOR_ATTACHMENT0};
+    GLuint buffer[2];
+    glGenFramebuffers(2, buffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, buffer[0]);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, buffer[1]);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst, 0);
+    glDrawBuffers(1, attachments);
+    glBlitFramebuffer(0, 0, size.width, size.height, 0, 0, size.width, size.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(2, buffer);
+  }
 } // namespace LightVideoDecoder
@@ -2,11 +2,18 @@
 
 #include "../colorformat.hpp"
 #include "../imagechannel.hpp"
+#include "../error.hpp"
 #include "decoder_p.hpp"
 #include "util_p.hpp"
 #include "defilter_dispatcher_p.hpp"
 #include "interleave_p.hpp"
+#include "region_p.hpp"
+#include "reduce_p.hpp"
+#include "tile_p.hpp"
+#include "threadpool_p.hpp"
+#include "skipmap_p.hpp"
 #include <vector>
+#include <functional>
 #include "glad/glad.h"
 
 namespace LightVideoDecoder
@@ -16,23 +23,34 @@ namespace LightVideoDecoder
 
   void initializeDecoder();
   void destroyDecoder();
-  void drawNMS();
+  void drawNMS(const MotionMap &motion);
+  void drawNMSRects(GLuint ref, const Size &size, const std::vector<Rect> &rectList);
+  void copyTexture(GLuint src, GLuint dst, const Size &size, GLuint internalFormat, GLuint format);
 
   template<typename T>
   class DecoderImpl final : public DecoderPrivate
   {
   public:
-    inline DecoderImpl(const MainStruct &mainStruct) : m_mainStruct(mainStruct), m_currIsFull(false)
+    // bytes [begin, end) of the frame data
+    struct DataRange
+    {
+      uint32_t begin, end;
+    };
+    // makes the ranges of the frame data available, they are sorted and don't overlap
+    typedef std::function<void(const std::vector<DataRange>&)> FetchFunc;
+
+    inline DecoderImpl(const MainStruct &mainStruct) : m_mainStruct(mainStruct), m_channelMask(AllChannel), m_pendingChannelMask(AllChannel),
+      m_region({0, 0, mainStruct.width, mainStruct.height}), m_pendingRegion(m_region), m_sizeFS(0, 0), m_sizeHS(0, 0), m_regionBuffer(nullptr),
+      m_scaleShift(0), m_pendingScaleShift(0), m_prev(-1), m_prevFull(-1), m_currIsFull(false), m_threadPool(nullptr)
     {
       initializeDecoder();
       m_colorFormatInfo = getColorFormatInfo(mainStruct.colorFormat, mainStruct.width, mainStruct.height);
-
-      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
-      for(int i = 0; i < nChannel; ++i)
-      {
-        Size s = m_colorFormatInfo.channelList[i];
-        m_deintraBuffer[i] = ImageChannel<T>(s.width, s.height);
-      }
+      m_tileLayout = getTileLayout(mainStruct, m_colorFormatInfo);
+      if(m_tileLayout.nTile > 1)
+        m_threadPool = new ThreadPool();
+      if(m_tileLayout.nTile > 0)
+        m_tileBuffer.assign(m_threadPool ? m_threadPool->slotCount() : 1, std::vector<T>(static_cast<size_t>(mainStruct.tileWidth) * mainStruct.tileHeight));
+      m_skipMap = new SkipMap(mainStruct, m_colorFormatInfo);
 
       if(mainStruct.colorFormat == YUV420P)
       {
@@ -44,65 +62,135 @@ namespace LightVideoDecoder
         m_nFS = 2;
         m_nHS = 2;
       }
-      if(m_nFS > 0)
-        m_bufferFS = ImageChannel<T>(m_mainStruct.width * m_nFS, m_mainStruct.height);
-      if(m_nHS > 0)
-        m_bufferHS = ImageChannel<T>(std::max(1U, m_mainStruct.width / 2) * m_nHS, std::max(1U, m_mainStruct.height / 2));
+      uint32_t nSlot = mainStruct.nLongTermSlot;
+      m_slotChannelMask.assign(nSlot, 0);
+      m_slotPlaneSet.resize(nSlot);
+      applyLayout();
       glGenTextures(4, m_texFS);
       glGenTextures(4, m_texHS);
+      m_texSlotFS.resize(nSlot);
+      m_texSlotHS.resize(nSlot);
+      if(nSlot > 0)
+      {
+        glGenTextures(nSlot, m_texSlotFS.data());
+        glGenTextures(nSlot, m_texSlotHS.data());
+      }
     }
 
     inline ~DecoderImpl()
     {
       glDeleteTextures(4, m_texFS);
       glDeleteTextures(4, m_texHS);
+      if(!m_texSlotFS.empty())
+      {
+        glDeleteTextures(static_cast<GLsizei>(m_texSlotFS.size()), m_texSlotFS.data());
+        glDeleteTextures(static_cast<GLsizei>(m_texSlotHS.size()), m_texSlotHS.data());
+      }
+      if(m_regionBuffer)
+        lvdFree(m_regionBuffer);
+      delete m_threadPool;
       destroyDecoder();
     }
 
-    inline void decodeCurrentFrameData(const VideoFrameStruct &vfrm, const char *data)
+    inline void setChannelMask(uint32_t mask)
     {
-      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+      m_pendingChannelMask = mask;
+      m_channelMask &= mask;
+    }
+
+    inline uint32_t channelMask() const
+    { return m_pendingChannelMask; }
+
+    // the region is expanded to even bounds so that it maps onto whole chroma samples
+    inline void setRegion(const Rect &rect)
+    {
+      lvdAssert(rect.width > 0 && rect.height > 0, "Region is empty.");
+      lvdAssert(rect.x + rect.width <= m_mainStruct.width && rect.y + rect.height <= m_mainStruct.height, "Region is out of range.");
+      uint32_t x0 = rect.x & ~1U, y0 = rect.y & ~1U;
+      uint32_t x1 = std::min(m_mainStruct.width, (rect.x + rect.width + 1) & ~1U);
+      uint32_t y1 = std::min(m_mainStruct.height, (rect.y + rect.height + 1) & ~1U);
+      m_pendingRegion = {x0, y0, x1 - x0, y1 - y0};
+    }
+
+    inline const Rect &region() const
+    { return m_region; }
 
-      // deintra
+    inline void setScaleShift(int shift)
+    {
+      lvdAssert(shift >= 0 && shift <= 2, "Unsupported output scale.");
+      m_pendingScaleShift = shift;
+    }
+
+    inline int scaleShift() const
+    { return m_pendingScaleShift; }
+
+    // only tiled streams have a pool
+    inline ThreadPool *threadPool() const
+    { return m_threadPool; }
+
+    inline const Size &outputSize() const
+    { return m_sizeFS; }
+
+    // false while a pending mask, region or scale waits for the next full frame
+    inline bool isLayoutSettled() const
+    { return m_channelMask == m_pendingChannelMask && m_region == m_pendingRegion && m_scaleShift == m_pendingScaleShift; }
+
+    // textures of groups without any decoded channel are 0
+    inline void getOutput(GLuint &texFS, Size &sizeFS, int &nFS, GLuint &texHS, Size &sizeHS, int &nHS) const
+    {
+      bool activeFS = (m_channelMask & (m_nFS > 1 ? (LumaChannel | AlphaChannel) : LumaChannel)) != 0;
+      bool activeHS = (m_channelMask & ChromaChannel) != 0;
+      texFS = activeFS ? m_texFS[2] : 0;
+      texHS = activeHS ? m_texHS[2] : 0;
+      sizeFS = m_sizeFS;
+      sizeHS = m_sizeHS;
+      nFS = m_nFS;
+      nHS = m_nHS;
+    }
+
+    // fetch is only needed when data is not complete, tiled frames then fetch the tiles in the region
+    inline void decodeCurrentFrameData(const VideoFrameStruct &vfrm, const char *data, const FetchFunc &fetch = nullptr)
+    {
+      // the current textures already hold a repeated frame, nothing is decoded, uploaded or swapped
+      if(vfrm.referenceType == RepeatPreviousReference)
+        return;
+      if(vfrm.referenceType == LongTermReference && !hasSlot(vfrm.referenceSlot))
+        throw DataError("No reference frame available.");
+      // channels can only be added back on a full frame, their references are stale otherwise
+      if(vfrm.referenceType == NoReference)
       {
-        const char *begin = data;
-        for(int i = 0; i < nChannel; ++i)
+        m_channelMask = m_pendingChannelMask;
+        // references are kept at region size, so the region can only change on a full frame
+        if(!(m_pendingRegion == m_region) || m_pendingScaleShift != m_scaleShift)
         {
-          const char *end = begin + m_colorFormatInfo.channelList[i].width * m_colorFormatInfo.channelList[i].height * sizeof(T);
-          std::copy(begin, end, reinterpret_cast<char*>(m_deintraBuffer[i].begin()));
-          defilterIntra<T>(m_deintraBuffer[i], vfrm.intraPredictModeList[i]);
-          begin = end;
+          m_region = m_pendingRegion;
+          m_scaleShift = m_pendingScaleShift;
+          applyLayout();
         }
       }
-      // convert to interleaved
-      {
-        if(m_mainStruct.colorFormat == YUV420P)
-          std::copy(m_deintraBuffer[0].begin(), m_deintraBuffer[0].end(), m_bufferFS.begin());
-        else if(m_mainStruct.colorFormat == YUVA420P)
-          convertToInterleave<T, 2>({&m_deintraBuffer[0], &m_deintraBuffer[3]}, m_bufferFS);
-        convertToInterleave<T, 2>({&m_deintraBuffer[1], &m_deintraBuffer[2]}, m_bufferHS);
-      }
-
-      if(m_nFS > 0)
-      {
-        glBindTexture(GL_TEXTURE_2D, m_texFS[3]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat8[m_nFS - 1], m_mainStruct.width, m_mainStruct.height, 0, format8[m_nFS - 1], GL_UNSIGNED_BYTE, m_bufferFS.data());
-      }
-      if(m_nHS > 0)
+      // references are kept at region size, a warped reference would sample outside of it
+      if(hasMotion(vfrm) && !(m_region == Rect{0, 0, m_mainStruct.width, m_mainStruct.height}))
+        throw DataError("Frames with global motion can only be decoded with the full frame as region.");
+      deintra(vfrm, data, fetch);
+      // reduced output is reconstructed on the CPU, see reconstructReduced
+      const ImageChannel<T> *plane = m_deintraBuffer;
+      if(m_scaleShift > 0)
       {
-        glBindTexture(GL_TEXTURE_2D, m_texHS[3]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat8[m_nHS - 1], std::max(1U, m_mainStruct.width / 2), std::max(1U, m_mainStruct.height / 2), 0, format8[m_nHS - 1], GL_UNSIGNED_BYTE, m_bufferHS.data());
+        reconstructReduced(vfrm);
+        plane = m_reducedBuffer;
       }
+      bool needFS, needHS;
+      interleave(plane, needFS, needHS);
+      if(m_nFS > 0 && needFS)
+        upload(m_texFS[3], m_sizeFS, m_nFS, m_bufferFS);
+      if(m_nHS > 0 && needHS)
+        upload(m_texHS[3], m_sizeHS, m_nHS, m_bufferHS);
 
-      if(vfrm.referenceType == NoReference)
+      if(vfrm.referenceType == NoReference || m_scaleShift > 0)
       {
         std::swap(m_texFS[2], m_texFS[3]);
         std::swap(m_texHS[2], m_texHS[3]);
-        m_currIsFull = true;
+        m_currIsFull = vfrm.referenceType == NoReference;
       }
       else // PrevFullReference or PrevReference
       {
@@ -128,67 +216,123 @@ namespace LightVideoDecoder
           refFS = m_texFS[0];
           refHS = m_texHS[0];
         }
+        else if(vfrm.referenceType == LongTermReference)
+        {
+          refFS = m_texSlotFS[vfrm.referenceSlot];
+          refHS = m_texSlotHS[vfrm.referenceSlot];
+        }
         else
         {
           refFS = texPrevFS;
           refHS = texPrevHS;
         }
 
+        // with a skip map the reference is copied and only the runs of changed blocks are added
+        bool skip = m_skipMap->isActive() && m_skipMap->skippedCount() > 0;
         GLuint attachments[1] = {GL_COLOR_ATTACHMENT0};
         GLuint gBuffer;
         glGenFramebuffers(1, &gBuffer);
         glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
         
-        glBindTexture(GL_TEXTURE_2D, m_texFS[2]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat8[m_nFS - 1], m_mainStruct.width, m_mainStruct.height, 0, format8[m_nFS - 1], GL_UNSIGNED_BYTE, nullptr);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texFS[2], 0);
-        glDrawBuffers(1, attachments);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_texFS[3]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, refFS);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glViewport(0, 0, m_mainStruct.width, m_mainStruct.height);
-        drawNMS();
-
-        glBindTexture(GL_TEXTURE_2D, m_texHS[2]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat8[m_nHS - 1], std::max(1U, m_mainStruct.width / 2), std::max(1U, m_mainStruct.height / 2), 0, format8[m_nHS - 1], GL_UNSIGNED_BYTE, nullptr);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texHS[2], 0);
-        glDrawBuffers(1, attachments);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_texHS[3]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, refHS);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-        glViewport(0, 0, std::max(1U, m_mainStruct.width / 2), std::max(1U, m_mainStruct.height / 2));
-        drawNMS();
+        if(needFS)
+        {
+          glBindTexture(GL_TEXTURE_2D, m_texFS[2]);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+          glTexImage2D(GL_TEXTURE_2D, 0, internalFormat8[m_nFS - 1], m_sizeFS.width, m_sizeFS.height, 0, format8[m_nFS - 1], GL_UNSIGNED_BYTE, nullptr);
+          glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texFS[2], 0);
+          glDrawBuffers(1, attachments);
+
+          glActiveTexture(GL_TEXTURE0);
+          glBindTexture(GL_TEXTURE_2D, m_texFS[3]);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+          glActiveTexture(GL_TEXTURE1);
+          glBindTexture(GL_TEXTURE_2D, refFS);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+          glViewport(0, 0, m_sizeFS.width, m_sizeFS.height);
+          if(skip)
+            drawNMSRects(refFS, m_sizeFS, m_skipMap->getChangedRuns(0, m_channelRegion[0]));
+          else
+            drawNMS(getChannelMotionMap(vfrm, m_colorFormatInfo, 0));
+        }
+
+        if(needHS)
+        {
+          glBindTexture(GL_TEXTURE_2D, m_texHS[2]);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+          glTexImage2D(GL_TEXTURE_2D, 0, internalFormat8[m_nHS - 1], m_sizeHS.width, m_sizeHS.height, 0, format8[m_nHS - 1], GL_UNSIGNED_BYTE, nullptr);
+          glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texHS[2], 0);
+          glDrawBuffers(1, attachments);
+
+          glActiveTexture(GL_TEXTURE0);
+          glBindTexture(GL_TEXTURE_2D, m_texHS[3]);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+          glActiveTexture(GL_TEXTURE1);
+          glBindTexture(GL_TEXTURE_2D, refHS);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+          glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+          glViewport(0, 0, m_sizeHS.width, m_sizeHS.height);
+          if(skip)
+            drawNMSRects(refHS, m_sizeHS, m_skipMap->getChangedRuns(1, m_channelRegion[1]));
+          else
+            drawNMS(getChannelMotionMap(vfrm, m_colorFormatInfo, 1));
+        }
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glDeleteFramebuffers(1, &gBuffer);
 
         m_currIsFull = false;
       }
+
+      if(vfrm.storeSlotMask)
+        storeSlots(vfrm.storeSlotMask);
+    }
+
+    // a slot holds a key frame decoded with the current layout and at least the current channels
+    inline bool hasSlot(uint32_t slot) const
+    { return m_slotChannelMask[slot] != 0 && (m_slotChannelMask[slot] & m_channelMask) == m_channelMask; }
+
+    // slots are lazily restored after a seek, see Decoder::restoreSlot
+    inline void clearSlots()
+    { std::fill(m_slotChannelMask.begin(), m_slotChannelMask.end(), 0); }
+
+    // decodes the key frame vfrm straight into a slot, neither the output nor the other references are touched
+    inline void restoreSlot(uint32_t slot, const VideoFrameStruct &vfrm, const char *data)
+    {
+      lvdAssert(vfrm.referenceType == NoReference, "Only key frames are stored in slots.");
+      deintra(vfrm, data, nullptr);
+      if(m_scaleShift > 0)
+      {
+        std::vector<ImageChannel<T>> &planes = slotPlanes(slot);
+        for(size_t i = 0; i < planes.size(); ++i)
+        {
+          if(m_channelMask & (1U << i))
+            std::swap(planes[i], m_deintraBuffer[i]);
+        }
+      }
+      else
+      {
+        bool needFS, needHS;
+        interleave(m_deintraBuffer, needFS, needHS);
+        if(m_nFS > 0)
+          upload(m_texSlotFS[slot], m_sizeFS, m_nFS, m_bufferFS);
+        if(m_nHS > 0)
+          upload(m_texSlotHS[slot], m_sizeHS, m_nHS, m_bufferHS);
+      }
+      m_slotChannelMask[slot] = m_channelMask;
     }
 
     inline uint32_t currentTextureFS() const
@@ -198,7 +342,266 @@ namespace LightVideoDecoder
     { return m_texHS[2]; }
 
   private:
-    ImageChannel<T> m_deintraBuffer[8];
+    struct TileJob
+    {
+      int channel;
+      uint32_t tile;
+    };
+
+    // defilters the channels in the mask to the deintra buffers, cropped to the region
+    inline void deintra(const VideoFrameStruct &vfrm, const char *data, const FetchFunc &fetch)
+    {
+      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+      auto needed = [this](int i) { return (m_channelMask & (1U << i)) != 0; };
+      if(m_tileLayout.nTile > 0)
+        defilterTiles(data, fetch);
+      else if(vfrm.skipBlockSize != NoSkipMap)
+      {
+        // unchanged blocks keep stale content, the reconstruction takes them from the reference
+        const char *blockData = data + m_skipMap->bitmapSize(vfrm);
+        m_blockBuffer.resize(static_cast<size_t>(m_skipMap->layout().tileRect[0][0].width) * m_skipMap->layout().tileRect[0][0].height);
+        for(int i = 0; i < nChannel; ++i)
+        {
+          if(needed(i))
+            defilterChangedBlocks<T>(blockData, vfrm.intraPredictModeList[i], *m_skipMap, i, m_channelRegion[i], m_blockBuffer.data(), m_deintraBuffer[i]);
+        }
+      }
+      else
+      {
+        if(fetch)
+          fetch({{0, m_colorFormatInfo.dataSize}});
+        const char *begin = data;
+        for(int i = 0; i < nChannel; ++i)
+        {
+          const Size &s = m_colorFormatInfo.channelList[i];
+          const char *end = begin + s.width * s.height * sizeof(T);
+          if(needed(i))
+            defilterIntraRegion<T>(reinterpret_cast<const T*>(begin), s.width, vfrm.intraPredictModeList[i], m_channelRegion[i], m_regionBuffer, m_deintraBuffer[i]);
+          begin = end;
+        }
+      }
+    }
+
+    // converts the planes to the interleaved upload buffers, groups without any channel in the mask are skipped
+    inline void interleave(const ImageChannel<T> *plane, bool &needFS, bool &needHS)
+    {
+      auto needed = [this](int i) { return (m_channelMask & (1U << i)) != 0; };
+      needFS = false;
+      needHS = needed(1) || needed(2);
+      if(m_mainStruct.colorFormat == YUV420P)
+      {
+        needFS = needed(0);
+        if(needFS)
+          std::copy(plane[0].begin(), plane[0].end(), m_bufferFS.begin());
+      }
+      else if(m_mainStruct.colorFormat == YUVA420P)
+      {
+        needFS = needed(0) || needed(3);
+        if(needFS)
+          convertToInterleave<T, 2>({needed(0) ? &plane[0] : nullptr, needed(3) ? &plane[3] : nullptr}, m_bufferFS);
+      }
+      if(needHS)
+        convertToInterleave<T, 2>({needed(1) ? &plane[1] : nullptr, needed(2) ? &plane[2] : nullptr}, m_bufferHS);
+    }
+
+    inline void upload(GLuint tex, const Size &size, int n, const ImageChannel<T> &buffer)
+    {
+      glBindTexture(GL_TEXTURE_2D, tex);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexImage2D(GL_TEXTURE_2D, 0, internalFormat8[n - 1], size.width, size.height, 0, format8[n - 1], GL_UNSIGNED_BYTE, buffer.data());
+    }
+
+    // slot planes are kept at region size like the references and allocated on first use
+    inline std::vector<ImageChannel<T>> &slotPlanes(uint32_t slot)
+    {
+      std::vector<ImageChannel<T>> &planes = m_slotPlaneSet[slot];
+      if(planes.empty())
+      {
+        for(const Rect &r : m_channelRegion)
+          planes.emplace_back(r.width, r.height);
+      }
+      return planes;
+    }
+
+    // copies the current frame into the slots, textures are copied on the GPU, groups without decoded channels are skipped
+    inline void storeSlots(uint32_t mask)
+    {
+      bool activeFS = (m_channelMask & (m_nFS > 1 ? (LumaChannel | AlphaChannel) : LumaChannel)) != 0;
+      bool activeHS = (m_channelMask & ChromaChannel) != 0;
+      for(uint32_t slot = 0; slot < m_slotChannelMask.size(); ++slot)
+      {
+        if(!((mask >> slot) & 1))
+          continue;
+        if(m_scaleShift > 0)
+        {
+          std::vector<ImageChannel<T>> &planes = slotPlanes(slot);
+          for(size_t i = 0; i < planes.size(); ++i)
+          {
+            if(m_channelMask & (1U << i))
+              std::copy(m_planeSet[m_prev][i].begin(), m_planeSet[m_prev][i].end(), planes[i].begin());
+          }
+        }
+        else
+        {
+          if(m_nFS > 0 && activeFS)
+            copyTexture(m_texFS[2], m_texSlotFS[slot], m_sizeFS, internalFormat8[m_nFS - 1], format8[m_nFS - 1]);
+          if(m_nHS > 0 && activeHS)
+            copyTexture(m_texHS[2], m_texSlotHS[slot], m_sizeHS, internalFormat8[m_nHS - 1], format8[m_nHS - 1]);
+        }
+        m_slotChannelMask[slot] = m_channelMask;
+      }
+    }
+
+    // the tiles intersecting the region are defiltered on the thread pool, straight into the deintra buffers
+    inline void defilterTiles(const char *data, const FetchFunc &fetch)
+    {
+      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+      const IntraPredictMode *modeTable = reinterpret_cast<const IntraPredictMode*>(data);
+      const char *tileData = data + m_tileLayout.modeTableSize;
+      std::vector<bool> inRegion(m_tileLayout.nTile, false);
+      m_tileJobList.clear();
+      for(int i = 0; i < nChannel; ++i)
+      {
+        if(!(m_channelMask & (1U << i)))
+          continue;
+        for(uint32_t t : getTilesInRect(m_tileLayout, i, m_channelRegion[i]))
+        {
+          if(modeTable[t * nChannel + i] >= _INTRAPREDICTMODE_ENUM_MAX)
+            throw DataError("Tile intra mode is invalid.");
+          inRegion[t] = true;
+          m_tileJobList.push_back({i, t});
+        }
+      }
+      // the tiles are fetched in one go, so their chunks can be decompressed in parallel
+      if(fetch)
+      {
+        std::vector<DataRange> rangeList;
+        for(uint32_t t = 0; t < m_tileLayout.nTile; ++t)
+        {
+          if(!inRegion[t])
+            continue;
+          uint32_t begin = m_tileLayout.modeTableSize + (t ? m_tileLayout.tileEnd[t - 1] : 0);
+          if(!rangeList.empty() && rangeList.back().end == begin)
+            rangeList.back().end = m_tileLayout.modeTableSize + m_tileLayout.tileEnd[t];
+          else
+            rangeList.push_back({begin, m_tileLayout.modeTableSize + m_tileLayout.tileEnd[t]});
+        }
+        if(!rangeList.empty())
+          fetch(rangeList);
+      }
+
+      auto run = [&](uint32_t index, uint32_t slot)
+      {
+        const TileJob &job = m_tileJobList[index];
+        const T *src = reinterpret_cast<const T*>(tileData + m_tileLayout.tileOffset[job.channel][job.tile]);
+        defilterTile<T>(src, modeTable[job.tile * nChannel + job.channel], m_tileLayout.tileRect[job.channel][job.tile],
+          m_channelRegion[job.channel], m_tileBuffer[slot].data(), m_deintraBuffer[job.channel]);
+      };
+      uint32_t nJob = static_cast<uint32_t>(m_tileJobList.size());
+      if(m_threadPool)
+        m_threadPool->parallelFor(nJob, run);
+      else
+      {
+        for(uint32_t i = 0; i < nJob; ++i)
+          run(i, 0);
+      }
+    }
+
+    /*
+      The wrapping add of a delta frame doesn't commute with the box filter,
+      so the references are kept at region size and only the output is reduced, in the same pass as the add.
+      The planes are swapped with the deintra buffers instead of being copied.
+    */
+    inline void reconstructReduced(const VideoFrameStruct &vfrm)
+    {
+      int curr = 0;
+      while(curr == m_prev || curr == m_prevFull)
+        ++curr;
+
+      const std::vector<ImageChannel<T>> *ref = nullptr;
+      if(vfrm.referenceType == PreviousFullReference && m_prevFull >= 0)
+        ref = &m_planeSet[m_prevFull];
+      else if(vfrm.referenceType == PreviousReference && m_prev >= 0)
+        ref = &m_planeSet[m_prev];
+      else if(vfrm.referenceType == LongTermReference)
+        ref = &m_slotPlaneSet[vfrm.referenceSlot];
+      if(vfrm.referenceType != NoReference && !ref)
+        throw DataError("No reference frame available.");
+
+      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+      for(int i = 0; i < nChannel; ++i)
+      {
+        if(!(m_channelMask & (1U << i)))
+          continue;
+        std::swap(m_deintraBuffer[i], m_planeSet[curr][i]);
+        if(ref && m_skipMap->isActive())
+        {
+          addDeltaSkipBlocks<T>(m_planeSet[curr][i], (*ref)[i], *m_skipMap, i, m_channelRegion[i]);
+          reduceBox<T>(m_planeSet[curr][i], m_reducedBuffer[i], m_scaleShift);
+        }
+        else if(ref && hasMotion(vfrm))
+        {
+          defilterDelta<T>(m_planeSet[curr][i], (*ref)[i], getChannelMotionMap(vfrm, m_colorFormatInfo, i));
+          reduceBox<T>(m_planeSet[curr][i], m_reducedBuffer[i], m_scaleShift);
+        }
+        else if(ref)
+          addDeltaReduceBox<T>(m_planeSet[curr][i], (*ref)[i], m_reducedBuffer[i], m_scaleShift);
+        else
+          reduceBox<T>(m_planeSet[curr][i], m_reducedBuffer[i], m_scaleShift);
+      }
+
+      m_prev = curr;
+      if(vfrm.referenceType == NoReference)
+        m_prevFull = curr;
+    }
+
+    inline void applyLayout()
+    {
+      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+      uint32_t regionBufferSize = 0;
+      m_channelRegion.clear();
+      for(int i = 0; i < 3; ++i)
+      {
+        m_planeSet[i].clear();
+        m_planeSet[i].reserve(nChannel);
+      }
+      m_prev = -1;
+      m_prevFull = -1;
+      // slots are restored at the new layout when they are referenced
+      clearSlots();
+      for(std::vector<ImageChannel<T>> &planes : m_slotPlaneSet)
+        planes.clear();
+      for(int i = 0; i < nChannel; ++i)
+      {
+        Rect r = mapRegionToChannel(m_region, m_mainStruct.width, m_mainStruct.height, m_colorFormatInfo.channelList[i]);
+        m_channelRegion.push_back(r);
+        m_deintraBuffer[i] = ImageChannel<T>(r.width, r.height);
+        if(m_scaleShift > 0)
+        {
+          for(int j = 0; j < 3; ++j)
+            m_planeSet[j].emplace_back(r.width, r.height);
+          m_reducedBuffer[i] = ImageChannel<T>(getReducedLength(r.width, m_scaleShift), getReducedLength(r.height, m_scaleShift));
+        }
+        else
+          m_reducedBuffer[i] = ImageChannel<T>();
+        // a region anchored at the origin is its own dependency for every mode
+        if(r.x > 0 || r.y > 0)
+          regionBufferSize = std::max(regionBufferSize, (r.x + r.width) * (r.y + r.height));
+      }
+      if(m_regionBuffer)
+        lvdFree(m_regionBuffer);
+      m_regionBuffer = regionBufferSize > 0 ? LVDALLOC(T, regionBufferSize) : nullptr;
+
+      m_sizeFS = Size(getReducedLength(m_channelRegion[0].width, m_scaleShift), getReducedLength(m_channelRegion[0].height, m_scaleShift));
+      m_sizeHS = Size(getReducedLength(m_channelRegion[1].width, m_scaleShift), getReducedLength(m_channelRegion[1].height, m_scaleShift));
+      if(m_nFS > 0)
+        m_bufferFS = ImageChannel<T>(m_sizeFS.width * m_nFS, m_sizeFS.height);
+      if(m_nHS > 0)
+        m_bufferHS = ImageChannel<T>(m_sizeHS.width * m_nHS, m_sizeHS.height);
+    }
+
+    ImageChannel<T> m_deintraBuffer[8], m_reducedBuffer[8];
     ImageChannel<T> m_bufferFS, m_bufferHS;
     GLuint m_texFS[4];
     GLuint m_texHS[4];
@@ -206,6 +609,28 @@ namespace LightVideoDecoder
 
     const MainStruct &m_mainStruct;
     ColorFormatInfo m_colorFormatInfo;
+    uint32_t m_channelMask, m_pendingChannelMask;
+    Rect m_region, m_pendingRegion;
+    std::vector<Rect> m_channelRegion;
+    Size m_sizeFS, m_sizeHS;
+    T *m_regionBuffer;
+    int m_scaleShift, m_pendingScaleShift;
+    std::vector<ImageChannel<T>> m_planeSet[3];
+    int m_prev, m_prevFull;
     bool m_currIsFull;
+
+    /* long-term slot */
+    std::vector<GLuint> m_texSlotFS, m_texSlotHS;
+    std::vector<std::vector<ImageChannel<T>>> m_slotPlaneSet; // reduced output only
+    std::vector<uint32_t> m_slotChannelMask; // channels a slot was decoded with, 0 for empty
+
+    /* tile */
+    TileLayout m_tileLayout;
+    ThreadPool *m_threadPool;
+    std::vector<std::vector<T>> m_tileBuffer; // one per thread pool slot
+    std::vector<TileJob> m_tileJobList;
+
+    /* skip map */
+    std::vector<T> m_blockBuffer;
   };
 }
\ No newline at end of file
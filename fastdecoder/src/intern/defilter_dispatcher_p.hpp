@@ -3,6 +3,8 @@
 #include "../struct.hpp"
 #include "../imagechannel.hpp"
 #include "util_p.hpp"
+#include "motion_p.hpp"
+#include <vector>
 
 #if defined(__AVX2__)
 #include "defilter_avx2_p.hpp"
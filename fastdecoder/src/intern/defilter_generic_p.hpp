@@ -96,36 +96,21 @@ namespace LightVideoDecoder
   }
 
   template<typename T>
-  static void defilterDelta(ImageChannel<T> &img, const ImageChannel<T> &ref, int scale, int moveX, int moveY)
+  static void defilterDelta(ImageChannel<T> &img, const ImageChannel<T> &ref, const MotionMap &motion)
   {
     lvdAssert(img.width() == ref.width() && img.height() == ref.height(), "Shape dismatch");
     lvdAssert(img.width() <= 32767 && img.height() <= 32767, "Input is too large");
     int width = img.width(), height = img.height();
-    if(scale != 0 || moveX != 0 || moveY == 0)
+    if(!motion.isIdentity())
     {
-      int nScaledW, nScaledH;
-      if(height < width)
-      {
-        nScaledH = std::max(1, height + scale);
-        nScaledW = std::max(1, width * nScaledH / height);
-      }
-      else
-      {
-        nScaledW = std::max(1, width + scale);
-        nScaledH = std::max(1, height * nScaledW / width);
-      }
-
-      int halfDiffW = (nScaledW - width) / 2;
-      int halfDiffH = (nScaledH - height) / 2;
+      std::vector<int> mappedX(width);
+      for(int j = 0; j < width; ++j)
+        mappedX[j] = motion.mapX(j);
       for(int i = 0; i < height; ++i)
       {
+        int mappedY = motion.mapY(i);
         for(int j = 0; j < width; ++j)
-        {
-          uint32_t mappedX = static_cast<uint32_t>(clip(0, (j + halfDiffW - moveX) * width / nScaledW, width - 1));
-          uint32_t mappedY = static_cast<uint32_t>(clip(0, (i + halfDiffH - moveY) * height / nScaledH, height - 1));
-          T refV = ref(mappedY, mappedX);
-          img(i, j) += refV;
-        }
+          img(i, j) += ref(mappedY, mappedX[j]);
       }
     }
     else
@@ -65,36 +65,21 @@ namespace LightVideoDecoder
   }
 
   template<typename T>
-  static void defilterDelta(ImageChannel<T> &img, const ImageChannel<T> &ref, int scale, int moveX, int moveY) // not vectorized, use glsl instead
+  static void defilterDelta(ImageChannel<T> &img, const ImageChannel<T> &ref, const MotionMap &motion) // not vectorized, use glsl instead
   {
     lvdAssert(img.width() == ref.width() && img.height() == ref.height(), "Shape dismatch");
     lvdAssert(img.width() <= 32767 && img.height() <= 32767, "Input is too large");
     int width = img.width(), height = img.height();
-    if(scale != 0 || moveX != 0 || moveY == 0)
+    if(!motion.isIdentity())
     {
-      int nScaledW, nScaledH;
-      if(height < width)
-      {
-        nScaledH = std::max(1, height + scale);
-        nScaledW = std::max(1, width * nScaledH / height);
-      }
-      else
-      {
-        nScaledW = std::max(1, width + scale);
-        nScaledH = std::max(1, height * nScaledW / width);
-      }
-
-      int halfDiffW = (nScaledW - width) / 2;
-      int halfDiffH = (nScaledH - height) / 2;
+      std::vector<int> mappedX(width);
+      for(int j = 0; j < width; ++j)
+        mappedX[j] = motion.mapX(j);
       for(int i = 0; i < height; ++i)
       {
+        int mappedY = motion.mapY(i);
         for(int j = 0; j < width; ++j)
-        {
-          uint32_t mappedX = static_cast<uint32_t>(clip(0, (j + halfDiffW - moveX) * width / nScaledW, width - 1));
-          uint32_t mappedY = static_cast<uint32_t>(clip(0, (i + halfDiffH - moveY) * height / nScaledH, height - 1));
-          T refV = ref(mappedY, mappedX);
-          img(i, j) += refV;
-        }
+          img(i, j) += ref(mappedY, mappedX[j]);
       }
     }
     else
@@ -124,12 +109,12 @@ namespace LightVideoDecoder
     {
       for(int y = 1; y < height; ++y)
       {
-        int alignDiff = (16 - (reinterpret_cast<size_t>(img.data()) % 16)) % 16;
+        int alignDiff = (16 - (reinterpret_cast<size_t>(&img(y, 0)) % 16)) % 16;
         for(int x = 0; x < alignDiff; ++x)
           img(y, x) += img(y - 1, x);
         for(int x = alignDiff; x < width - (width - alignDiff) % 16; x += 16)
         {
-          __m128i a = _mm_load_si128(reinterpret_cast<__m128i*>(&img(y - 1, x)));
+          __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i*>(&img(y - 1, x))); // the row above is not aligned in general
           __m128i b = _mm_load_si128(reinterpret_cast<__m128i*>(&img(y, x)));
           a = _mm_add_epi8(a, b);
           _mm_store_si128(reinterpret_cast<__m128i*>(&img(y, x)), a);
@@ -202,12 +187,12 @@ namespace LightVideoDecoder
     {
       for(int y = 1; y < height; ++y)
       {
-        int alignDiff = (8 - (reinterpret_cast<size_t>(img.data()) % 16) / 2) % 8;
+        int alignDiff = (8 - (reinterpret_cast<size_t>(&img(y, 0)) % 16) / 2) % 8;
         for(int x = 0; x < alignDiff; ++x)
           img(y, x) += img(y - 1, x);
         for(int x = alignDiff; x < width - (width - alignDiff) % 8; x += 8)
         {
-          __m128i a = _mm_load_si128(reinterpret_cast<__m128i*>(&img(y - 1, x)));
+          __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i*>(&img(y - 1, x))); // the row above is not aligned in general
           __m128i b = _mm_load_si128(reinterpret_cast<__m128i*>(&img(y, x)));
           a = _mm_add_epi16(a, b);
           _mm_store_si128(reinterpret_cast<__m128i*>(&img(y, x)), a);
@@ -0,0 +1,132 @@
+#include "framecache_p.hpp"
+#include "decoderimpl_p.hpp"
+#include "util_p.hpp"
+
+namespace LightVideoDecoder
+{
+  FrameCache::FrameCache(uint64_t budget)
+    : m_budget(budget), m_used(0), m_hitCount(0), m_missCount(0)
+  { glGenFramebuffers(2, m_fbo); }
+
+  FrameCache::~FrameCache()
+  {
+    clear();
+    glDeleteFramebuffers(2, m_fbo);
+  }
+
+  const CachedFrame *FrameCache::find(uint32_t frameNumber)
+  {
+    auto it = m_frameMap.find(frameNumber);
+    if(it == m_frameMap.end())
+    {
+      ++m_missCount;
+      return nullptr;
+    }
+    ++m_hitCount;
+    m_frameList.splice(m_frameList.begin(), m_frameList, it->second);
+    return &*it->second;
+  }
+
+  bool FrameCache::contains(uint32_t frameNumber) const
+  { return m_frameMap.count(frameNumber) > 0; }
+
+  // a group without any decoded channel has no storage and is not copied
+  static GLuint copyTexture(const GLuint *fbo, GLuint src, const Size &size, int n)
+  {
+    if(src == 0 || n == 0)
+      return 0;
+    GLuint dst;
+    glGenTextures(1, &dst);
+    glBindTexture(GL_TEXTURE_2D, dst);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat8[n - 1], size.width, size.height, 0, format8[n - 1], GL_UNSIGNED_BYTE, nullptr);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo[0]);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo[1]);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst, 0);
+    GLuint attachments[1] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, attachments);
+    glBlitFramebuffer(0, 0, size.width, size.height, 0, 0, size.width, size.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return dst;
+  }
+
+  void FrameCache::insert(uint32_t frameNumber, bool pinned, GLuint texFS, const Size &sizeFS, int nFS, GLuint texHS, const Size &sizeHS, int nHS)
+  {
+    if(contains(frameNumber))
+      return;
+    uint64_t size = 0;
+    if(texFS)
+      size += static_cast<uint64_t>(sizeFS.width) * sizeFS.height * nFS;
+    if(texHS)
+      size += static_cast<uint64_t>(sizeHS.width) * sizeHS.height * nHS;
+    if(!reserve(size))
+      return;
+
+    CachedFrame frame;
+    frame.frameNumber = frameNumber;
+    frame.pinned = pinned;
+    frame.texFS = copyTexture(m_fbo, texFS, sizeFS, nFS);
+    frame.texHS = copyTexture(m_fbo, texHS, sizeHS, nHS);
+    frame.size = size;
+    m_frameList.push_front(frame);
+    m_frameMap[frameNumber] = m_frameList.begin();
+    m_used += size;
+  }
+
+  void FrameCache::alias(uint32_t frameNumber, uint32_t source)
+  {
+    auto it = m_frameMap.find(source);
+    if(it == m_frameMap.end() || contains(frameNumber))
+      return;
+    it->second->aliasList.push_back(frameNumber);
+    m_frameMap[frameNumber] = it->second;
+  }
+
+  void FrameCache::clear()
+  {
+    while(!m_frameList.empty())
+      release(std::prev(m_frameList.end()));
+  }
+
+  FrameCacheStats FrameCache::stats() const
+  {
+    FrameCacheStats out;
+    out.hitCount = m_hitCount;
+    out.missCount = m_missCount;
+    out.usedBytes = m_used;
+    out.budgetBytes = m_budget;
+    out.frameCount = static_cast<uint32_t>(m_frameList.size());
+    return out;
+  }
+
+  bool FrameCache::reserve(uint64_t size)
+  {
+    if(size > m_budget)
+      return false;
+    auto it = m_frameList.end();
+    while(m_used + size > m_budget && it != m_frameList.begin())
+    {
+      --it;
+      if(!it->pinned)
+        release(it++);
+    }
+    return m_used + size <= m_budget;
+  }
+
+  void FrameCache::release(std::list<CachedFrame>::iterator it)
+  {
+    if(it->texFS)
+      glDeleteTextures(1, &it->texFS);
+    if(it->texHS)
+      glDeleteTextures(1, &it->texHS);
+    m_used -= it->size;
+    m_frameMap.erase(it->frameNumber);
+    for(uint32_t frameNumber : it->aliasList)
+      m_frameMap.erase(frameNumber);
+    m_frameList.erase(it);
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
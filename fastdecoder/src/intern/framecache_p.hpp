@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../decoder.hpp"
+#include "../colorformat.hpp"
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "glad/glad.h"
+
+namespace LightVideoDecoder
+{
+  struct CachedFrame
+  {
+    uint32_t frameNumber;
+    bool pinned;
+    GLuint texFS, texHS;
+    uint64_t size;
+    std::vector<uint32_t> aliasList; // repeated frames that share the textures
+  };
+
+  /*
+    Keeps copies of decoded textures, keyed by frame number.
+    Unpinned frames are evicted least recently used first, pinned (key) frames are only dropped by clear().
+    A repeated frame is an alias of the frame it repeats and is found as long as that frame is cached.
+  */
+  class FrameCache final
+  {
+  public:
+    FrameCache(uint64_t budget);
+    ~FrameCache();
+
+    // counts a hit or a miss, the returned entry stays valid until the next insert or clear
+    const CachedFrame *find(uint32_t frameNumber);
+    bool contains(uint32_t frameNumber) const;
+    void insert(uint32_t frameNumber, bool pinned, GLuint texFS, const Size &sizeFS, int nFS, GLuint texHS, const Size &sizeHS, int nHS);
+    // frameNumber is found as the cached frame source, which may itself be an alias, does nothing if source is not cached
+    void alias(uint32_t frameNumber, uint32_t source);
+    void clear();
+
+    FrameCacheStats stats() const;
+
+  private:
+    bool reserve(uint64_t size);
+    void release(std::list<CachedFrame>::iterator it);
+
+    std::list<CachedFrame> m_frameList; // most recently used first
+    std::unordered_map<uint32_t, std::list<CachedFrame>::iterator> m_frameMap; // frames and their aliases
+    uint64_t m_budget, m_used;
+    uint64_t m_hitCount, m_missCount;
+    GLuint m_fbo[2];
+  };
+} // namespace LightVideoDecoder
\ No newline at end of file
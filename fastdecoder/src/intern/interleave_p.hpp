@@ -5,16 +5,18 @@
 
 namespace LightVideoDecoder
 {
+  // null planes are skipped and leave their slots untouched
   template<typename T, int N>static inline void convertToInterleave(const std::array<const ImageChannel<T>*, N> &planeList, ImageChannel<T> &target)
   {
     static_assert(N > 1, "N must be greater than 1.");
-    lvdAssert(target.width() / N == planeList[0]->width(), "Bad target shape");
-    lvdAssert(target.height() == planeList[0]->height(), "Bad target shape");
-
     int size = target.width() * target.height();
     T *targetData = target.data();
     for(int j = 0; j < N; ++j)
     {
+      if(!planeList[j])
+        continue;
+      lvdAssert(target.width() / N == planeList[j]->width(), "Bad target shape");
+      lvdAssert(target.height() == planeList[j]->height(), "Bad target shape");
       for(int i = j; i < size; i += N)
         targetData[i] = planeList[j]->data()[i / N];
     }
@@ -0,0 +1,75 @@
+#include "longterm_p.hpp"
+#include "../error.hpp"
+#include "tile_p.hpp"
+#include "skipmap_p.hpp"
+#include <algorithm>
+
+namespace LightVideoDecoder
+{
+  SlotFrame readSlotFrame(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo, const std::vector<PacketIndexEntry> &packetIndex,
+    uint32_t slot, uint32_t pos, const std::function<void(char*, int64_t)> &read, const std::function<void(int64_t)> &seek)
+  {
+    uint32_t modeTableSize = getTileCount(mainStruct) * static_cast<uint32_t>(colorFormatInfo.channelList.size());
+    SkipMap skipMap(mainStruct, colorFormatInfo);
+    std::vector<char> payload, packetData;
+    auto it = std::upper_bound(packetIndex.begin(), packetIndex.end(), pos,
+      [](uint32_t v, const PacketIndexEntry &entry) { return v < entry.firstFrame; });
+    for(size_t iPacket = it - packetIndex.begin(); iPacket-- > 0;)
+    {
+      const PacketIndexEntry &entry = packetIndex[iPacket];
+      if(!((entry.vfpk.storeSlotMask >> slot) & 1))
+        continue;
+
+      uint32_t maxUncompressedSize = getMaxUncompressedPacketSize(mainStruct, colorFormatInfo, entry.vfpk);
+      if(entry.vfpk.size > getMaxCompressedPacketSize(maxUncompressedSize) ||
+        (entry.vfpk.compressionMethod == NoCompression && entry.vfpk.size > maxUncompressedSize))
+        throw DataError("Video packet is too large.");
+      payload.resize(entry.vfpk.size);
+      seek(entry.offset + sizeof(VideoFramePacket));
+      read(payload.data(), entry.vfpk.size);
+      uint32_t packetDataSize = entry.vfpk.size;
+      const char *begin = payload.data();
+      if(entry.vfpk.compressionMethod != NoCompression)
+      {
+        packetData.resize(maxUncompressedSize);
+        packetDataSize = decompressPacketData(entry.vfpk, payload.data(), packetData.data(), maxUncompressedSize);
+        begin = packetData.data();
+      }
+
+      // the last matching record wins, the header and the skip map tell where the next one starts
+      uint32_t recordOffset = 0, foundOffset = 0, foundSize = 0;
+      SlotFrame out;
+      bool found = false;
+      for(uint32_t i = 0; i < entry.vfpk.nFrame && entry.firstFrame + i < pos; ++i)
+      {
+        VideoFrameStruct vfrm;
+        if(packetDataSize - recordOffset < sizeof(VideoFrameStruct))
+          throw DataError("Video packet holds fewer frames than it claims.");
+        std::copy(begin + recordOffset, begin + recordOffset + sizeof(VideoFrameStruct), reinterpret_cast<char*>(&vfrm));
+        if(!verifyVFRM(mainStruct, vfrm))
+          throw DataError("Video frame is invalid");
+        uint32_t headerSize = static_cast<uint32_t>(sizeof(VideoFrameStruct)) + (vfrm.referenceType == RepeatPreviousReference ? 0 : modeTableSize) + skipMap.bitmapSize(vfrm);
+        if(packetDataSize - recordOffset < headerSize)
+          throw DataError("Video packet holds fewer frames than it claims.");
+        uint32_t recordSize = headerSize + skipMap.load(vfrm, begin + recordOffset + headerSize - skipMap.bitmapSize(vfrm));
+        if(packetDataSize - recordOffset < recordSize)
+          throw DataError("Video packet holds fewer frames than it claims.");
+        if((vfrm.storeSlotMask >> slot) & 1)
+        {
+          out.frameNumber = entry.firstFrame + i;
+          out.vfrm = vfrm;
+          foundOffset = recordOffset + static_cast<uint32_t>(sizeof(VideoFrameStruct));
+          foundSize = recordSize - static_cast<uint32_t>(sizeof(VideoFrameStruct));
+          found = true;
+        }
+        recordOffset += recordSize;
+      }
+      if(found)
+      {
+        out.data.assign(begin + foundOffset, begin + foundOffset + foundSize);
+        return out;
+      }
+    }
+    throw DataError("No reference frame available.");
+  }
+} // namespace LightVideoDecoder
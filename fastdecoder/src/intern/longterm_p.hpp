@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../struct.hpp"
+#include "../colorformat.hpp"
+#include "packet_p.hpp"
+#include <functional>
+#include <vector>
+
+namespace LightVideoDecoder
+{
+  /*
+    Only key frames are stored in long-term slots, so the content of a slot at any frame is a single key frame.
+    VideoFramePacket::storeSlotMask tells which packets have to be looked into.
+  */
+  struct SlotFrame
+  {
+    uint32_t frameNumber;
+    VideoFrameStruct vfrm;
+    std::vector<char> data; // the record behind VideoFrameStruct
+  };
+
+  // reads the last key frame in front of pos which stores slot, throws if there is none
+  SlotFrame readSlotFrame(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo, const std::vector<PacketIndexEntry> &packetIndex,
+    uint32_t slot, uint32_t pos, const std::function<void(char*, int64_t)> &read, const std::function<void(int64_t)> &seek);
+} // namespace LightVideoDecoder
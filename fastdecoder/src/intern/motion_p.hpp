@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../struct.hpp"
+#include "../colorformat.hpp"
+#include "util_p.hpp"
+#include <cstdint>
+
+namespace LightVideoDecoder
+{
+  /*
+    Where a delta frame with global motion samples its reference, the same mapping as lvMotionResample8() of the encoder helper.
+    The reference is scaled around its center by scale samples along its shorter side, keeping the aspect ratio, and moved by moveX, moveY.
+    Products are taken in 64 bit, the values are not bounded by the format.
+  */
+  struct MotionMap
+  {
+    int width, height, scaledWidth, scaledHeight, halfDiffW, halfDiffH, moveX, moveY;
+
+    inline bool isIdentity() const
+    { return scaledWidth == width && scaledHeight == height && moveX == 0 && moveY == 0; }
+    inline int mapX(int x) const
+    { return static_cast<int>(clip<int64_t>(0, static_cast<int64_t>(x + halfDiffW - moveX) * width / scaledWidth, width - 1)); }
+    inline int mapY(int y) const
+    { return static_cast<int>(clip<int64_t>(0, static_cast<int64_t>(y + halfDiffH - moveY) * height / scaledHeight, height - 1)); }
+  };
+
+  static inline MotionMap getMotionMap(int width, int height, int scale, int moveX, int moveY)
+  {
+    MotionMap out;
+    out.width = width;
+    out.height = height;
+    if(height < width)
+    {
+      out.scaledHeight = std::max(1, height + scale);
+      out.scaledWidth = std::max(1, static_cast<int>(static_cast<int64_t>(width) * out.scaledHeight / height));
+    }
+    else
+    {
+      out.scaledWidth = std::max(1, width + scale);
+      out.scaledHeight = std::max(1, static_cast<int>(static_cast<int64_t>(height) * out.scaledWidth / width));
+    }
+    out.halfDiffW = (out.scaledWidth - width) / 2;
+    out.halfDiffH = (out.scaledHeight - height) / 2;
+    out.moveX = moveX;
+    out.moveY = moveY;
+    return out;
+  }
+
+  static inline bool hasMotion(const VideoFrameStruct &vfrm)
+  { return vfrm.scale != 0 || vfrm.moveX != 0 || vfrm.moveY != 0; }
+
+  // the motion of vfrm is given in samples of the full size channels, half size channels take half of it rounded toward zero
+  static inline MotionMap getChannelMotionMap(const VideoFrameStruct &vfrm, const ColorFormatInfo &colorFormatInfo, int channel)
+  {
+    const Size &s = colorFormatInfo.channelList[channel];
+    int div = s.width < colorFormatInfo.channelList[0].width ? 2 : 1;
+    return getMotionMap(static_cast<int>(s.width), static_cast<int>(s.height), vfrm.scale / div, vfrm.moveX / div, vfrm.moveY / div);
+  }
+} // namespace LightVideoDecoder
@@ -0,0 +1,121 @@
+#include "packet_p.hpp"
+#include "../error.hpp"
+#include "tile_p.hpp"
+#include "skipmap_p.hpp"
+#include "util_p.hpp"
+#include <algorithm>
+#include <cstring>
+
+extern "C"
+{
+  extern int LZ4_decompress_safe(const char* source, char* dest, int compressedSize, int maxDecompressedSize);
+  extern int LZ4_compressBound(int inputSize);
+}
+
+namespace LightVideoDecoder
+{
+  uint32_t getMaxFrameRecordSize(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo)
+  {
+    // a tiled record has a mode table and never a skip map
+    uint32_t modeTableSize = getTileCount(mainStruct) * static_cast<uint32_t>(colorFormatInfo.channelList.size());
+    return static_cast<uint32_t>(sizeof(VideoFrameStruct)) + modeTableSize + getMaxSkipMapSize(mainStruct) + colorFormatInfo.dataSize;
+  }
+
+  uint32_t getMaxUncompressedPacketSize(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo, const VideoFramePacket &vfpk)
+  { return getMaxFrameRecordSize(mainStruct, colorFormatInfo) * vfpk.nFrame; }
+
+  uint32_t getMaxCompressedPacketSize(uint32_t uncompressedSize)
+  {
+    // each chunk costs a table entry and the LZ4 bound of a block of its own
+    uint32_t maxChunkCount = uncompressedSize / minChunkSize + 1;
+    uint32_t size = std::max(uncompressedSize, static_cast<uint32_t>(LZ4_compressBound(static_cast<int>(uncompressedSize))));
+    return size + getChunkTableSize(maxChunkCount) + maxChunkCount * 16;
+  }
+
+  uint32_t getChunkTableSize(uint32_t nChunk)
+  { return static_cast<uint32_t>(sizeof(uint32_t) + sizeof(LZ4ChunkEntry) * nChunk); }
+
+  void verifyChunkTable(const VideoFramePacket &vfpk, const std::vector<LZ4ChunkEntry> &table, uint64_t maxUncompressedSize)
+  {
+    uint64_t tableSize = getChunkTableSize(static_cast<uint32_t>(table.size()));
+    if(table.empty() || tableSize > vfpk.size)
+      throw DataError("Invalid chunk table.");
+    uint32_t uncompressedBegin = 0, compressedBegin = 0;
+    for(size_t i = 0; i < table.size(); ++i)
+    {
+      const LZ4ChunkEntry &entry = table[i];
+      if(entry.uncompressedEnd <= uncompressedBegin || entry.compressedEnd <= compressedBegin)
+        throw DataError("Invalid chunk table.");
+      if(i + 1 < table.size() && entry.uncompressedEnd - uncompressedBegin < minChunkSize)
+        throw DataError("Invalid chunk table.");
+      uncompressedBegin = entry.uncompressedEnd;
+      compressedBegin = entry.compressedEnd;
+    }
+    if(uncompressedBegin > maxUncompressedSize || tableSize + compressedBegin != vfpk.size)
+      throw DataError("Invalid chunk table.");
+  }
+
+  std::vector<LZ4ChunkEntry> readChunkTable(const VideoFramePacket &vfpk, const char *payload, uint64_t maxUncompressedSize)
+  {
+    uint32_t nChunk;
+    if(vfpk.size < sizeof(nChunk))
+      throw DataError("Invalid chunk table.");
+    memcpy(&nChunk, payload, sizeof(nChunk));
+    if(nChunk == 0 || nChunk > (vfpk.size - sizeof(nChunk)) / sizeof(LZ4ChunkEntry))
+      throw DataError("Invalid chunk table.");
+    std::vector<LZ4ChunkEntry> table(nChunk);
+    memcpy(table.data(), payload + sizeof(nChunk), sizeof(LZ4ChunkEntry) * nChunk);
+    verifyChunkTable(vfpk, table, maxUncompressedSize);
+    return table;
+  }
+
+  void decompressChunk(const std::vector<LZ4ChunkEntry> &table, size_t index, const char *chunkData, char *dst)
+  {
+    uint32_t uncompressedBegin = index ? table[index - 1].uncompressedEnd : 0;
+    uint32_t compressedBegin = index ? table[index - 1].compressedEnd : 0;
+    int uncompressedSize = static_cast<int>(table[index].uncompressedEnd - uncompressedBegin);
+    int compressedSize = static_cast<int>(table[index].compressedEnd - compressedBegin);
+    if(LZ4_decompress_safe(chunkData + compressedBegin, dst + uncompressedBegin, compressedSize, uncompressedSize) != uncompressedSize)
+      throw DataError("Invalid compressed data.");
+  }
+
+  std::vector<PacketIndexEntry> scanPacketIndex(const MainStruct &mainStruct,
+    const std::function<void(char*, int64_t)> &read, const std::function<void(int64_t)> &seek)
+  {
+    std::vector<PacketIndexEntry> index;
+    int64_t offset = sizeof(MainStruct);
+    uint32_t nFrame = 0;
+    while(nFrame < mainStruct.nFrame)
+    {
+      PacketIndexEntry entry;
+      seek(offset);
+      read(reinterpret_cast<char*>(&entry.vfpk), sizeof(VideoFramePacket));
+      if(!verifyVFPK(mainStruct, entry.vfpk))
+        throw DataError("Video packet is invalid.");
+      entry.offset = offset;
+      entry.firstFrame = nFrame;
+      index.push_back(entry);
+
+      offset += sizeof(VideoFramePacket) + entry.vfpk.size;
+      nFrame += entry.vfpk.nFrame;
+    }
+    return index;
+  }
+
+  uint32_t decompressPacketData(const VideoFramePacket &vfpk, const char *src, char *dst, uint32_t maxUncompressedSize)
+  {
+    lvdAssert(vfpk.compressionMethod != NoCompression, "Uncompressed packet should be read directly.");
+    if(vfpk.compressionMethod == ChunkedLZ4Compression)
+    {
+      std::vector<LZ4ChunkEntry> table = readChunkTable(vfpk, src, maxUncompressedSize);
+      const char *chunkData = src + getChunkTableSize(static_cast<uint32_t>(table.size()));
+      for(size_t i = 0; i < table.size(); ++i)
+        decompressChunk(table, i, chunkData, dst);
+      return table.back().uncompressedEnd;
+    }
+    int size = LZ4_decompress_safe(src, dst, vfpk.size, maxUncompressedSize);
+    if(size < 0)
+      throw DataError("Invalid compressed data.");
+    return static_cast<uint32_t>(size);
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
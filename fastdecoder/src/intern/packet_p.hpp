@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../struct.hpp"
+#include "../colorformat.hpp"
+#include <functional>
+#include <vector>
+
+namespace LightVideoDecoder
+{
+  struct PacketIndexEntry
+  {
+    int64_t offset; // offset of VideoFramePacket in stream
+    uint32_t firstFrame;
+    VideoFramePacket vfpk;
+  };
+
+  /*
+    Records vary in size, tiled records carry their intra mode table in front of the data, see TileLayout,
+    and records with a skip map only hold the changed blocks, see SkipMap.
+  */
+  uint32_t getMaxFrameRecordSize(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo);
+  uint32_t getMaxUncompressedPacketSize(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo, const VideoFramePacket &vfpk);
+  // largest payload a packet of uncompressedSize bytes may have, with any compression method
+  uint32_t getMaxCompressedPacketSize(uint32_t uncompressedSize);
+
+  uint32_t getChunkTableSize(uint32_t nChunk);
+  void verifyChunkTable(const VideoFramePacket &vfpk, const std::vector<LZ4ChunkEntry> &table, uint64_t maxUncompressedSize);
+  std::vector<LZ4ChunkEntry> readChunkTable(const VideoFramePacket &vfpk, const char *payload, uint64_t maxUncompressedSize);
+  // dst is the start of the packet data, chunkData the start of the chunks
+  void decompressChunk(const std::vector<LZ4ChunkEntry> &table, size_t index, const char *chunkData, char *dst);
+
+  std::vector<PacketIndexEntry> scanPacketIndex(const MainStruct &mainStruct,
+    const std::function<void(char*, int64_t)> &read, const std::function<void(int64_t)> &seek);
+  // returns the size of the packet data
+  uint32_t decompressPacketData(const VideoFramePacket &vfpk, const char *src, char *dst, uint32_t maxUncompressedSize);
+} // namespace LightVideoDecoder
\ No newline at end of file
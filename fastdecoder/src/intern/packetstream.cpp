@@ -0,0 +1,408 @@
+#include "packetstream_p.hpp"
+#include "packet_p.hpp"
+#include "../error.hpp"
+#include "util_p.hpp"
+#include <cstring>
+#include <algorithm>
+
+namespace LightVideoDecoder
+{
+  constexpr static uint32_t lz4WindowSize = 65536;
+  constexpr static uint32_t inputBufferSize = 65536;
+  constexpr static uint32_t minMatchLength = 4;
+
+  PacketStream::PacketStream(ReadFunc readFunc, SeekFunc seekFunc, uint32_t maxRecordSize)
+    : m_read(readFunc), m_seek(seekFunc), m_recordSize(maxRecordSize),
+    m_compressionMethod(NoCompression), m_payloadOffset(0), m_chunkDataOffset(0), m_chunkDataSize(0), m_uncompressedSize(0), m_produced(0),
+    m_chunkIndex(0), m_chunkProduced(0),
+    m_window(nullptr), m_input(nullptr), m_windowSize(lz4WindowSize + maxRecordSize), m_windowEnd(0), m_recordBegin(0),
+    m_reservedSize(0), m_skippedEnd(0),
+    m_inputOffset(0), m_inputLeft(0), m_inputPos(0), m_inputEnd(0), m_inputConsumed(0),
+    m_literalLeft(0), m_matchLeft(0), m_matchOffset(0), m_matchToken(0), m_matchPending(false)
+  {
+    m_window = LVDALLOC(char, m_windowSize);
+    m_input = LVDALLOC(char, inputBufferSize);
+  }
+
+  PacketStream::~PacketStream()
+  {
+    lvdFree(m_input);
+    lvdFree(m_window);
+  }
+
+  void PacketStream::open(const VideoFramePacket &vfpk, int64_t payloadOffset, uint64_t maxUncompressedSize)
+  {
+    m_compressionMethod = vfpk.compressionMethod;
+    m_payloadOffset = payloadOffset;
+    m_chunkTable.clear();
+    m_reservedSize = m_skippedEnd = 0;
+    if(vfpk.compressionMethod == NoCompression)
+    {
+      if(vfpk.size > maxUncompressedSize)
+        throw DataError("Invalid uncompressed data size.");
+      m_uncompressedSize = vfpk.size;
+      m_inputOffset = payloadOffset;
+      m_produced = 0;
+      return;
+    }
+
+    m_chunkDataOffset = payloadOffset;
+    m_chunkDataSize = vfpk.size;
+    if(vfpk.compressionMethod == ChunkedLZ4Compression)
+    {
+      uint32_t nChunk = 0;
+      if(vfpk.size >= sizeof(nChunk))
+      {
+        m_seek(payloadOffset);
+        m_read(reinterpret_cast<char*>(&nChunk), sizeof(nChunk));
+      }
+      if(nChunk == 0 || nChunk > (vfpk.size - sizeof(nChunk)) / sizeof(LZ4ChunkEntry))
+        throw DataError("Invalid chunk table.");
+      m_chunkTable.resize(nChunk);
+      m_read(reinterpret_cast<char*>(m_chunkTable.data()), sizeof(LZ4ChunkEntry) * nChunk);
+      verifyChunkTable(vfpk, m_chunkTable, maxUncompressedSize);
+      m_chunkDataOffset += getChunkTableSize(nChunk);
+      m_chunkDataSize -= getChunkTableSize(nChunk);
+      m_uncompressedSize = m_chunkTable.back().uncompressedEnd;
+    }
+    else
+    {
+      // the size of a plain LZ4 block is only known once it is decoded
+      if(maxUncompressedSize > UINT32_MAX)
+        throw DataError("Invalid compressed data.");
+      m_uncompressedSize = maxUncompressedSize;
+      m_chunkTable.push_back({static_cast<uint32_t>(maxUncompressedSize), vfpk.size});
+    }
+    startChunk(0);
+  }
+
+  void PacketStream::seekRecord(uint64_t offset)
+  {
+    lvdAssert(offset < m_uncompressedSize, "Record is out of the packet.");
+    m_reservedSize = m_skippedEnd = 0;
+    if(m_compressionMethod == NoCompression)
+    {
+      m_inputOffset = m_payloadOffset + offset;
+      m_produced = offset;
+      return;
+    }
+
+    // decode from the start of the chunk holding the record and drop what is in front of it
+    auto it = std::upper_bound(m_chunkTable.begin(), m_chunkTable.end(), offset,
+      [](uint64_t v, const LZ4ChunkEntry &entry) { return v < entry.uncompressedEnd; });
+    startChunk(it - m_chunkTable.begin());
+    while(m_produced < offset)
+    {
+      makeRoom();
+      decompress(static_cast<uint32_t>(std::min<uint64_t>(offset - m_produced, m_recordSize)));
+    }
+  }
+
+  const char *PacketStream::nextRecord(uint32_t size)
+  {
+    // what the previous record didn't fetch is passed over
+    if(m_reservedSize > 0)
+      skip(m_reservedSize);
+    m_skippedEnd = 0;
+    if(m_compressionMethod == NoCompression)
+      m_windowEnd = 0;
+    else
+      makeRoom();
+    m_recordBegin = m_windowEnd;
+    return extendRecord(size);
+  }
+
+  const char *PacketStream::extendRecord(uint32_t size)
+  {
+    lvdAssert(m_reservedSize == 0, "Reserved record data must be fetched first.");
+    lvdAssert(m_windowEnd - m_recordBegin + size <= m_recordSize, "Record is too large.");
+    if(m_produced + size > m_uncompressedSize)
+      throw DataError("Video packet holds fewer frames than it claims.");
+    produce(size);
+    return m_window + m_recordBegin;
+  }
+
+  const char *PacketStream::reserveRecord(uint32_t size)
+  {
+    // a plain LZ4 block has no chunk table to skip by
+    if(m_compressionMethod == LZ4Compression)
+      return extendRecord(size);
+    lvdAssert(m_windowEnd - m_recordBegin + m_reservedSize + size <= m_recordSize, "Record is too large.");
+    if(m_produced + m_reservedSize + size > m_uncompressedSize)
+      throw DataError("Video packet holds fewer frames than it claims.");
+    m_reservedSize += size;
+    return m_window + m_recordBegin;
+  }
+
+  void PacketStream::fetchRecord(uint32_t begin, uint32_t end)
+  {
+    uint32_t valid = m_windowEnd - m_recordBegin;
+    lvdAssert(begin <= end && begin >= m_skippedEnd, "Skipped record data can't be fetched.");
+    if(end <= valid)
+      return;
+    lvdAssert(end - valid <= m_reservedSize, "Record data must be reserved first.");
+    if(begin > valid)
+    {
+      skip(begin - valid);
+      m_skippedEnd = begin;
+      valid = begin;
+    }
+    m_reservedSize -= end - valid;
+    produce(end - valid);
+  }
+
+  void PacketStream::finish()
+  {
+    // reserved data is checked against the chunk table only, skipped chunks are never decoded
+    if(m_compressionMethod == NoCompression || m_reservedSize > 0)
+    {
+      if(m_produced + m_reservedSize != m_uncompressedSize)
+        throw DataError("Video packet size doesn't match its frames.");
+      return;
+    }
+    if(m_chunkIndex + 1 != m_chunkTable.size() || !isChunkInputExhausted() || m_literalLeft > 0 || m_matchLeft > 0 ||
+      (m_compressionMethod == ChunkedLZ4Compression && m_produced != m_uncompressedSize))
+      throw DataError("Video packet size doesn't match its frames.");
+  }
+
+  void PacketStream::startChunk(size_t chunkIndex)
+  {
+    enterChunk(chunkIndex);
+    m_windowEnd = 0;
+  }
+
+  // moves the decoder to the start of a chunk, the window is kept
+  void PacketStream::enterChunk(size_t chunkIndex)
+  {
+    uint32_t compressedBegin = chunkIndex ? m_chunkTable[chunkIndex - 1].compressedEnd : 0;
+    m_chunkIndex = chunkIndex;
+    m_chunkProduced = 0;
+    m_produced = chunkIndex ? m_chunkTable[chunkIndex - 1].uncompressedEnd : 0;
+    m_inputOffset = m_chunkDataOffset + compressedBegin;
+    m_inputLeft = m_chunkDataSize - compressedBegin;
+    m_inputConsumed = compressedBegin;
+    m_inputPos = m_inputEnd = 0;
+    m_literalLeft = m_matchLeft = m_matchOffset = 0;
+    m_matchPending = false;
+  }
+
+  // appends size bytes of the payload to the window
+  void PacketStream::produce(uint32_t size)
+  {
+    if(m_compressionMethod == NoCompression)
+    {
+      m_seek(m_inputOffset);
+      m_read(m_window + m_windowEnd, size);
+      m_inputOffset += size;
+      m_windowEnd += size;
+      m_produced += size;
+    }
+    else
+      decompress(size);
+  }
+
+  /*
+    Passes over size reserved bytes, the window end moves on but the bytes are left undefined.
+    Chunks that lie completely in the skipped part are not decoded, LZ4 matches never reach into a previous chunk.
+  */
+  void PacketStream::skip(uint32_t size)
+  {
+    m_reservedSize -= size;
+    if(m_compressionMethod == NoCompression)
+    {
+      m_inputOffset += size;
+      m_windowEnd += size;
+      m_produced += size;
+      return;
+    }
+
+    uint32_t target = m_windowEnd + size;
+    while(m_windowEnd < target)
+    {
+      // the chunk the decoder is at the start of, a finished chunk is left lazily by decompress()
+      size_t first = m_chunkTable.size();
+      uint64_t chunkEnd = m_chunkTable[m_chunkIndex].uncompressedEnd;
+      if(m_literalLeft == 0 && m_matchLeft == 0)
+      {
+        if(!m_matchPending && m_chunkProduced == 0)
+          first = m_chunkIndex;
+        else if(m_matchPending && m_produced == chunkEnd && isChunkInputExhausted())
+          first = m_chunkIndex + 1;
+      }
+      uint64_t targetProduced = m_produced + (target - m_windowEnd);
+      size_t last = first;
+      while(last < m_chunkTable.size() && m_chunkTable[last].uncompressedEnd <= targetProduced)
+        ++last;
+      if(last > first)
+      {
+        uint64_t produced = m_produced;
+        if(last < m_chunkTable.size())
+          enterChunk(last);
+        else
+        {
+          // the payload end, as decoding the last chunk would leave it
+          enterChunk(last - 1);
+          m_produced = m_chunkTable.back().uncompressedEnd;
+          m_chunkProduced = static_cast<uint32_t>(m_produced - (last > 1 ? m_chunkTable[last - 2].uncompressedEnd : 0));
+          m_inputConsumed = m_chunkTable.back().compressedEnd;
+          m_inputLeft = 0;
+          m_matchPending = true;
+        }
+        m_windowEnd += static_cast<uint32_t>(m_produced - produced);
+      }
+      else if(first == m_chunkTable.size() && m_produced < chunkEnd)
+        decompress(static_cast<uint32_t>(std::min<uint64_t>(target - m_windowEnd, chunkEnd - m_produced)));
+      else
+        decompress(target - m_windowEnd);
+    }
+  }
+
+  // keeps the match window in front of the next record
+  void PacketStream::makeRoom()
+  {
+    if(m_windowEnd + m_recordSize > m_windowSize)
+    {
+      uint32_t keep = std::min(m_windowEnd, lz4WindowSize);
+      memmove(m_window, m_window + m_windowEnd - keep, keep);
+      m_windowEnd = keep;
+    }
+  }
+
+  // reads stop at the end of the current chunk, so chunks that are skipped are never read
+  void PacketStream::fillInput()
+  {
+    uint32_t chunkLeft = static_cast<uint32_t>(m_chunkDataOffset + m_chunkTable[m_chunkIndex].compressedEnd - m_inputOffset);
+    if(m_inputLeft == 0 || chunkLeft == 0)
+      throw DataError("Invalid compressed data.");
+    uint32_t size = std::min({m_inputLeft, chunkLeft, inputBufferSize});
+    m_seek(m_inputOffset);
+    m_read(m_input, size);
+    m_inputOffset += size;
+    m_inputLeft -= size;
+    m_inputPos = 0;
+    m_inputEnd = size;
+  }
+
+  // a block must not read into the next chunk
+  void PacketStream::consumeInput(uint32_t size)
+  {
+    if(size > m_chunkTable[m_chunkIndex].compressedEnd - m_inputConsumed)
+      throw DataError("Invalid compressed data.");
+    m_inputConsumed += size;
+  }
+
+  void PacketStream::readInput(char *dst, uint32_t size)
+  {
+    consumeInput(size);
+    while(size > 0)
+    {
+      if(m_inputPos == m_inputEnd)
+        fillInput();
+      uint32_t n = std::min(size, m_inputEnd - m_inputPos);
+      memcpy(dst, m_input + m_inputPos, n);
+      m_inputPos += n;
+      dst += n;
+      size -= n;
+    }
+  }
+
+  uint8_t PacketStream::readByte()
+  {
+    consumeInput(1);
+    if(m_inputPos == m_inputEnd)
+      fillInput();
+    return static_cast<uint8_t>(m_input[m_inputPos++]);
+  }
+
+  uint32_t PacketStream::readLength()
+  {
+    uint32_t length = 0;
+    uint8_t b;
+    do
+    {
+      b = readByte();
+      length += b;
+      if(length > m_uncompressedSize)
+        throw DataError("Invalid compressed data.");
+    } while(b == 255);
+    return length;
+  }
+
+  bool PacketStream::isChunkInputExhausted() const
+  { return m_inputConsumed == m_chunkTable[m_chunkIndex].compressedEnd; }
+
+  /*
+    Decodes LZ4 sequences until size more bytes are in the window.
+    A record boundary may fall into a literal run or a match, the rest of it is continued by the next call.
+  */
+  void PacketStream::decompress(uint32_t size)
+  {
+    uint32_t target = m_windowEnd + size;
+    while(m_windowEnd < target)
+    {
+      uint32_t chunkLeft = static_cast<uint32_t>(m_chunkTable[m_chunkIndex].uncompressedEnd - m_produced);
+      if(m_literalLeft > 0)
+      {
+        uint32_t n = std::min(m_literalLeft, target - m_windowEnd);
+        readInput(m_window + m_windowEnd, n);
+        m_windowEnd += n;
+        m_literalLeft -= n;
+        m_produced += n;
+        m_chunkProduced += n;
+      }
+      else if(m_matchLeft > 0)
+      {
+        uint32_t n = std::min(m_matchLeft, target - m_windowEnd);
+        char *dst = m_window + m_windowEnd;
+        const char *src = dst - m_matchOffset;
+        if(m_matchOffset >= n)
+          memcpy(dst, src, n);
+        else
+        {
+          for(uint32_t i = 0; i < n; ++i)
+            dst[i] = src[i];
+        }
+        m_windowEnd += n;
+        m_matchLeft -= n;
+        m_produced += n;
+        m_chunkProduced += n;
+      }
+      else if(m_matchPending)
+      {
+        m_matchPending = false;
+        if(isChunkInputExhausted())
+        {
+          // the last sequence of a block has no match, the output goes on in the next chunk
+          if(chunkLeft != 0 || m_chunkIndex + 1 >= m_chunkTable.size())
+            throw DataError("Invalid compressed data.");
+          ++m_chunkIndex;
+          m_chunkProduced = 0;
+          continue;
+        }
+        uint32_t offset = readByte();
+        offset |= static_cast<uint32_t>(readByte()) << 8;
+        uint32_t length = m_matchToken;
+        if(length == 15)
+          length += readLength();
+        length += minMatchLength;
+        if(offset == 0 || offset > m_chunkProduced || offset > m_windowEnd || length > chunkLeft)
+          throw DataError("Invalid compressed data.");
+        m_matchOffset = offset;
+        m_matchLeft = length;
+      }
+      else
+      {
+        if(isChunkInputExhausted())
+          throw DataError("Invalid compressed data.");
+        uint8_t token = readByte();
+        m_literalLeft = token >> 4;
+        if(m_literalLeft == 15)
+          m_literalLeft += readLength();
+        if(m_literalLeft > chunkLeft)
+          throw DataError("Invalid compressed data.");
+        m_matchToken = token & 15;
+        m_matchPending = true;
+      }
+    }
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
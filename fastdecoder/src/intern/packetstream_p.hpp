@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../struct.hpp"
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+namespace LightVideoDecoder
+{
+  /*
+    Unpacks a packet payload one frame record at a time.
+    LZ4 blocks are decoded by a resumable decoder which only keeps the 64KB match window and the current record,
+    and the compressed payload is read from the stream in small pieces, so memory doesn't depend on the packet size.
+    Records vary in size, so a record is read in parts as its header tells how long it is.
+    Chunked payloads let seekRecord() start at the chunk holding the record instead of the packet start.
+    Tiled records reserve their tile data and fetch only the parts they need, whole chunks in between are passed over without decoding.
+  */
+  class PacketStream final
+  {
+  public:
+    typedef std::function<void(char*, int64_t)> ReadFunc;
+    typedef std::function<void(int64_t)> SeekFunc;
+
+    PacketStream(ReadFunc readFunc, SeekFunc seekFunc, uint32_t maxRecordSize);
+    ~PacketStream();
+
+    void open(const VideoFramePacket &vfpk, int64_t payloadOffset, uint64_t maxUncompressedSize);
+    // makes the record at offset in the packet data the next record returned by nextRecord()
+    void seekRecord(uint64_t offset);
+    // offset of the next record in the packet data
+    inline uint64_t position() const
+    { return m_produced + m_reservedSize; }
+    // starts the next record with its first size bytes, the record stays valid until the next nextRecord() or seekRecord()
+    const char *nextRecord(uint32_t size);
+    // appends size bytes to the current record and returns its start
+    const char *extendRecord(uint32_t size);
+    // appends size bytes to the current record like extendRecord() but leaves them to fetchRecord(), plain LZ4 payloads decode them right away
+    const char *reserveRecord(uint32_t size);
+    // makes bytes [begin, end) of the current record valid, reserved bytes in front of begin are skipped and can't be fetched afterwards
+    void fetchRecord(uint32_t begin, uint32_t end);
+    // checks that the payload ends behind the current record
+    void finish();
+
+  private:
+    void startChunk(size_t chunkIndex);
+    void enterChunk(size_t chunkIndex);
+    void produce(uint32_t size);
+    void skip(uint32_t size);
+    void makeRoom();
+    void fillInput();
+    void consumeInput(uint32_t size);
+    void readInput(char *dst, uint32_t size);
+    uint8_t readByte();
+    uint32_t readLength();
+    bool isChunkInputExhausted() const;
+    void decompress(uint32_t size);
+
+    ReadFunc m_read;
+    SeekFunc m_seek;
+    uint32_t m_recordSize; // largest record
+
+    /* packet */
+    CompressionMethod m_compressionMethod;
+    int64_t m_payloadOffset, m_chunkDataOffset;
+    uint32_t m_chunkDataSize;
+    uint64_t m_uncompressedSize, m_produced;
+    std::vector<LZ4ChunkEntry> m_chunkTable; // a single chunk for LZ4Compression
+    size_t m_chunkIndex;
+    uint32_t m_chunkProduced;
+
+    /* buffer */
+    char *m_window, *m_input;
+    uint32_t m_windowSize, m_windowEnd, m_recordBegin;
+    uint32_t m_reservedSize, m_skippedEnd; // reserved bytes behind the window end, end of the last skip in the record
+    int64_t m_inputOffset;
+    uint32_t m_inputLeft, m_inputPos, m_inputEnd, m_inputConsumed;
+
+    /* lz4 sequence */
+    uint32_t m_literalLeft, m_matchLeft, m_matchOffset;
+    uint8_t m_matchToken;
+    bool m_matchPending;
+  };
+} // namespace LightVideoDecoder
\ No newline at end of file
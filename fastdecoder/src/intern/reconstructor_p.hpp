@@ -0,0 +1,179 @@
+#pragma once
+
+#include "../decoder.hpp"
+#include "../colorformat.hpp"
+#include "../imagechannel.hpp"
+#include "../error.hpp"
+#include "defilter_dispatcher_p.hpp"
+#include "tile_p.hpp"
+#include "skipmap_p.hpp"
+#include <vector>
+
+namespace LightVideoDecoder
+{
+  /*
+    Reconstructs frames on the CPU.
+    Three plane sets are rotated so that the previous frame and the previous full frame never have to be copied.
+    Long-term slots are copied when a key frame is stored, they are allocated on first use.
+  */
+  template<typename T>
+  class FrameReconstructor final
+  {
+  public:
+    inline FrameReconstructor(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo)
+      : m_colorFormatInfo(colorFormatInfo), m_tileLayout(getTileLayout(mainStruct, colorFormatInfo)), m_slotBuffer(mainStruct.nLongTermSlot),
+      m_slotMask(0), m_prev(-1), m_prevFull(-1)
+    {
+      for(int i = 0; i < 3; ++i)
+      {
+        for(const Size &s : m_colorFormatInfo.channelList)
+          m_buffer[i].emplace_back(s.width, s.height);
+      }
+      if(m_tileLayout.nTile > 0)
+        m_tileBuffer.resize(static_cast<size_t>(mainStruct.tileWidth) * mainStruct.tileHeight);
+    }
+
+    inline void reset()
+    {
+      m_prev = -1;
+      m_prevFull = -1;
+      m_slotMask = 0;
+    }
+
+    inline bool hasSlot(uint32_t slot) const
+    { return (m_slotMask >> slot) & 1; }
+
+    // decodes the key frame vfrm straight into a slot, the decode chain is left untouched
+    inline void restoreSlot(uint32_t slot, const VideoFrameStruct &vfrm, const char *data, uint32_t channelMask = AllChannel)
+    {
+      lvdAssert(vfrm.referenceType == NoReference, "Only key frames are stored in slots.");
+      std::vector<ImageChannel<T>> &planes = slotBuffer(slot);
+      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+      for(int i = 0; i < nChannel; ++i)
+      {
+        if(channelMask & (1U << i))
+          defilterIntraChannel(vfrm, data, i, planes[i]);
+      }
+      m_slotMask |= 1U << slot;
+    }
+
+    // channels outside channelMask are skipped and keep stale content, skipMap holds the map of vfrm
+    inline void reconstruct(const VideoFrameStruct &vfrm, const char *data, const SkipMap &skipMap, uint32_t channelMask = AllChannel)
+    {
+      if(vfrm.referenceType == RepeatPreviousReference)
+      {
+        if(m_prev < 0)
+          throw DataError("No reference frame available.");
+        return;
+      }
+      int curr = 0;
+      while(curr == m_prev || curr == m_prevFull)
+        ++curr;
+
+      const std::vector<ImageChannel<T>> *ref = nullptr;
+      if(vfrm.referenceType == PreviousFullReference && m_prevFull >= 0)
+        ref = &m_buffer[m_prevFull];
+      else if(vfrm.referenceType == PreviousReference && m_prev >= 0)
+        ref = &m_buffer[m_prev];
+      else if(vfrm.referenceType == LongTermReference && hasSlot(vfrm.referenceSlot))
+        ref = &m_slotBuffer[vfrm.referenceSlot];
+      if(vfrm.referenceType != NoReference && !ref)
+        throw DataError("No reference frame available.");
+
+      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+      for(int i = 0; i < nChannel; ++i)
+      {
+        ImageChannel<T> &img = m_buffer[curr][i];
+        if(channelMask & (1U << i))
+        {
+          Rect full = {0, 0, img.width(), img.height()};
+          if(skipMap.isActive())
+          {
+            m_blockBuffer.resize(static_cast<size_t>(skipMap.layout().tileRect[0][0].width) * skipMap.layout().tileRect[0][0].height);
+            defilterChangedBlocks<T>(data + skipMap.bitmapSize(vfrm), vfrm.intraPredictModeList[i], skipMap, i, full, m_blockBuffer.data(), img);
+          }
+          else
+            defilterIntraChannel(vfrm, data, i, img);
+          if(ref && skipMap.isActive())
+            addDeltaSkipBlocks<T>(img, (*ref)[i], skipMap, i, full);
+          else if(ref)
+            defilterDelta<T>(img, (*ref)[i], getChannelMotionMap(vfrm, m_colorFormatInfo, i));
+        }
+      }
+
+      m_prev = curr;
+      if(vfrm.referenceType == NoReference)
+      {
+        m_prevFull = curr;
+        for(uint32_t slot = 0; slot < m_slotBuffer.size(); ++slot)
+        {
+          if(!((vfrm.storeSlotMask >> slot) & 1))
+            continue;
+          std::vector<ImageChannel<T>> &planes = slotBuffer(slot);
+          for(int i = 0; i < nChannel; ++i)
+          {
+            if(channelMask & (1U << i))
+              std::copy(m_buffer[curr][i].begin(), m_buffer[curr][i].end(), planes[i].begin());
+          }
+          m_slotMask |= 1U << slot;
+        }
+      }
+    }
+
+    inline const ImageChannel<T> &channel(int i) const
+    {
+      lvdAssert(m_prev >= 0, "No frame is reconstructed.");
+      return m_buffer[m_prev][i];
+    }
+
+  private:
+    inline std::vector<ImageChannel<T>> &slotBuffer(uint32_t slot)
+    {
+      std::vector<ImageChannel<T>> &planes = m_slotBuffer[slot];
+      if(planes.empty())
+      {
+        for(const Size &s : m_colorFormatInfo.channelList)
+          planes.emplace_back(s.width, s.height);
+      }
+      return planes;
+    }
+
+    // a channel of a frame without skip map
+    inline void defilterIntraChannel(const VideoFrameStruct &vfrm, const char *data, int channel, ImageChannel<T> &img)
+    {
+      if(m_tileLayout.nTile > 0)
+      {
+        defilterTiles(data, channel, img);
+        return;
+      }
+      const char *begin = data;
+      for(int i = 0; i < channel; ++i)
+        begin += m_colorFormatInfo.channelList[i].width * m_colorFormatInfo.channelList[i].height * sizeof(T);
+      std::copy(begin, begin + img.size() * sizeof(T), reinterpret_cast<char*>(img.begin()));
+      defilterIntra<T>(img, vfrm.intraPredictModeList[channel]);
+    }
+
+    inline void defilterTiles(const char *data, int channel, ImageChannel<T> &img)
+    {
+      int nChannel = static_cast<int>(m_colorFormatInfo.channelList.size());
+      const IntraPredictMode *modeTable = reinterpret_cast<const IntraPredictMode*>(data);
+      const char *tileData = data + m_tileLayout.modeTableSize;
+      Rect full = {0, 0, img.width(), img.height()};
+      for(uint32_t t = 0; t < m_tileLayout.nTile; ++t)
+      {
+        IntraPredictMode mode = modeTable[t * nChannel + channel];
+        if(mode >= _INTRAPREDICTMODE_ENUM_MAX)
+          throw DataError("Tile intra mode is invalid.");
+        defilterTile<T>(reinterpret_cast<const T*>(tileData + m_tileLayout.tileOffset[channel][t]), mode, m_tileLayout.tileRect[channel][t], full, m_tileBuffer.data(), img);
+      }
+    }
+
+    ColorFormatInfo m_colorFormatInfo;
+    TileLayout m_tileLayout;
+    std::vector<T> m_tileBuffer, m_blockBuffer;
+    std::vector<ImageChannel<T>> m_buffer[3];
+    std::vector<std::vector<ImageChannel<T>>> m_slotBuffer;
+    uint32_t m_slotMask;
+    int m_prev, m_prevFull;
+  };
+} // namespace LightVideoDecoder
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "../imagechannel.hpp"
+#include "util_p.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace LightVideoDecoder
+{
+  static inline uint32_t getReducedLength(uint32_t length, int shift)
+  { return std::max(1U, length >> shift); }
+
+  /* generic */
+  // box filter over (1 << shift) x (1 << shift) blocks, blocks crossing the border replicate the last row or column
+  template<typename T>static void reduceBoxRows(const ImageChannel<T> &src, ImageChannel<T> &dst, int shift, uint32_t dstY, uint32_t dstXBegin)
+  {
+    uint32_t factor = 1U << shift;
+    uint32_t srcW = src.width(), srcH = src.height();
+    for(uint32_t x = dstXBegin; x < dst.width(); ++x)
+    {
+      uint32_t sum = 0;
+      for(uint32_t j = 0; j < factor; ++j)
+      {
+        uint32_t sy = std::min(srcH - 1, dstY * factor + j);
+        for(uint32_t i = 0; i < factor; ++i)
+          sum += src(sy, std::min(srcW - 1, x * factor + i));
+      }
+      dst(dstY, x) = static_cast<T>((sum + (factor * factor / 2)) >> (shift * 2));
+    }
+  }
+
+  template<typename T>static inline uint32_t reduceBoxRowsSIMD(const ImageChannel<T> &, ImageChannel<T> &, int, uint32_t)
+  { return 0; }
+
+#if defined(__SSE2__)
+  /* uint8_t simd */
+  // returns the number of output pixels done, 2x2 and 4x4 boxes are summed exactly in 16 bit lanes
+  template<>inline uint32_t reduceBoxRowsSIMD<uint8_t>(const ImageChannel<uint8_t> &src, ImageChannel<uint8_t> &dst, int shift, uint32_t dstY)
+  {
+    uint32_t factor = 1U << shift;
+    if(src.width() < 16 || src.height() < (dstY + 1) * factor)
+      return 0;
+    uint32_t nBlock = (src.width() / 16) * 16 >> shift;
+    nBlock = std::min(nBlock, dst.width()) & ~((16U >> shift) - 1);
+    const __m128i lowMask = _mm_set1_epi16(0x00FF);
+    const __m128i one16 = _mm_set1_epi16(1);
+    for(uint32_t x = 0; x < nBlock; x += 16 >> shift)
+    {
+      // pair sums of 16 source pixels per row, accumulated over the rows of the block
+      __m128i sum = _mm_setzero_si128();
+      for(uint32_t j = 0; j < factor; ++j)
+      {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src(dstY * factor + j, x << shift)));
+        sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_and_si128(p, lowMask), _mm_srli_epi16(p, 8)));
+      }
+      if(shift == 1)
+      {
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&dst(dstY, x)), _mm_packus_epi16(sum, sum));
+      }
+      else
+      {
+        sum = _mm_madd_epi16(sum, one16);
+        sum = _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(8)), 4);
+        sum = _mm_packs_epi32(sum, sum);
+        sum = _mm_packus_epi16(sum, sum);
+        int32_t packed = _mm_cvtsi128_si32(sum);
+        memcpy(&dst(dstY, x), &packed, sizeof(packed));
+      }
+    }
+    return nBlock;
+  }
+#endif
+
+  template<typename T>static void reduceBox(const ImageChannel<T> &src, ImageChannel<T> &dst, int shift)
+  {
+    lvdAssert(dst.width() == getReducedLength(src.width(), shift) && dst.height() == getReducedLength(src.height(), shift), "Bad target shape");
+    for(uint32_t y = 0; y < dst.height(); ++y)
+      reduceBoxRows<T>(src, dst, shift, y, reduceBoxRowsSIMD<T>(src, dst, shift, y));
+  }
+
+  /*
+    img += ref followed by reduceBox, done one block row at a time so the reduction reads the sums from cache.
+    img keeps the full resolution result since later frames refer to it.
+  */
+  template<typename T>static void addDeltaReduceBox(ImageChannel<T> &img, const ImageChannel<T> &ref, ImageChannel<T> &dst, int shift)
+  {
+    lvdAssert(img.width() == ref.width() && img.height() == ref.height(), "Shape dismatch");
+    lvdAssert(dst.width() == getReducedLength(img.width(), shift) && dst.height() == getReducedLength(img.height(), shift), "Bad target shape");
+    uint32_t width = img.width(), height = img.height();
+    uint32_t factor = 1U << shift;
+    for(uint32_t y = 0; y < dst.height(); ++y)
+    {
+      uint32_t rowEnd = y + 1 < dst.height() ? (y + 1) * factor : height;
+      for(uint32_t sy = y * factor; sy < rowEnd; ++sy)
+      {
+        T *p = &img(sy, 0);
+        const T *r = &ref(sy, 0);
+        for(uint32_t x = 0; x < width; ++x)
+          p[x] += r[x];
+      }
+      reduceBoxRows<T>(img, dst, shift, y, reduceBoxRowsSIMD<T>(img, dst, shift, y));
+    }
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
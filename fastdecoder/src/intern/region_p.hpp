@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include "../struct.hpp"
+#include "../colorformat.hpp"
+#include "../imagechannel.hpp"
+#include "defilter_dispatcher_p.hpp"
+
+namespace LightVideoDecoder
+{
+  struct Rect
+  {
+    uint32_t x, y, width, height;
+  };
+
+  static inline bool operator==(const Rect &a, const Rect &b)
+  { return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height; }
+
+  // maps a luma rectangle to a plane of the given size, subsampled planes are rounded outwards
+  static inline Rect mapRegionToChannel(const Rect &rect, uint32_t width, uint32_t height, const Size &channel)
+  {
+    Rect out = rect;
+    if(channel.width != width)
+    {
+      out.x = std::min(channel.width - 1, rect.x / 2);
+      out.width = std::max(1U, std::min(channel.width, (rect.x + rect.width + 1) / 2) - out.x);
+    }
+    if(channel.height != height)
+    {
+      out.y = std::min(channel.height - 1, rect.y / 2);
+      out.height = std::max(1U, std::min(channel.height, (rect.y + rect.height + 1) / 2) - out.y);
+    }
+    return out;
+  }
+
+  /*
+    The part of the filtered plane which rect depends on.
+    SubTop only needs the columns of rect down from row 0, SubLeft only the rows of rect from column 0,
+    SubAvg and SubPaeth need everything up to the bottom right corner of rect.
+  */
+  static inline Rect getIntraDependency(const Rect &rect, IntraPredictMode mode)
+  {
+    switch(mode)
+    {
+    case SubTop:
+      return {rect.x, 0, rect.width, rect.y + rect.height};
+    case SubLeft:
+      return {0, rect.y, rect.x + rect.width, rect.height};
+    case SubAvg:
+    case SubPaeth:
+      return {0, 0, rect.x + rect.width, rect.y + rect.height};
+    default:
+      return rect;
+    }
+  }
+
+  /*
+    Defilters rect of a plane with width srcWidth into out, which must have the size of rect.
+    work must hold the dependency region of rect, it is not touched if the dependency is rect itself.
+  */
+  template<typename T>static void defilterIntraRegion(const T *src, uint32_t srcWidth, IntraPredictMode mode, const Rect &rect, T *work, ImageChannel<T> &out)
+  {
+    lvdAssert(out.width() == rect.width && out.height() == rect.height, "Bad target shape");
+    Rect dep = getIntraDependency(rect, mode);
+    ImageChannel<T> region = dep == rect ? ImageChannel<T>(out.data(), dep.width, dep.height) : ImageChannel<T>(work, dep.width, dep.height);
+    for(uint32_t y = 0; y < dep.height; ++y)
+    {
+      const T *begin = src + (dep.y + y) * srcWidth + dep.x;
+      std::copy(begin, begin + dep.width, &region(y, 0));
+    }
+    defilterIntra<T>(region, mode);
+
+    if(region.data() != out.data())
+    {
+      for(uint32_t y = 0; y < rect.height; ++y)
+      {
+        const T *begin = &region(rect.y - dep.y + y, rect.x - dep.x);
+        std::copy(begin, begin + rect.width, &out(y, 0));
+      }
+    }
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
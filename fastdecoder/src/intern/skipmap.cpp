@@ -0,0 +1,93 @@
+#include "skipmap_p.hpp"
+#include "../error.hpp"
+
+namespace LightVideoDecoder
+{
+  static inline uint32_t getSkipBlockLength(SkipBlockSize size)
+  { return 8U << size; }
+
+  SkipMap::SkipMap(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo)
+    : m_colorFormatInfo(colorFormatInfo), m_width(mainStruct.width), m_height(mainStruct.height), m_layout(nullptr), m_nSkipped(0)
+  {
+    for(TileLayout &layout : m_layoutList)
+      layout.nTile = 0;
+  }
+
+  uint32_t SkipMap::bitmapSize(const VideoFrameStruct &vfrm) const
+  {
+    if(vfrm.skipBlockSize == NoSkipMap)
+      return 0;
+    uint32_t length = getSkipBlockLength(vfrm.skipBlockSize);
+    uint32_t nBlock = ((m_width + length - 1) / length) * ((m_height + length - 1) / length);
+    return (nBlock + 7) / 8;
+  }
+
+  uint32_t SkipMap::load(const VideoFrameStruct &vfrm, const char *bitmap)
+  {
+    // repeated frames carry no data at all
+    if(vfrm.skipBlockSize == NoSkipMap)
+    {
+      m_layout = nullptr;
+      return vfrm.referenceType == RepeatPreviousReference ? 0 : m_colorFormatInfo.dataSize;
+    }
+    TileLayout &layout = m_layoutList[vfrm.skipBlockSize];
+    if(layout.nTile == 0)
+    {
+      uint32_t length = getSkipBlockLength(vfrm.skipBlockSize);
+      layout = getTileLayout(m_colorFormatInfo, m_width, m_height, length, length);
+    }
+    m_layout = &layout;
+
+    const uint8_t *bits = reinterpret_cast<const uint8_t*>(bitmap);
+    m_skipped.resize(layout.nTile);
+    m_blockOffset.resize(layout.nTile);
+    m_nSkipped = 0;
+    uint32_t offset = 0;
+    for(uint32_t b = 0; b < layout.nTile; ++b)
+    {
+      m_skipped[b] = (bits[b / 8] >> (b % 8)) & 1;
+      m_blockOffset[b] = offset;
+      if(m_skipped[b])
+        ++m_nSkipped;
+      else
+        offset += layout.tileEnd[b] - (b ? layout.tileEnd[b - 1] : 0);
+    }
+    if(layout.nTile % 8 && (bits[layout.nTile / 8] >> (layout.nTile % 8)))
+      throw DataError("Invalid skip map.");
+    return offset;
+  }
+
+  std::vector<Rect> SkipMap::getChangedRuns(int channel, const Rect &region) const
+  {
+    const std::vector<Rect> &rectList = m_layout->tileRect[channel];
+    std::vector<Rect> out;
+    for(uint32_t ty = 0; ty < m_layout->nTileY; ++ty)
+    {
+      for(uint32_t tx = 0; tx < m_layout->nTileX;)
+      {
+        uint32_t begin = ty * m_layout->nTileX + tx;
+        if(m_skipped[begin])
+        {
+          ++tx;
+          continue;
+        }
+        while(tx < m_layout->nTileX && !m_skipped[ty * m_layout->nTileX + tx])
+          ++tx;
+        const Rect &first = rectList[begin], &last = rectList[ty * m_layout->nTileX + tx - 1];
+        Rect run = {first.x, first.y, last.x + last.width - first.x, first.height}, part;
+        if(intersectRect(run, region, part))
+          out.push_back({part.x - region.x, part.y - region.y, part.width, part.height});
+      }
+    }
+    return out;
+  }
+
+  uint32_t getMaxSkipMapSize(const MainStruct &mainStruct)
+  {
+    if(isTiled(mainStruct))
+      return 0;
+    uint32_t length = getSkipBlockLength(SkipBlock16);
+    uint32_t nBlock = ((mainStruct.width + length - 1) / length) * ((mainStruct.height + length - 1) / length);
+    return (nBlock + 7) / 8;
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../struct.hpp"
+#include "../colorformat.hpp"
+#include "../imagechannel.hpp"
+#include "defilter_dispatcher_p.hpp"
+#include "tile_p.hpp"
+#include <vector>
+
+namespace LightVideoDecoder
+{
+  /*
+    A delta frame with a skip map is VideoFrameStruct, a bitmap with one bit per block in raster order (lowest bit first, set for unchanged blocks),
+    then the changed blocks in raster order. Blocks are laid out like tiles, each holds its part of every channel filtered on its own
+    with the intra mode of the channel. Unchanged blocks have no data and keep the content of the reference.
+  */
+  class SkipMap final
+  {
+  public:
+    SkipMap(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo);
+
+    // size of the bitmap in front of the block data, 0 for frames without a skip map
+    uint32_t bitmapSize(const VideoFrameStruct &vfrm) const;
+    // returns the size of the block data behind the bitmap, frames without a skip map are loaded as inactive
+    uint32_t load(const VideoFrameStruct &vfrm, const char *bitmap);
+
+    inline bool isActive() const
+    { return m_layout != nullptr; }
+
+    inline const TileLayout &layout() const
+    { return *m_layout; }
+
+    inline bool isSkipped(uint32_t block) const
+    { return m_skipped[block] != 0; }
+
+    // offset of the channel part of a changed block in the block data
+    inline uint32_t partOffset(int channel, uint32_t block) const
+    { return m_blockOffset[block] + m_layout->tileOffset[channel][block] - (block ? m_layout->tileEnd[block - 1] : 0); }
+
+    inline uint32_t skippedCount() const
+    { return m_nSkipped; }
+
+    // changed blocks of a channel inside region merged into runs along block rows, relative to region
+    std::vector<Rect> getChangedRuns(int channel, const Rect &region) const;
+
+  private:
+    ColorFormatInfo m_colorFormatInfo;
+    uint32_t m_width, m_height;
+    TileLayout m_layoutList[_SKIPBLOCKSIZE_ENUM_MAX]; // built on first use
+    const TileLayout *m_layout;
+    std::vector<uint8_t> m_skipped;
+    std::vector<uint32_t> m_blockOffset;
+    uint32_t m_nSkipped;
+  };
+
+  // largest bitmap a frame of the stream may carry
+  uint32_t getMaxSkipMapSize(const MainStruct &mainStruct);
+
+  // defilters the changed blocks of a channel inside region to out, which covers region, work must hold a block
+  template<typename T>static void defilterChangedBlocks(const char *blockData, IntraPredictMode mode, const SkipMap &skipMap, int channel,
+    const Rect &region, T *work, ImageChannel<T> &out)
+  {
+    const TileLayout &layout = skipMap.layout();
+    for(uint32_t b = 0; b < layout.nTile; ++b)
+    {
+      if(!skipMap.isSkipped(b))
+        defilterTile<T>(reinterpret_cast<const T*>(blockData + skipMap.partOffset(channel, b)), mode, layout.tileRect[channel][b], region, work, out);
+    }
+  }
+
+  // img += ref over the changed blocks and img = ref over the unchanged ones, img and ref cover region
+  template<typename T>static void addDeltaSkipBlocks(ImageChannel<T> &img, const ImageChannel<T> &ref, const SkipMap &skipMap, int channel, const Rect &region)
+  {
+    lvdAssert(img.width() == ref.width() && img.height() == ref.height(), "Shape dismatch");
+    const TileLayout &layout = skipMap.layout();
+    Rect part;
+    for(uint32_t b = 0; b < layout.nTile; ++b)
+    {
+      if(!intersectRect(layout.tileRect[channel][b], region, part))
+        continue;
+      bool skipped = skipMap.isSkipped(b);
+      for(uint32_t y = part.y - region.y; y < part.y - region.y + part.height; ++y)
+      {
+        T *p = &img(y, part.x - region.x);
+        const T *r = &ref(y, part.x - region.x);
+        if(skipped)
+          std::copy(r, r + part.width, p);
+        else
+        {
+          for(uint32_t x = 0; x < part.width; ++x)
+            p[x] += r[x];
+        }
+      }
+    }
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
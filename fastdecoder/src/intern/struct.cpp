@@ -1,8 +1,11 @@
 #include "../struct.hpp"
 #include "util_p.hpp"
 #include "../colorformat.hpp"
+#include "tile_p.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 
 namespace LightVideoDecoder
@@ -46,12 +49,26 @@ namespace LightVideoDecoder
       return false;
     }
 
+    if((mainStruct.tileWidth == 0) != (mainStruct.tileHeight == 0) || mainStruct.tileWidth % 2 || mainStruct.tileHeight % 2 ||
+      (mainStruct.tileWidth > 0 && (mainStruct.tileWidth < 16 || mainStruct.tileHeight < 16)))
+    {
+      critical("Invalid tile size.");
+      return false;
+    }
+
+    if(mainStruct.nLongTermSlot > maxLongTermSlot)
+    {
+      critical("Too many long-term slots.");
+      return false;
+    }
+
     return true;
   }
 
   bool verifyVFPK(const MainStruct &mainStruct, const VideoFramePacket &vfpk)
   {
-    if(strncmp(vfpk.vfpk, "VFPK", 4) || vfpk.nFrame == 0 || vfpk.nFrame > mainStruct.maxPacketSize || vfpk.nFullFrame > vfpk.nFrame || vfpk.compressionMethod >= _COMPRESSION_ENUM_MAX)
+    if(strncmp(vfpk.vfpk, "VFPK", 4) || vfpk.nFrame == 0 || vfpk.nFrame > mainStruct.maxPacketSize || vfpk.nFullFrame > vfpk.nFrame || vfpk.compressionMethod >= _COMPRESSION_ENUM_MAX ||
+      (vfpk.storeSlotMask >> mainStruct.nLongTermSlot))
     {
       critical("Video frame packet header is broken.");
       return false;
@@ -66,6 +83,31 @@ namespace LightVideoDecoder
       critical("Video frame struct is broken.");
       return false;
     }
+    // unchanged blocks are taken from the reference, tiled streams restrict decoding by tiles instead
+    if(vfrm.skipBlockSize >= _SKIPBLOCKSIZE_ENUM_MAX ||
+      (vfrm.skipBlockSize != NoSkipMap && (vfrm.referenceType == NoReference || vfrm.referenceType == RepeatPreviousReference || isTiled(mainStruct))))
+    {
+      critical("Invalid skip map.");
+      return false;
+    }
+    // the reference is warped as a whole, neither skipped blocks nor tiles could be taken from it in place,
+    // bounding it to a move of a frame and a scale of twice the size keeps the mapping in 32 bit on the GPU
+    int shortSide = static_cast<int>(std::min(mainStruct.width, mainStruct.height));
+    if((vfrm.scale != 0 || vfrm.moveX != 0 || vfrm.moveY != 0) &&
+      (vfrm.referenceType == NoReference || vfrm.referenceType == RepeatPreviousReference || vfrm.skipBlockSize != NoSkipMap || isTiled(mainStruct) ||
+      vfrm.scale <= -shortSide || vfrm.scale > shortSide ||
+      std::abs(vfrm.moveX) > static_cast<int>(mainStruct.width) || std::abs(vfrm.moveY) > static_cast<int>(mainStruct.height)))
+    {
+      critical("Invalid global motion.");
+      return false;
+    }
+    // only key frames are stored, so a slot is restored by decoding a single frame
+    if((vfrm.referenceType == LongTermReference ? vfrm.referenceSlot >= mainStruct.nLongTermSlot : vfrm.referenceSlot != 0) ||
+      (vfrm.storeSlotMask >> mainStruct.nLongTermSlot) || (vfrm.storeSlotMask && vfrm.referenceType != NoReference))
+    {
+      critical("Invalid long-term slot.");
+      return false;
+    }
     auto colorFormatInfo = getColorFormatInfo(mainStruct.colorFormat, mainStruct.width, mainStruct.height);
     int channelCount = static_cast<int>(colorFormatInfo.channelList.size());
     for(int i = 0; i < channelCount; ++i)
@@ -0,0 +1,109 @@
+#include "threadpool_p.hpp"
+#include <algorithm>
+
+namespace LightVideoDecoder
+{
+  ThreadPool::ThreadPool(uint32_t threadCount)
+    : m_func(nullptr), m_count(0), m_next(0), m_running(0), m_generation(0), m_quit(false)
+  {
+    if(threadCount == 0)
+      threadCount = std::max(1U, std::thread::hardware_concurrency()) - 1;
+    for(uint32_t i = 0; i < threadCount; ++i)
+      m_threadList.emplace_back(&ThreadPool::work, this, i + 1);
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::unique_lock<std::mutex> locker(m_lock);
+      m_quit = true;
+    }
+    m_jobReady.notify_all();
+    for(std::thread &t : m_threadList)
+      t.join();
+  }
+
+  uint32_t ThreadPool::slotCount() const
+  { return static_cast<uint32_t>(m_threadList.size()) + 1; }
+
+  void ThreadPool::parallelFor(uint32_t n, const LoopFunc &func)
+  {
+    if(n == 0)
+      return;
+    if(n == 1 || m_threadList.empty())
+    {
+      for(uint32_t i = 0; i < n; ++i)
+        func(i, 0);
+      return;
+    }
+
+    {
+      std::unique_lock<std::mutex> locker(m_lock);
+      m_func = &func;
+      m_count = n;
+      m_next = 0;
+      m_running = 1;
+      m_error = nullptr;
+      ++m_generation;
+    }
+    m_jobReady.notify_all();
+    runLoop(0);
+
+    std::exception_ptr error;
+    {
+      std::unique_lock<std::mutex> locker(m_lock);
+      m_jobDone.wait(locker, [this]() { return m_running == 0; });
+      m_func = nullptr;
+      error = m_error;
+    }
+    if(error)
+      std::rethrow_exception(error);
+  }
+
+  void ThreadPool::work(uint32_t slot)
+  {
+    uint64_t generation = 0;
+    for(;;)
+    {
+      {
+        std::unique_lock<std::mutex> locker(m_lock);
+        m_jobReady.wait(locker, [&]() { return m_quit || (m_generation != generation && m_func); });
+        if(m_quit)
+          return;
+        generation = m_generation;
+        ++m_running;
+      }
+      runLoop(slot);
+    }
+  }
+
+  // takes indices until the loop is exhausted, after an error the remaining indices are dropped
+  void ThreadPool::runLoop(uint32_t slot)
+  {
+    for(;;)
+    {
+      uint32_t index;
+      {
+        std::unique_lock<std::mutex> locker(m_lock);
+        if(m_next >= m_count)
+        {
+          if(--m_running == 0)
+            m_jobDone.notify_all();
+          return;
+        }
+        index = m_next++;
+      }
+      try
+      {
+        (*m_func)(index, slot);
+      }
+      catch(...)
+      {
+        std::unique_lock<std::mutex> locker(m_lock);
+        if(!m_error)
+          m_error = std::current_exception();
+        m_next = m_count;
+      }
+    }
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <vector>
+#include <cstdint>
+
+namespace LightVideoDecoder
+{
+  /*
+    Fixed set of workers for data parallel loops.
+    The calling thread works on the loop too, so slotCount() is the number of threads plus one.
+  */
+  class ThreadPool final
+  {
+  public:
+    typedef std::function<void(uint32_t index, uint32_t slot)> LoopFunc;
+
+    // threadCount 0 uses one thread less than the hardware concurrency
+    ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    // runs func for every index in [0, n) and returns when all are done, the first exception is rethrown
+    void parallelFor(uint32_t n, const LoopFunc &func);
+    uint32_t slotCount() const;
+
+  private:
+    void work(uint32_t slot);
+    void runLoop(uint32_t slot);
+
+    std::vector<std::thread> m_threadList;
+    std::mutex m_lock;
+    std::condition_variable m_jobReady, m_jobDone;
+
+    /* job */
+    const LoopFunc *m_func;
+    uint32_t m_count, m_next, m_running;
+    uint64_t m_generation;
+    std::exception_ptr m_error;
+    bool m_quit;
+  };
+} // namespace LightVideoDecoder
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "tile_p.hpp"
+
+namespace LightVideoDecoder
+{
+  uint32_t getTileCount(const MainStruct &mainStruct)
+  {
+    if(!isTiled(mainStruct))
+      return 0;
+    return ((mainStruct.width + mainStruct.tileWidth - 1) / mainStruct.tileWidth) * ((mainStruct.height + mainStruct.tileHeight - 1) / mainStruct.tileHeight);
+  }
+
+  // luma range [begin, end) of a tile mapped onto a channel axis
+  static void mapTileRange(uint32_t begin, uint32_t end, uint32_t length, uint32_t channelLength, uint32_t &outBegin, uint32_t &outEnd)
+  {
+    if(channelLength == length)
+    {
+      outBegin = begin;
+      outEnd = end;
+    }
+    else
+    {
+      outBegin = std::min(channelLength, begin / 2);
+      outEnd = end == length ? channelLength : std::min(channelLength, end / 2);
+    }
+  }
+
+  TileLayout getTileLayout(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo)
+  {
+    if(!isTiled(mainStruct))
+    {
+      TileLayout out;
+      out.nTileX = out.nTileY = out.nTile = 0;
+      out.modeTableSize = 0;
+      return out;
+    }
+    TileLayout out = getTileLayout(colorFormatInfo, mainStruct.width, mainStruct.height, mainStruct.tileWidth, mainStruct.tileHeight);
+    out.modeTableSize = out.nTile * static_cast<uint32_t>(colorFormatInfo.channelList.size());
+    return out;
+  }
+
+  TileLayout getTileLayout(const ColorFormatInfo &colorFormatInfo, uint32_t width, uint32_t height, uint32_t tileWidth, uint32_t tileHeight)
+  {
+    TileLayout out;
+    int nChannel = static_cast<int>(colorFormatInfo.channelList.size());
+    out.nTileX = (width + tileWidth - 1) / tileWidth;
+    out.nTileY = (height + tileHeight - 1) / tileHeight;
+    out.nTile = out.nTileX * out.nTileY;
+    out.modeTableSize = 0;
+    out.tileRect.resize(nChannel);
+    out.tileOffset.resize(nChannel);
+
+    uint32_t offset = 0;
+    for(uint32_t ty = 0; ty < out.nTileY; ++ty)
+    {
+      for(uint32_t tx = 0; tx < out.nTileX; ++tx)
+      {
+        uint32_t x0 = tx * tileWidth, x1 = std::min(width, x0 + tileWidth);
+        uint32_t y0 = ty * tileHeight, y1 = std::min(height, y0 + tileHeight);
+        for(int i = 0; i < nChannel; ++i)
+        {
+          const Size &s = colorFormatInfo.channelList[i];
+          uint32_t cx0, cx1, cy0, cy1;
+          mapTileRange(x0, x1, width, s.width, cx0, cx1);
+          mapTileRange(y0, y1, height, s.height, cy0, cy1);
+          out.tileRect[i].push_back({cx0, cy0, cx1 - cx0, cy1 - cy0});
+          out.tileOffset[i].push_back(offset);
+          offset += (cx1 - cx0) * (cy1 - cy0) * colorFormatInfo.typeSize;
+        }
+        out.tileEnd.push_back(offset);
+      }
+    }
+    return out;
+  }
+
+  std::vector<uint32_t> getTilesInRect(const TileLayout &layout, int channel, const Rect &rect)
+  {
+    std::vector<uint32_t> out;
+    Rect part;
+    for(uint32_t i = 0; i < layout.nTile; ++i)
+    {
+      if(intersectRect(layout.tileRect[channel][i], rect, part))
+        out.push_back(i);
+    }
+    return out;
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
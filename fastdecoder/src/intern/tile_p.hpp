@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../struct.hpp"
+#include "../colorformat.hpp"
+#include "../imagechannel.hpp"
+#include "region_p.hpp"
+#include <vector>
+
+namespace LightVideoDecoder
+{
+  /*
+    A tiled frame record is VideoFrameStruct, one IntraPredictMode per tile and channel (tile major), then the tiles in raster order.
+    A tile holds its part of every channel, each filtered on its own, so tiles can be defiltered independently.
+    Subsampled channels use half the tile size, tiles in the last row or column are clipped and may be empty in a subsampled channel.
+  */
+  struct TileLayout
+  {
+    uint32_t nTileX, nTileY, nTile;
+    uint32_t modeTableSize;
+    std::vector<std::vector<Rect>> tileRect; // channel -> tile, in channel coordinates
+    std::vector<std::vector<uint32_t>> tileOffset; // channel -> tile, offset of the channel part in the tile data
+    std::vector<uint32_t> tileEnd; // end of each tile in the tile data
+  };
+
+  static inline bool isTiled(const MainStruct &mainStruct)
+  { return mainStruct.tileWidth > 0 && mainStruct.tileHeight > 0; }
+
+  uint32_t getTileCount(const MainStruct &mainStruct);
+  // nTile is 0 for untiled streams
+  TileLayout getTileLayout(const MainStruct &mainStruct, const ColorFormatInfo &colorFormatInfo);
+  // any grid of tileWidth x tileHeight luma samples laid out like tiles, without a mode table
+  TileLayout getTileLayout(const ColorFormatInfo &colorFormatInfo, uint32_t width, uint32_t height, uint32_t tileWidth, uint32_t tileHeight);
+  // tiles of a channel that intersect rect, given in channel coordinates
+  std::vector<uint32_t> getTilesInRect(const TileLayout &layout, int channel, const Rect &rect);
+
+  static inline bool intersectRect(const Rect &a, const Rect &b, Rect &out)
+  {
+    uint32_t x0 = std::max(a.x, b.x), y0 = std::max(a.y, b.y);
+    uint32_t x1 = std::min(a.x + a.width, b.x + b.width), y1 = std::min(a.y + a.height, b.y + b.height);
+    if(x0 >= x1 || y0 >= y1)
+      return false;
+    out = {x0, y0, x1 - x0, y1 - y0};
+    return true;
+  }
+
+  /*
+    Defilters one tile of a channel and writes its part inside region to out, which covers region.
+    work must hold the tile.
+  */
+  template<typename T>static void defilterTile(const T *src, IntraPredictMode mode, const Rect &tile, const Rect &region, T *work, ImageChannel<T> &out)
+  {
+    Rect part;
+    if(!intersectRect(tile, region, part))
+      return;
+    ImageChannel<T> img(work, tile.width, tile.height);
+    std::copy(src, src + tile.width * tile.height, work);
+    defilterIntra<T>(img, mode);
+    for(uint32_t y = 0; y < part.height; ++y)
+    {
+      const T *begin = &img(part.y - tile.y + y, part.x - tile.x);
+      std::copy(begin, begin + part.width, &out(part.y - region.y + y, part.x - region.x));
+    }
+  }
+} // namespace LightVideoDecoder
\ No newline at end of file
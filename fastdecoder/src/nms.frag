@@ -3,11 +3,15 @@ noperspective in vec3 vertPos;
 noperspective in vec2 texCoord;
 
 uniform sampler2D curr, ref;
+// global motion of the reference, see MotionMap, unsigned keeps the products of a bounded motion in range
+uniform ivec2 size, scaledSize, halfDiff, move;
 layout (location = 0) out vec4 color;
 
 void main()
 {
-  vec4 uc = texture(curr, texCoord) * 255.0f;
-  vec4 rc = texture(ref, texCoord) * 255.0f;
+  ivec2 p = ivec2(gl_FragCoord.xy);
+  uvec2 m = min(uvec2(max(p + halfDiff - move, ivec2(0))) * uvec2(size) / uvec2(scaledSize), uvec2(size - 1));
+  vec4 uc = texelFetch(curr, p, 0) * 255.0f;
+  vec4 rc = texelFetch(ref, ivec2(m), 0) * 255.0f;
   color = mod(uc + rc, 256.0f) / 255.0f;
 }
\ No newline at end of file
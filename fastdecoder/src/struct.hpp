@@ -8,6 +8,7 @@ namespace LightVideoDecoder
   {
     NoCompression = 0x0,
     LZ4Compression,
+    ChunkedLZ4Compression,
     _COMPRESSION_ENUM_MAX,
   };
 
@@ -26,9 +27,19 @@ namespace LightVideoDecoder
     NoReference = 0x0,
     PreviousFullReference,
     PreviousReference,
+    RepeatPreviousReference, // identical to the previous frame, the record has no data
+    LongTermReference, // delta against the long-term slot VideoFrameStruct::referenceSlot
     _REFERENCETYPE_ENUM_MAX
   };
 
+  enum SkipBlockSize : uint8_t
+  {
+    NoSkipMap = 0x0,
+    SkipBlock16,
+    SkipBlock32,
+    _SKIPBLOCKSIZE_ENUM_MAX
+  };
+
   enum ColorFormat : uint8_t
   {
     YUV420P = 0x0,
@@ -43,7 +54,9 @@ namespace LightVideoDecoder
     ColorFormat colorFormat;
     uint8_t framerate;
     uint8_t maxPacketSize;
-    char _reserved_1[8];
+    uint8_t nLongTermSlot; // at most maxLongTermSlot
+    char _reserved_1[3];
+    uint16_t tileWidth, tileHeight; // 0 for whole planes, see TileLayout
     uint32_t width, height;
     uint32_t nFrame;
     char _reserved_2[4];
@@ -54,20 +67,44 @@ namespace LightVideoDecoder
     char vfpk[4];
     uint8_t nFrame, nFullFrame;
     CompressionMethod compressionMethod;
-    char _reserved_0;
+    uint8_t storeSlotMask; // long-term slots stored by the frames of the packet
     uint32_t size;
     uint32_t checksum;
   };
 
+  /*
+    Delta frames may carry a skip map and then only store the changed blocks, see SkipMap.
+    Key frames may be stored in long-term slots by storeSlotMask and stay there until another key frame replaces them,
+    so LongTermReference frames can reach back past any number of key frames.
+    Delta frames of untiled streams without skip map may warp their reference by a global motion before the residual is added, see MotionMap.
+    The motion samples outside of a region, so such frames are only decoded with the full frame as region.
+  */
   struct VideoFrameStruct
   {
     char vfrm[4];
     ReferenceType referenceType;
-    char _reserved_0[9];
+    SkipBlockSize skipBlockSize;
+    uint8_t referenceSlot, storeSlotMask;
+    int16_t scale, moveX, moveY; // global motion in samples of the full size channels, 0 for none
     IntraPredictMode intraPredictModeList[8];
     char _reserved_1[10];
   };
 
+  /*
+    A ChunkedLZ4Compression payload starts with uint32_t nChunk and nChunk entries, followed by the chunks as independent LZ4 blocks.
+    End offsets are exclusive, uncompressedEnd counts in the packet data and compressedEnd from the end of the table.
+    Every chunk but the last one holds at least minChunkSize bytes.
+  */
+  struct LZ4ChunkEntry
+  {
+    uint32_t uncompressedEnd, compressedEnd;
+  };
+
+  constexpr uint32_t minChunkSize = 4096;
+
+  // a slot costs one frame of reference memory at region size
+  constexpr uint32_t maxLongTermSlot = 4;
+
   bool verifyMainStruct(const MainStruct &mainStruct);
   bool verifyVFPK(const MainStruct &mainStruct, const VideoFramePacket &vfpk);
   bool verifyVFRM(const MainStruct &mainStruct, const VideoFrameStruct &vfrm);
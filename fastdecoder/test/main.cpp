@@ -1,7 +1,10 @@
 #include "../../fastdecoder/src/decoder.hpp"
+#include "../../fastdecoder/src/batchdecoder.hpp"
 #include "../../fastdecoder/src/error.hpp"
 #include <chrono>
 #include <cmath>
+#include <algorithm>
+#include <thread>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
@@ -31,6 +34,27 @@ static void speedtest(Decoder &dec)
   printf("%lfs for %lfs, ratio %lfx\n", duration, dec.duration(), dec.duration() / duration);
 }
 
+// decodes the whole video with 1, 2, 4, ... threads up to the hardware concurrency, the ratio should grow with the thread count
+static void batchspeedtest(Decoder::ReadFunc read, Decoder::SeekFunc seek, Decoder::PosFunc pos)
+{
+  uint32_t maxThread = std::max(1U, std::thread::hardware_concurrency());
+  double baseDuration = 0.0;
+  for(uint32_t nThread = 1; ; nThread = std::min(nThread * 2, maxThread))
+  {
+    auto start = std::chrono::steady_clock::now();
+    BatchDecoder dec(read, seek, pos, nThread);
+    uint32_t nFrame = 0;
+    dec.decode([&](const DecodedFrame &) { ++nFrame; });
+    double duration = static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()) / 1e3;
+    if(nThread == 1)
+      baseDuration = duration;
+    printf("%u threads, %u segments, %u frames, %lfs for %lfs, ratio %lfx, speedup %lfx\n",
+      dec.threadCount(), dec.segmentCount(), nFrame, duration, dec.duration(), dec.duration() / duration, baseDuration / duration);
+    if(nThread == maxThread)
+      break;
+  }
+}
+
 static GLfloat vertices[] = {
   -1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
   -1.0f, -1.0f, 0.0f, 0.0f, 1.0f,
@@ -263,7 +287,9 @@ int main()
   };
 
   Decoder *dec = new Decoder(read, seek, pos);
+  //dec->setFrameCacheBudget(512ULL << 20);
   //speedtest(*dec);
+  //batchspeedtest(read, seek, pos);
   play(window, *dec);
   delete dec;
   system("pause");
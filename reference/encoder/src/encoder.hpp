@@ -0,0 +1,141 @@
+#pragma once
+
+#include <functional>
+#include <cstdint>
+#include "struct.hpp"
+
+namespace LightVideoEncoder
+{
+  class EncoderPrivate;
+
+  /*
+    Nanoseconds the CPU stages of decoding a frame take on the player to target, per sample, byte or block.
+    Same fields as LightVideoDecoder::DecodeCostModel, which measureDecodeCost() of fastdecoder reports.
+  */
+  struct DecodeCostModel
+  {
+    float intraCost[_INTRAPREDICTMODE_ENUM_MAX]; // indexed by IntraPredictMode
+    float deltaCost; // adding the reference per sample
+    float motionCost; // adding the reference through a global motion per sample
+    float decompressCost; // LZ4 decompression per uncompressed byte
+    float blockCost; // defiltering a 16 x 16 block of a skip map frame on its own, on top of its samples
+  };
+
+  // measured with AVX2 on a desktop x64 CPU
+  DecodeCostModel defaultDecodeCostModel();
+
+  // copies a model with the fields of DecodeCostModel, such as the one measured by fastdecoder, without depending on its headers
+  template<typename Model>inline DecodeCostModel toDecodeCostModel(const Model &model)
+  {
+    DecodeCostModel out;
+    static_assert(sizeof(model.intraCost) == sizeof(out.intraCost), "intraCost differs in size.");
+    for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+      out.intraCost[mode] = model.intraCost[mode];
+    out.deltaCost = model.deltaCost;
+    out.motionCost = model.motionCost;
+    out.decompressCost = model.decompressCost;
+    out.blockCost = model.blockCost;
+    return out;
+  }
+
+  struct EncoderConfig
+  {
+    uint32_t width, height;
+    uint8_t framerate;
+    ColorFormat colorFormat;
+    uint8_t maxPacketSize; // frames per packet
+    CompressionMethod compressionMethod; // LZ4Compression or ChunkedLZ4Compression
+    uint32_t chunkSize; // bytes per chunk of ChunkedLZ4Compression
+    int compressionLevel; // LZ4 HC level of the packets
+    int searchLevel; // LZ4 HC level the filter and reference candidates are ranked with
+    // intra modes per channel and references that are compressed after ranking by estimated size, 0 compresses every candidate
+    uint32_t searchCandidateCount;
+    // references whose residual statistics cost more than the best one by this fraction are not searched, below 0 disables pruning
+    float referencePruneMargin;
+    // residuals up to this magnitude are dropped, 0 is lossless
+    uint8_t dropThreshold;
+    // blocks of delta frames whose residual is all zero are left out when the frame gets no larger, NoSkipMap disables it
+    SkipBlockSize skipBlockSize;
+    // luma samples per tile, even and at least 16, 0 stores whole planes
+    // tiled streams have no skip maps and no motion, and ChunkedLZ4Compression ends its chunks at tile boundaries instead of every chunkSize bytes
+    uint16_t tileWidth, tileHeight;
+    // frames after a key frame before the next one is forced, 0 means unbounded
+    uint32_t maxChainLength;
+    // histogram distance in [0, 1] above which a frame starts a new scene, 0 disables detection
+    float sceneCutThreshold;
+    // key frames kept for later LongTermReference frames, at most maxLongTermSlot, a key frame replaces the least recently used slot
+    uint8_t nLongTermSlot;
+    // bounds of the global motion searched per reference, the scale in samples along the shorter side and the move in samples, 0 disables both
+    // frames with motion can only be decoded with the full frame as region
+    uint32_t maxMotionScale, maxMotionMove;
+    // share of the frame interval at decodeFramerate the player may spend decoding, the smallest candidate within it is chosen, 0 disables the budget
+    // costs are per sample, so the same share holds any resolution, a frame whose cheapest candidate is over it gets the cheapest one
+    float decodeShare;
+    // frames per second the player has to decode, 0 takes framerate, more leaves room for fast playback
+    float decodeFramerate;
+    DecodeCostModel decodeCostModel;
+    // frames queued for the encoder thread and packets compressing in the background, 0 encodes and writes every frame on the caller thread
+    uint32_t pipelineDepth;
+  };
+
+  EncoderConfig defaultEncoderConfig(uint32_t width, uint32_t height, uint8_t framerate, ColorFormat colorFormat);
+
+  struct EncoderStats
+  {
+    uint32_t frameCount, keyFrameCount, repeatFrameCount, packetCount;
+    uint64_t rawBytes, writtenBytes;
+  };
+
+  /*
+    Encodes planar frames into a stream fastdecoder plays.
+    Every frame is tried as a key frame and as a delta against the previous full and the previous frame,
+    each channel with every intra mode, and the smallest candidate is kept.
+    With long-term slots, the slot closest to the frame is tried as a reference as well.
+    With a motion bound, every reference is first warped by the global scale and move that best match the first channel.
+    References that clearly lose on residual statistics are pruned before any filtering.
+    Candidates are ranked by a size estimate first, only the best searchCandidateCount of them are compressed.
+    The chosen delta then leaves out its unchanged blocks with a skip map, unless its reference moved.
+    With tiles, the chosen candidate is filtered tile by tile instead, so a decoder can decompress and defilter just the tiles it needs.
+    With a decode budget, candidates whose modeled decode time exceeds it are left out of the search,
+    counting the restore of a long-term slot after a seek and the blocks of a skip map.
+    Frames are collected into packets of maxPacketSize frames, which are compressed as a whole.
+    With a pipeline depth, frames are searched in feeding order on an encoder thread while the caller prepares the next ones
+    and earlier packets compress on the task pool. writeFunc is then called from the encoder thread, never concurrently.
+  */
+  class Encoder final
+  {
+  public:
+    typedef std::function<void(const char*, int64_t)> WriteFunc;
+    typedef std::function<void(int64_t)> SeekFunc;
+
+    Encoder(WriteFunc writeFunc, SeekFunc seekFunc, const EncoderConfig &config);
+    ~Encoder();
+
+    /* property getter */
+    uint32_t width() const;
+    uint32_t height() const;
+    uint32_t framerate() const;
+    ColorFormat colorFormat() const;
+    uint32_t channelCount() const;
+    uint32_t channelWidth(uint32_t channel) const;
+    uint32_t channelHeight(uint32_t channel) const;
+
+    /* method */
+    // one plane per channel, rows of a plane are strideList[i] bytes apart or packed if strideList is null
+    void feedFrame(const uint8_t *const *planeList, const uint32_t *strideList = nullptr);
+    // interleaved RGB or RGBA of nChannel bytes per pixel, converted and downsampled in one pass, YUVA420P takes alpha from RGBA
+    void feedFrameRGB(const uint8_t *pixels, uint32_t nChannel, uint32_t stride = 0);
+    // writes the pending packet and the final main structure, no frame may be fed afterwards
+    void finish();
+
+    /* status getter */
+    // frames fed so far
+    uint32_t frameCount() const;
+    bool isFinished() const;
+    // waits until the frames fed so far are encoded
+    EncoderStats stats() const;
+
+  private:
+    EncoderPrivate *m_dptr;
+  };
+} // namespace LightVideoEncoder
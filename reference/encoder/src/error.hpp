@@ -0,0 +1,19 @@
+#pragma once
+#include <stdexcept>
+
+#define _LV_DEF_ERROR(name, base) \
+  class name : public base \
+  { \
+  public: \
+    name (const char *what_arg); \
+    virtual ~ name (); \
+  }
+
+namespace LightVideoEncoder
+{
+  _LV_DEF_ERROR(RuntimeError, std::runtime_error);
+  _LV_DEF_ERROR(IOError, RuntimeError);
+  _LV_DEF_ERROR(ConfigError, RuntimeError);
+  _LV_DEF_ERROR(CompressionError, RuntimeError);
+} // namespace LightVideoEncoder
+#undef _LV_DEF_ERROR
@@ -0,0 +1,526 @@
+#include "../encoder.hpp"
+#include "../error.hpp"
+#include "encoder_p.hpp"
+#include "util_p.hpp"
+#include "../../../helper/src/scenecut.h"
+#include "../../../helper/src/motion.h"
+#include "../../../helper/src/resampler.hpp"
+#include "../../../helper/src/yuv.h"
+#include <algorithm>
+#include <cstring>
+#include <cfloat>
+
+namespace LightVideoEncoder
+{
+  // a cut also has to move this fraction of the threshold in mean absolute difference, same as lvenc
+  constexpr float sceneCutSADRatio = 0.25f;
+  // every queued frame holds a full input plane set
+  constexpr uint32_t maxPipelineDepth = 16;
+
+  DecodeCostModel defaultDecodeCostModel()
+  {
+    DecodeCostModel model = {{0.0f, 0.05f, 0.2f, 3.0f, 9.0f}, 1.5f, 1.4f, 0.25f, 40.0f};
+    return model;
+  }
+
+  EncoderConfig defaultEncoderConfig(uint32_t width, uint32_t height, uint8_t framerate, ColorFormat colorFormat)
+  {
+    EncoderConfig config;
+    config.width = width;
+    config.height = height;
+    config.framerate = framerate;
+    config.colorFormat = colorFormat;
+    config.maxPacketSize = 8;
+    config.compressionMethod = LZ4Compression;
+    config.chunkSize = 65536;
+    config.compressionLevel = 11;
+    config.searchLevel = 9;
+    config.searchCandidateCount = 2;
+    config.referencePruneMargin = 1.0f;
+    config.dropThreshold = 0;
+    config.skipBlockSize = SkipBlock16;
+    config.tileWidth = 0;
+    config.tileHeight = 0;
+    config.maxChainLength = 0;
+    config.sceneCutThreshold = 0.0f;
+    config.nLongTermSlot = 0;
+    config.maxMotionScale = 0;
+    config.maxMotionMove = 0;
+    config.decodeShare = 0.0f;
+    config.decodeFramerate = 0.0f;
+    config.decodeCostModel = defaultDecodeCostModel();
+    config.pipelineDepth = 2;
+    return config;
+  }
+
+  static void verifyConfig(const EncoderConfig &config)
+  {
+    if(config.width == 0 || config.height == 0 || config.width > 32767 || config.height > 32767)
+      throw ConfigError("width and height must be in range [1, 32767].");
+    if(config.framerate == 0)
+      throw ConfigError("framerate must be greater than 0.");
+    if(config.colorFormat >= _COLORFORMAT_ENUM_MAX)
+      throw ConfigError("Invalid color format.");
+    if(config.maxPacketSize == 0)
+      throw ConfigError("maxPacketSize must be greater than 0.");
+    if(config.compressionMethod != LZ4Compression && config.compressionMethod != ChunkedLZ4Compression)
+      throw ConfigError("Only LZ4Compression and ChunkedLZ4Compression are supported.");
+    if(config.compressionMethod == ChunkedLZ4Compression && (config.chunkSize < minChunkSize || config.chunkSize > 0x7E000000))
+      throw ConfigError("Invalid chunk size.");
+    if(config.compressionLevel < 0 || config.searchLevel < 0)
+      throw ConfigError("Invalid compression level.");
+    if(config.skipBlockSize >= _SKIPBLOCKSIZE_ENUM_MAX)
+      throw ConfigError("Invalid skip block size.");
+    // same rule as the decoder
+    if((config.tileWidth == 0) != (config.tileHeight == 0) || config.tileWidth % 2 || config.tileHeight % 2 ||
+      (config.tileWidth > 0 && (config.tileWidth < 16 || config.tileHeight < 16)))
+      throw ConfigError("Tile sizes must both be 0 or even and at least 16.");
+    if(config.referencePruneMargin != config.referencePruneMargin)
+      throw ConfigError("referencePruneMargin must be a number.");
+    if(!(config.sceneCutThreshold >= 0.0f && config.sceneCutThreshold <= 1.0f))
+      throw ConfigError("sceneCutThreshold must be in range [0, 1].");
+    if(config.nLongTermSlot > maxLongTermSlot)
+      throw ConfigError("Too many long-term slots.");
+    // the decoder rejects motion beyond the frame size
+    if(config.maxMotionScale >= std::min(config.width, config.height) || config.maxMotionMove > std::min(config.width, config.height))
+      throw ConfigError("maxMotionScale and maxMotionMove must be smaller than the frame.");
+    if(config.tileWidth > 0 && (config.maxMotionScale > 0 || config.maxMotionMove > 0))
+      throw ConfigError("Tiled streams can't have global motion.");
+    const DecodeCostModel &model = config.decodeCostModel;
+    if(!(config.decodeShare >= 0.0f && config.decodeShare <= FLT_MAX))
+      throw ConfigError("decodeShare must be a finite number of at least 0.");
+    if(!(config.decodeFramerate >= 0.0f && config.decodeFramerate <= FLT_MAX))
+      throw ConfigError("decodeFramerate must be a finite number of at least 0.");
+    if(!std::all_of(model.intraCost, model.intraCost + _INTRAPREDICTMODE_ENUM_MAX, [](float v) { return v >= 0.0f && v <= FLT_MAX; }) ||
+      !(model.deltaCost >= 0.0f && model.motionCost >= 0.0f && model.decompressCost >= 0.0f && model.blockCost >= 0.0f) ||
+      !(model.deltaCost <= FLT_MAX && model.motionCost <= FLT_MAX && model.decompressCost <= FLT_MAX && model.blockCost <= FLT_MAX))
+      throw ConfigError("Decode costs must be finite numbers of at least 0.");
+    if(config.pipelineDepth > maxPipelineDepth)
+      throw ConfigError("pipelineDepth is too large.");
+  }
+
+  // nanoseconds of a frame interval at the decode framerate the player may spend decoding, 0 for no budget
+  static float getDecodeBudget(const EncoderConfig &config)
+  {
+    float framerate = config.decodeFramerate > 0.0f ? config.decodeFramerate : static_cast<float>(config.framerate);
+    return config.decodeShare * (1e9f / framerate);
+  }
+
+  static MainStruct makeMainStruct(const EncoderConfig &config)
+  {
+    MainStruct mainStruct;
+    memset(&mainStruct, 0, sizeof(mainStruct));
+    memcpy(mainStruct.aria, "ARiA", 4);
+    mainStruct.version = 0;
+    mainStruct.colorFormat = config.colorFormat;
+    mainStruct.framerate = config.framerate;
+    mainStruct.maxPacketSize = config.maxPacketSize;
+    mainStruct.nLongTermSlot = config.nLongTermSlot;
+    mainStruct.tileWidth = config.tileWidth;
+    mainStruct.tileHeight = config.tileHeight;
+    mainStruct.width = config.width;
+    mainStruct.height = config.height;
+    return mainStruct;
+  }
+
+  EncoderPrivate::EncoderPrivate(Encoder::WriteFunc writeFunc, Encoder::SeekFunc seekFunc, const EncoderConfig &config)
+    : m_write(writeFunc), m_seek(seekFunc), m_config((verifyConfig(config), config)), m_mainStruct(makeMainStruct(config)),
+    m_planeSizeList(getPlaneSizeList(config.colorFormat, config.width, config.height)), m_stats({0, 0, 0, 0, 0, 0}), m_nFed(0), m_finished(false),
+    m_inputList(config.pipelineDepth + 1), m_filling(0), m_quit(false),
+    m_search(m_planeSizeList, config.searchLevel, config.searchCandidateCount, config.referencePruneMargin, config.dropThreshold,
+      config.decodeCostModel, getDecodeBudget(config), config.tileWidth > 0 ? NoSkipMap : config.skipBlockSize, config.tileWidth, config.tileHeight),
+    m_packetWriter(writeFunc, m_mainStruct, config.compressionMethod, config.chunkSize, config.compressionLevel, config.pipelineDepth),
+    m_prev(-1), m_prevFull(-1), m_chainLength(0), m_slotList(config.nLongTermSlot), m_slotLastUse(config.nLongTermSlot, -1),
+    m_slotCost(config.nLongTermSlot, 0.0)
+  {
+    for(size_t i = 0; i < m_inputList.size(); ++i)
+    {
+      m_inputList[i] = allocPlaneSet(m_planeSizeList);
+      m_freeInput.push_back(i);
+    }
+    for(PlaneSet &planeSet : m_buffer)
+      planeSet = allocPlaneSet(m_planeSizeList);
+    if(config.maxMotionScale > 0 || config.maxMotionMove > 0)
+    {
+      for(PlaneSet &planeSet : m_warped)
+        planeSet = allocPlaneSet(m_planeSizeList);
+    }
+    // nFrame is filled in by finish()
+    writeMainStruct();
+    if(config.pipelineDepth > 0)
+      m_thread = std::thread(&EncoderPrivate::work, this);
+  }
+
+  EncoderPrivate::~EncoderPrivate()
+  {
+    if(m_thread.joinable())
+    {
+      {
+        std::unique_lock<std::mutex> locker(m_lock);
+        m_quit = true;
+      }
+      m_changed.notify_all();
+      m_thread.join();
+    }
+  }
+
+  PlaneSet &EncoderPrivate::acquireInput()
+  {
+    std::unique_lock<std::mutex> locker(m_lock);
+    m_changed.wait(locker, [this]() { return !m_freeInput.empty() || m_error; });
+    if(m_error)
+      std::rethrow_exception(m_error);
+    m_filling = m_freeInput.front();
+    m_freeInput.pop_front();
+    return m_inputList[m_filling];
+  }
+
+  void EncoderPrivate::submitInput()
+  {
+    ++m_nFed;
+    if(!m_thread.joinable())
+    {
+      m_freeInput.push_back(m_filling);
+      encodeFrame(m_inputList[m_filling]);
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> locker(m_lock);
+      m_queue.push_back(m_filling);
+    }
+    m_changed.notify_all();
+  }
+
+  void EncoderPrivate::drain()
+  {
+    std::unique_lock<std::mutex> locker(m_lock);
+    m_changed.wait(locker, [this]() { return m_queue.empty() || m_error; });
+    if(m_error)
+      std::rethrow_exception(m_error);
+  }
+
+  // frames are encoded strictly in the order they were fed, every frame references the reconstruction of the ones before it
+  void EncoderPrivate::work()
+  {
+    std::unique_lock<std::mutex> locker(m_lock);
+    for(;;)
+    {
+      m_changed.wait(locker, [this]() { return m_quit || (!m_queue.empty() && !m_error); });
+      if(m_quit)
+        return;
+      size_t slot = m_queue.front();
+      locker.unlock();
+      std::exception_ptr error;
+      try
+      {
+        encodeFrame(m_inputList[slot]);
+      }
+      catch(...)
+      {
+        error = std::current_exception();
+      }
+      locker.lock();
+      // the encoder state is undefined after an error, the frames left are dropped
+      if(error)
+      {
+        m_error = error;
+        m_freeInput.insert(m_freeInput.end(), m_queue.begin(), m_queue.end());
+        m_queue.clear();
+      }
+      else
+      {
+        m_queue.pop_front();
+        m_freeInput.push_back(slot);
+      }
+      m_changed.notify_all();
+    }
+  }
+
+  void EncoderPrivate::writeMainStruct()
+  {
+    m_seek(0);
+    m_write(reinterpret_cast<const char*>(&m_mainStruct), sizeof(MainStruct));
+  }
+
+  bool EncoderPrivate::isSceneCut(const PlaneSet &input, const PlaneSet &prev) const
+  {
+    if(m_config.sceneCutThreshold <= 0.0f)
+      return false;
+    double histDiff = 0.0, sad = 0.0;
+    uint64_t nSample = 0;
+    for(size_t c = 0; c < m_planeSizeList.size(); ++c)
+    {
+      const PlaneSize &s = m_planeSizeList[c];
+      float h, d;
+      lvSceneCutMetric8(input[c].data(), prev[c].data(), static_cast<int>(s.width), static_cast<int>(s.height), 1, 4, &h, &d);
+      histDiff += static_cast<double>(h) * input[c].size();
+      sad += static_cast<double>(d) * input[c].size();
+      nSample += input[c].size();
+    }
+    histDiff /= static_cast<double>(nSample);
+    sad /= static_cast<double>(nSample);
+    return histDiff >= m_config.sceneCutThreshold && sad >= m_config.sceneCutThreshold * sceneCutSADRatio;
+  }
+
+  int EncoderPrivate::findClosestSlot(const PlaneSet &input) const
+  {
+    int bestSlot = -1;
+    double bestDiff = 0.0;
+    for(size_t slot = 0; slot < m_slotList.size(); ++slot)
+    {
+      if(m_slotList[slot].empty())
+        continue;
+      double diff = 0.0;
+      for(size_t c = 0; c < m_planeSizeList.size(); ++c)
+      {
+        const PlaneSize &s = m_planeSizeList[c];
+        const std::vector<uint8_t> &a = input[c], &b = m_slotList[slot][c];
+        uint64_t sum = 0, n = 0;
+        for(uint32_t y = 0; y < s.height; y += 4)
+        {
+          for(uint32_t x = 0; x < s.width; x += 4, ++n)
+          {
+            size_t i = static_cast<size_t>(y) * s.width + x;
+            sum += static_cast<uint64_t>(std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])));
+          }
+        }
+        diff += static_cast<double>(sum) / static_cast<double>(n);
+      }
+      if(bestSlot < 0 || diff < bestDiff)
+      {
+        bestSlot = static_cast<int>(slot);
+        bestDiff = diff;
+      }
+    }
+    return bestSlot;
+  }
+
+  // the motion is searched on the first channel, half size channels are warped by half of it as the decoder does
+  void EncoderPrivate::applyMotion(const PlaneSet &input, SearchReference &reference, PlaneSet &warped) const
+  {
+    if(m_config.maxMotionScale == 0 && m_config.maxMotionMove == 0)
+      return;
+    const PlaneSet &ref = *reference.planeSet;
+    const PlaneSize &full = m_planeSizeList[0];
+    int scale, moveX, moveY;
+    lvMotionSearch8(input[0].data(), ref[0].data(), static_cast<int>(full.width), static_cast<int>(full.height),
+      static_cast<int>(m_config.maxMotionScale), static_cast<int>(m_config.maxMotionMove), &scale, &moveX, &moveY);
+    if(scale == 0 && moveX == 0 && moveY == 0)
+      return;
+    for(size_t c = 0; c < m_planeSizeList.size(); ++c)
+    {
+      const PlaneSize &s = m_planeSizeList[c];
+      int div = s.width < full.width ? 2 : 1;
+      lvMotionResample8(ref[c].data(), static_cast<int>(s.width), static_cast<int>(s.height), scale / div, moveX / div, moveY / div, warped[c].data());
+    }
+    reference.planeSet = &warped;
+    reference.scale = static_cast<int16_t>(scale);
+    reference.moveX = static_cast<int16_t>(moveX);
+    reference.moveY = static_cast<int16_t>(moveY);
+  }
+
+  void EncoderPrivate::encodeFrame(const PlaneSet &input)
+  {
+    VideoFrameStruct vfrm;
+    memset(&vfrm, 0, sizeof(vfrm));
+    memcpy(vfrm.vfrm, "VFRM", 4);
+    for(const std::vector<uint8_t> &plane : input)
+      m_stats.rawBytes += plane.size();
+
+    // a key frame is forced once the chain is at its limit or at a scene cut, without trying any delta
+    bool forceKeyFrame = m_prev < 0 || (m_config.maxChainLength > 0 && m_chainLength >= m_config.maxChainLength) || isSceneCut(input, m_buffer[m_prev]);
+    if(!forceKeyFrame && isRepeatFrame(input, m_buffer[m_prev], m_config.dropThreshold))
+    {
+      vfrm.referenceType = RepeatPreviousReference;
+      m_packetWriter.addFrame(vfrm, {});
+      ++m_chainLength;
+      ++m_stats.repeatFrameCount;
+      ++m_stats.frameCount;
+      return;
+    }
+
+    std::vector<SearchReference> referenceList = {{NoReference, nullptr, 0, 0, 0, 0.0}};
+    int slot = -1;
+    if(!forceKeyFrame)
+    {
+      if(m_prevFull >= 0)
+        referenceList.push_back({PreviousFullReference, &m_buffer[m_prevFull], 0, 0, 0, 0.0});
+      if(m_prev != m_prevFull)
+        referenceList.push_back({PreviousReference, &m_buffer[m_prev], 0, 0, 0, 0.0});
+      // only the closest slot is tried, same as lvenc
+      slot = findClosestSlot(input);
+      if(slot >= 0)
+        referenceList.push_back({LongTermReference, &m_slotList[slot], 0, 0, 0, m_slotCost[slot]});
+      for(size_t r = 1; r < referenceList.size(); ++r)
+        applyMotion(input, referenceList[r], m_warped[r - 1]);
+    }
+    SearchResult result = m_search.search(input, referenceList);
+    m_search.applySkipMap(result, referenceList);
+    m_search.applyTiles(result);
+
+    const SearchReference &chosen = referenceList[result.referenceIndex];
+    vfrm.referenceType = result.referenceType;
+    vfrm.scale = chosen.scale;
+    vfrm.moveX = chosen.moveX;
+    vfrm.moveY = chosen.moveY;
+    vfrm.skipBlockSize = result.skipBlockSize;
+    int64_t frameNumber = m_stats.frameCount;
+    if(result.referenceType == LongTermReference)
+    {
+      vfrm.referenceSlot = static_cast<uint8_t>(slot);
+      m_slotLastUse[slot] = frameNumber;
+    }
+    // only key frames are stored, so the decoder restores a slot from a single frame
+    int storeSlot = -1;
+    if(result.referenceType == NoReference && !m_slotList.empty())
+    {
+      storeSlot = static_cast<int>(std::min_element(m_slotLastUse.begin(), m_slotLastUse.end()) - m_slotLastUse.begin());
+      vfrm.storeSlotMask = static_cast<uint8_t>(1 << storeSlot);
+      m_slotLastUse[storeSlot] = frameNumber;
+    }
+    std::vector<RecordPart> partList;
+    for(size_t c = 0; c < m_planeSizeList.size(); ++c)
+    {
+      vfrm.intraPredictModeList[c] = result.modeList[c];
+      if(result.skipBlockSize == NoSkipMap && !result.tileData)
+        partList.push_back({result.dataList[c], static_cast<uint32_t>(input[c].size())});
+    }
+    if(result.skipBlockSize != NoSkipMap)
+      partList.push_back({result.skipMapData, result.skipMapSize});
+    if(result.tileData)
+    {
+      // the mode table goes with the first tile
+      uint32_t begin = 0;
+      for(uint32_t t = 0; t < result.nTile; ++t)
+      {
+        partList.push_back({result.tileData + begin, result.tileEndList[t] - begin, true});
+        begin = result.tileEndList[t];
+      }
+    }
+    m_packetWriter.addFrame(vfrm, partList);
+
+    int curr = 0;
+    while(curr == m_prev || curr == m_prevFull)
+      ++curr;
+    m_search.reconstruct(result, input, referenceList, m_buffer[curr]);
+    m_prev = curr;
+    if(storeSlot >= 0)
+    {
+      m_slotList[storeSlot] = m_buffer[curr];
+      m_slotCost[storeSlot] = result.decodeCost;
+    }
+    if(result.referenceType == NoReference)
+    {
+      m_prevFull = curr;
+      m_chainLength = 0;
+      ++m_stats.keyFrameCount;
+    }
+    else
+      ++m_chainLength;
+    ++m_stats.frameCount;
+  }
+
+  void EncoderPrivate::finish()
+  {
+    drain();
+    m_packetWriter.flush();
+    m_mainStruct.nFrame = m_stats.frameCount;
+    writeMainStruct();
+    m_seek(static_cast<int64_t>(stats().writtenBytes));
+    m_finished = true;
+  }
+
+  EncoderStats EncoderPrivate::stats() const
+  {
+    EncoderStats out = m_stats;
+    out.packetCount = m_packetWriter.packetCount();
+    out.writtenBytes = sizeof(MainStruct) + m_packetWriter.writtenBytes();
+    return out;
+  }
+
+  Encoder::Encoder(WriteFunc writeFunc, SeekFunc seekFunc, const EncoderConfig &config)
+    : m_dptr(nullptr)
+  {
+    lveAssert(writeFunc && seekFunc);
+    m_dptr = new EncoderPrivate(writeFunc, seekFunc, config);
+  }
+
+  Encoder::~Encoder()
+  {
+    delete m_dptr;
+  }
+
+  /* property getter */
+  uint32_t Encoder::width() const
+  { return m_dptr->m_config.width; }
+  uint32_t Encoder::height() const
+  { return m_dptr->m_config.height; }
+  uint32_t Encoder::framerate() const
+  { return m_dptr->m_config.framerate; }
+  ColorFormat Encoder::colorFormat() const
+  { return m_dptr->m_config.colorFormat; }
+  uint32_t Encoder::channelCount() const
+  { return static_cast<uint32_t>(m_dptr->m_planeSizeList.size()); }
+  uint32_t Encoder::channelWidth(uint32_t channel) const
+  { return m_dptr->m_planeSizeList.at(channel).width; }
+  uint32_t Encoder::channelHeight(uint32_t channel) const
+  { return m_dptr->m_planeSizeList.at(channel).height; }
+
+  /* method */
+  void Encoder::feedFrame(const uint8_t *const *planeList, const uint32_t *strideList)
+  {
+    EncoderPrivate &d = *m_dptr;
+    lveAssert(!d.m_finished, "The encoder is finished.");
+    lveAssert(planeList);
+    if(d.m_nFed == UINT32_MAX)
+      throw ConfigError("Too many frames.");
+    for(size_t c = 0; c < d.m_planeSizeList.size(); ++c)
+      lveAssert(planeList[c] && (!strideList || strideList[c] >= d.m_planeSizeList[c].width));
+    PlaneSet &input = d.acquireInput();
+    for(size_t c = 0; c < d.m_planeSizeList.size(); ++c)
+    {
+      const PlaneSize &s = d.m_planeSizeList[c];
+      uint32_t stride = strideList ? strideList[c] : s.width;
+      for(uint32_t y = 0; y < s.height; ++y)
+        std::copy(planeList[c] + static_cast<size_t>(y) * stride, planeList[c] + static_cast<size_t>(y) * stride + s.width, input[c].begin() + static_cast<size_t>(y) * s.width);
+    }
+    d.submitInput();
+  }
+
+  void Encoder::feedFrameRGB(const uint8_t *pixels, uint32_t nChannel, uint32_t stride)
+  {
+    EncoderPrivate &d = *m_dptr;
+    lveAssert(!d.m_finished, "The encoder is finished.");
+    lveAssert(pixels && (nChannel == 3 || nChannel == 4));
+    lveAssert(d.m_config.colorFormat != YUVA420P || nChannel == 4, "YUVA420P needs RGBA.");
+    if(d.m_nFed == UINT32_MAX)
+      throw ConfigError("Too many frames.");
+    if(stride == 0)
+      stride = d.m_config.width * nChannel;
+    lveAssert(stride >= d.m_config.width * nChannel);
+    PlaneSet &input = d.acquireInput();
+    uint8_t *alpha = d.m_config.colorFormat == YUVA420P ? input[3].data() : nullptr;
+    lvRGBI2YUV420P8(pixels, static_cast<int>(nChannel), static_cast<int>(stride), input[0].data(), input[1].data(), input[2].data(), alpha,
+      static_cast<int>(d.m_config.width), static_cast<int>(d.m_config.height), 0);
+    d.submitInput();
+  }
+
+  void Encoder::finish()
+  {
+    lveAssert(!m_dptr->m_finished, "The encoder is finished.");
+    m_dptr->finish();
+  }
+
+  /* status getter */
+  uint32_t Encoder::frameCount() const
+  { return m_dptr->m_nFed; }
+
+  bool Encoder::isFinished() const
+  { return m_dptr->m_finished; }
+
+  EncoderStats Encoder::stats() const
+  {
+    m_dptr->drain();
+    return m_dptr->stats();
+  }
+} // namespace LightVideoEncoder
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../encoder.hpp"
+#include "plane_p.hpp"
+#include "search_p.hpp"
+#include "packetwriter_p.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+
+namespace LightVideoEncoder
+{
+  class EncoderPrivate final
+  {
+  public:
+    EncoderPrivate(Encoder::WriteFunc writeFunc, Encoder::SeekFunc seekFunc, const EncoderConfig &config);
+    // frames still queued are dropped
+    ~EncoderPrivate();
+
+    // the planes of the next frame, waits while every input slot is queued
+    PlaneSet &acquireInput();
+    // queues the planes acquireInput() returned for the encoder thread, or encodes them right away without a pipeline
+    void submitInput();
+    // waits until every queued frame is encoded, rethrows an error the encoder thread ran into
+    void drain();
+    void finish();
+    // packets pending in the packet writer are not counted yet
+    EncoderStats stats() const;
+
+    Encoder::WriteFunc m_write;
+    Encoder::SeekFunc m_seek;
+    EncoderConfig m_config;
+    MainStruct m_mainStruct;
+    std::vector<PlaneSize> m_planeSizeList;
+    EncoderStats m_stats;
+    uint32_t m_nFed;
+    bool m_finished;
+
+  private:
+    void work();
+    void encodeFrame(const PlaneSet &input);
+    bool isSceneCut(const PlaneSet &input, const PlaneSet &prev) const;
+    // the filled slot with the smallest mean absolute difference on every 4th sample, -1 if every slot is empty
+    int findClosestSlot(const PlaneSet &input) const;
+    void applyMotion(const PlaneSet &input, SearchReference &reference, PlaneSet &warped) const;
+    void writeMainStruct();
+
+    /*
+      Input slots cycle from the free list through the queue, the encoder thread keeps a slot queued while it encodes it.
+      So the caller fills the next frame while the previous ones are searched, and packets compress on the task pool meanwhile.
+      Without a pipeline there is a single slot and no thread.
+    */
+    std::vector<PlaneSet> m_inputList;
+    std::deque<size_t> m_freeInput, m_queue;
+    size_t m_filling;
+    std::thread m_thread;
+    std::mutex m_lock;
+    std::condition_variable m_changed;
+    std::exception_ptr m_error;
+    bool m_quit;
+
+    FrameSearch m_search;
+    PacketWriter m_packetWriter;
+    // three reconstructed plane sets are rotated like in the decoder, so references never have to be copied
+    PlaneSet m_buffer[3];
+    // the references warped by their global motion, only allocated with motion enabled
+    PlaneSet m_warped[3];
+    int m_prev, m_prevFull;
+    uint32_t m_chainLength;
+    // reconstructed key frames, empty until stored, and the frame each slot was last stored or referenced at
+    std::vector<PlaneSet> m_slotList;
+    std::vector<int64_t> m_slotLastUse;
+    // modeled decode time of the key frame in each slot, what a LongTermReference frame adds when its slot is restored after a seek
+    std::vector<double> m_slotCost;
+  };
+} // namespace LightVideoEncoder
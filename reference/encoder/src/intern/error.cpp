@@ -0,0 +1,13 @@
+#include "../error.hpp"
+
+#define _LV_IMPL_ERROR(name, base) \
+  name :: name (const char *what_arg) : base (what_arg) {} \
+  name :: ~ name () {}
+namespace LightVideoEncoder
+{
+  _LV_IMPL_ERROR(RuntimeError, std::runtime_error);
+  _LV_IMPL_ERROR(IOError, RuntimeError);
+  _LV_IMPL_ERROR(ConfigError, RuntimeError);
+  _LV_IMPL_ERROR(CompressionError, RuntimeError);
+} // namespace LightVideoEncoder
+#undef _LV_IMPL_ERROR
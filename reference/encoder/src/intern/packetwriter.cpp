@@ -0,0 +1,140 @@
+#include "packetwriter_p.hpp"
+#include "../error.hpp"
+#include "util_p.hpp"
+#include "../../../helper/src/asynclz4.h"
+#include <cstring>
+
+namespace LightVideoEncoder
+{
+  PacketWriter::PacketWriter(Encoder::WriteFunc writeFunc, const MainStruct &mainStruct, CompressionMethod compressionMethod, uint32_t chunkSize, int level,
+    uint32_t maxPending)
+    : m_write(writeFunc), m_maxPacketSize(mainStruct.maxPacketSize), m_compressionMethod(compressionMethod), m_chunkSize(chunkSize), m_level(level),
+    m_maxPending(maxPending), m_nFrame(0), m_nFullFrame(0), m_storeSlotMask(0), m_nPacket(0), m_writtenBytes(0)
+  {
+    lveAssert(compressionMethod == LZ4Compression || compressionMethod == ChunkedLZ4Compression);
+  }
+
+  PacketWriter::~PacketWriter()
+  {
+    for(PendingPacket &packet : m_pending)
+      if(packet.task)
+        lvDestroyLZ4CompressionTask(packet.task);
+  }
+
+  void PacketWriter::addFrame(const VideoFrameStruct &vfrm, const std::vector<RecordPart> &partList)
+  {
+    const char *header = reinterpret_cast<const char*>(&vfrm);
+    m_data.insert(m_data.end(), header, header + sizeof(VideoFrameStruct));
+    for(const RecordPart &part : partList)
+    {
+      const char *begin = reinterpret_cast<const char*>(part.data);
+      m_data.insert(m_data.end(), begin, begin + part.size);
+      if(part.chunkEnd)
+        m_chunkEndList.push_back(static_cast<uint32_t>(m_data.size()));
+    }
+    ++m_nFrame;
+    if(vfrm.referenceType == NoReference)
+      ++m_nFullFrame;
+    m_storeSlotMask |= vfrm.storeSlotMask;
+    if(m_nFrame == m_maxPacketSize)
+    {
+      submit();
+      writeFinished(m_maxPending);
+    }
+  }
+
+  void PacketWriter::flush()
+  {
+    submit();
+    writeFinished(0);
+  }
+
+  void PacketWriter::submit()
+  {
+    if(m_nFrame == 0)
+      return;
+    if(m_data.size() > 0x7E000000)
+      throw CompressionError("Packet is too large.");
+    m_pending.emplace_back();
+    PendingPacket &packet = m_pending.back();
+    memset(&packet.vfpk, 0, sizeof(packet.vfpk));
+    memcpy(packet.vfpk.vfpk, "VFPK", 4);
+    packet.vfpk.nFrame = m_nFrame;
+    packet.vfpk.nFullFrame = m_nFullFrame;
+    packet.vfpk.compressionMethod = m_compressionMethod;
+    packet.vfpk.storeSlotMask = m_storeSlotMask;
+    packet.data.swap(m_data);
+    if(!m_spare.empty())
+    {
+      packet.payload.swap(m_spare.back());
+      m_spare.pop_back();
+    }
+    if(!m_spare.empty())
+    {
+      m_data.swap(m_spare.back());
+      m_spare.pop_back();
+    }
+
+    int srcSize = static_cast<int>(packet.data.size());
+    int chunkSize = static_cast<int>(m_chunkSize);
+    if(m_compressionMethod == ChunkedLZ4Compression && !m_chunkEndList.empty())
+    {
+      // tiles get chunks of their own as far as minChunkSize allows, so a decoder skips the chunks of tiles it doesn't need
+      std::vector<int> chunkEndList;
+      int begin = 0;
+      for(uint32_t end : m_chunkEndList)
+      {
+        if(static_cast<int>(end) - begin >= static_cast<int>(minChunkSize) && static_cast<int>(end) < srcSize)
+        {
+          chunkEndList.push_back(static_cast<int>(end));
+          begin = static_cast<int>(end);
+        }
+      }
+      chunkEndList.push_back(srcSize);
+      int nChunk = static_cast<int>(chunkEndList.size());
+      packet.payload.resize(lvGetChunkedLZ4CompressBoundByEnds(chunkEndList.data(), nChunk));
+      packet.task = lvCreateChunkedLZ4CompressionTaskByEndsInto(packet.data.data(), chunkEndList.data(), nChunk,
+        packet.payload.data(), static_cast<int>(packet.payload.size()), lvHighCompression, m_level, true, nullptr, nullptr);
+    }
+    else if(m_compressionMethod == ChunkedLZ4Compression)
+    {
+      packet.payload.resize(lvGetChunkedLZ4CompressBound(srcSize, chunkSize));
+      packet.task = lvCreateChunkedLZ4CompressionTaskInto(packet.data.data(), srcSize, chunkSize, packet.payload.data(), static_cast<int>(packet.payload.size()),
+        lvHighCompression, m_level, true, nullptr, nullptr);
+    }
+    else
+    {
+      packet.payload.resize(lvGetLZ4CompressBound(srcSize));
+      packet.task = lvCreateLZ4CompressionTaskInto(packet.data.data(), srcSize, packet.payload.data(), static_cast<int>(packet.payload.size()),
+        lvHighCompression, m_level, true, nullptr, nullptr);
+    }
+    m_data.clear();
+    m_chunkEndList.clear();
+    m_nFrame = m_nFullFrame = m_storeSlotMask = 0;
+  }
+
+  void PacketWriter::writeFinished(size_t maxPending)
+  {
+    while(!m_pending.empty() && (m_pending.size() > maxPending || lvWaitLZ4CompressionTask(m_pending.front().task, 0) == lvFinished))
+    {
+      // taken out before anything can throw, so a failing write leaves no task behind for the destructor
+      PendingPacket packet = std::move(m_pending.front());
+      m_pending.pop_front();
+      int size = lvGetLZ4CompressionTaskResultSize(packet.task);
+      uint32_t checksum = lvGetLZ4CompressionTaskResultAdler32(packet.task);
+      lvDestroyLZ4CompressionTask(packet.task);
+      if(size <= 0)
+        throw CompressionError("Failed to compress a packet.");
+      packet.vfpk.size = static_cast<uint32_t>(size);
+      packet.vfpk.checksum = checksum;
+
+      m_write(reinterpret_cast<const char*>(&packet.vfpk), sizeof(packet.vfpk));
+      m_write(packet.payload.data(), size);
+      m_writtenBytes += sizeof(packet.vfpk) + size;
+      ++m_nPacket;
+
+      m_spare.push_back(std::move(packet.data));
+      m_spare.push_back(std::move(packet.payload));
+    }
+  }
+} // namespace LightVideoEncoder
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../encoder.hpp"
+#include <vector>
+#include <deque>
+
+struct LZ4CompressionTask;
+
+namespace LightVideoEncoder
+{
+  struct RecordPart
+  {
+    const void *data;
+    uint32_t size;
+    bool chunkEnd = false; // a ChunkedLZ4Compression chunk ends behind the part once it holds minChunkSize bytes
+  };
+
+  /*
+    Collects frame records into the packet data and starts compressing a packet once it holds maxPacketSize frames.
+    ChunkedLZ4Compression packets are cut into chunkSize bytes, or at the part ends marked as chunk ends if the packet has any.
+    Up to maxPending packets compress in the background while later frames are searched, packets are written in order
+    as soon as they are done, the oldest one is waited for when the limit is reached. maxPending 0 writes every packet right away.
+    The payload checksum is the adler32 of the compressed payload.
+  */
+  class PacketWriter final
+  {
+  public:
+    PacketWriter(Encoder::WriteFunc writeFunc, const MainStruct &mainStruct, CompressionMethod compressionMethod, uint32_t chunkSize, int level,
+      uint32_t maxPending);
+    // waits for the packets still compressing without writing them
+    ~PacketWriter();
+
+    // a record is its VideoFrameStruct followed by parts
+    void addFrame(const VideoFrameStruct &vfrm, const std::vector<RecordPart> &partList);
+    // writes the pending frames as a packet of their own and waits until every packet is written
+    void flush();
+
+    uint32_t packetCount() const
+    { return m_nPacket; }
+    uint64_t writtenBytes() const
+    { return m_writtenBytes; }
+
+  private:
+    struct PendingPacket
+    {
+      VideoFramePacket vfpk; // size and checksum are filled in once compressed
+      std::vector<char> data, payload; // borrowed by task until it is finished
+      LZ4CompressionTask *task;
+    };
+
+    // starts compressing the collected frames
+    void submit();
+    // writes finished packets in order, waiting for the oldest one while more than maxPending are left
+    void writeFinished(size_t maxPending);
+
+    Encoder::WriteFunc m_write;
+    uint8_t m_maxPacketSize;
+    CompressionMethod m_compressionMethod;
+    uint32_t m_chunkSize;
+    int m_level;
+    uint32_t m_maxPending;
+
+    std::vector<char> m_data;
+    std::vector<uint32_t> m_chunkEndList; // marked part ends in m_data
+    std::deque<PendingPacket> m_pending;
+    // buffers of written packets, reused by later ones
+    std::vector<std::vector<char>> m_spare;
+    uint8_t m_nFrame, m_nFullFrame, m_storeSlotMask;
+    uint32_t m_nPacket;
+    uint64_t m_writtenBytes;
+  };
+} // namespace LightVideoEncoder
@@ -0,0 +1,32 @@
+#include "plane_p.hpp"
+#include "util_p.hpp"
+
+namespace LightVideoEncoder
+{
+  std::vector<PlaneSize> getPlaneSizeList(ColorFormat colorFormat, uint32_t width, uint32_t height)
+  {
+    std::vector<PlaneSize> out;
+    PlaneSize full = {width, height};
+    PlaneSize half = {std::max(1U, width / 2), std::max(1U, height / 2)};
+    switch(colorFormat)
+    {
+    case YUV420P:
+      out = {full, half, half};
+      break;
+    case YUVA420P:
+      out = {full, half, half, full};
+      break;
+    default:
+      lveAssert(false);
+    }
+    return out;
+  }
+
+  PlaneSet allocPlaneSet(const std::vector<PlaneSize> &planeSizeList)
+  {
+    PlaneSet out;
+    for(const PlaneSize &s : planeSizeList)
+      out.emplace_back(static_cast<size_t>(s.width) * s.height);
+    return out;
+  }
+} // namespace LightVideoEncoder
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "../struct.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace LightVideoEncoder
+{
+  constexpr uint32_t maxChannel = 4;
+
+  struct PlaneSize
+  {
+    uint32_t width, height;
+  };
+
+  // channel -> packed samples
+  typedef std::vector<std::vector<uint8_t>> PlaneSet;
+
+  // same channel sizes as getColorFormatInfo() of fastdecoder
+  std::vector<PlaneSize> getPlaneSizeList(ColorFormat colorFormat, uint32_t width, uint32_t height);
+  PlaneSet allocPlaneSet(const std::vector<PlaneSize> &planeSizeList);
+} // namespace LightVideoEncoder
@@ -0,0 +1,711 @@
+#include "search_p.hpp"
+#include "../error.hpp"
+#include "util_p.hpp"
+#include "../../../helper/src/intrafilter.h"
+#include "../../../helper/src/asynclz4.h"
+#include "../../../helper/src/estimate.h"
+#include "../../../helper/src/residual.h"
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+
+namespace LightVideoEncoder
+{
+  typedef void (*FilterFunc)(uint8_t *data, int width, int height, uint8_t threshold);
+  typedef void (*DefilterFunc)(uint8_t *data, int width, int height, int bpp);
+
+  // indexed by IntraPredictMode
+  static const FilterFunc filterList[_INTRAPREDICTMODE_ENUM_MAX] = {nullptr, lvFilterSubTop8, lvFilterSubLeft8, lvFilterSubAvg8, lvFilterSubPaeth8};
+  static const DefilterFunc defilterList[_INTRAPREDICTMODE_ENUM_MAX] = {nullptr, lvDefilterSubTop8, lvDefilterSubLeft8, lvDefilterSubAvg8, lvDefilterSubPaeth8};
+
+  // budgets compare sums taken in different orders
+  constexpr double budgetTolerance = 1e-9;
+
+  // luma range [begin, end) of a block mapped onto a channel axis, same as mapTileRange() of fastdecoder
+  static void mapBlockRange(uint32_t begin, uint32_t end, uint32_t length, uint32_t channelLength, uint32_t &outBegin, uint32_t &outEnd)
+  {
+    if(channelLength == length)
+    {
+      outBegin = begin;
+      outEnd = end;
+    }
+    else
+    {
+      outBegin = std::min(channelLength, begin / 2);
+      outEnd = end == length ? channelLength : std::min(channelLength, end / 2);
+    }
+  }
+
+  // blocks of blockWidth x blockHeight luma samples in raster order, mapped onto every channel
+  static std::vector<std::vector<BlockRect>> getBlockGrid(const std::vector<PlaneSize> &planeSizeList, uint32_t blockWidth, uint32_t blockHeight)
+  {
+    uint32_t width = planeSizeList[0].width, height = planeSizeList[0].height;
+    uint32_t nBlockX = (width + blockWidth - 1) / blockWidth, nBlockY = (height + blockHeight - 1) / blockHeight;
+    std::vector<std::vector<BlockRect>> out(planeSizeList.size());
+    for(uint32_t by = 0; by < nBlockY; ++by)
+    {
+      for(uint32_t bx = 0; bx < nBlockX; ++bx)
+      {
+        for(size_t c = 0; c < planeSizeList.size(); ++c)
+        {
+          const PlaneSize &s = planeSizeList[c];
+          uint32_t x0, x1, y0, y1;
+          mapBlockRange(bx * blockWidth, std::min(width, (bx + 1) * blockWidth), width, s.width, x0, x1);
+          mapBlockRange(by * blockHeight, std::min(height, (by + 1) * blockHeight), height, s.height, y0, y1);
+          out[c].push_back({x0, y0, x1 - x0, y1 - y0});
+        }
+      }
+    }
+    return out;
+  }
+
+  static void copyBlock(const uint8_t *plane, uint32_t stride, const BlockRect &rect, uint8_t *out)
+  {
+    for(uint32_t y = 0; y < rect.height; ++y)
+    {
+      const uint8_t *row = plane + static_cast<size_t>(rect.y + y) * stride + rect.x;
+      std::copy(row, row + rect.width, out + static_cast<size_t>(y) * rect.width);
+    }
+  }
+
+  FrameSearch::FrameSearch(const std::vector<PlaneSize> &planeSizeList, int searchLevel, uint32_t candidateCount, float pruneMargin, uint8_t dropThreshold,
+    const DecodeCostModel &costModel, float decodeBudget, SkipBlockSize skipBlockSize, uint16_t tileWidth, uint16_t tileHeight)
+    : m_planeSizeList(planeSizeList), m_searchLevel(searchLevel), m_candidateCount(candidateCount), m_pruneMargin(pruneMargin), m_dropThreshold(dropThreshold),
+    m_costModel(costModel), m_decodeBudget(decodeBudget), m_frameCost(0.0), m_skipBlockSize(skipBlockSize), m_bitmapSize(0)
+  {
+    lveAssert(planeSizeList.size() <= maxChannel);
+    uint64_t recordSize = sizeof(VideoFrameStruct);
+    for(const PlaneSize &s : planeSizeList)
+      recordSize += static_cast<uint64_t>(s.width) * s.height;
+    m_frameCost = static_cast<double>(recordSize) * costModel.decompressCost;
+
+    // tiles take the place of skip maps
+    if(tileWidth > 0 && tileHeight > 0)
+    {
+      m_tileRect = getBlockGrid(planeSizeList, tileWidth, tileHeight);
+      m_tileData.reserve(m_tileRect[0].size() * planeSizeList.size() + recordSize - sizeof(VideoFrameStruct));
+      m_tilePart.resize(static_cast<size_t>(tileWidth) * tileHeight);
+      m_tileFiltered.resize(m_tilePart.size());
+      return;
+    }
+    if(skipBlockSize == NoSkipMap)
+      return;
+    uint32_t length = 8U << skipBlockSize;
+    m_blockRect = getBlockGrid(planeSizeList, length, length);
+    m_bitmapSize = static_cast<uint32_t>(m_blockRect[0].size() + 7) / 8;
+    m_skipMapData.reserve(m_bitmapSize + recordSize - sizeof(VideoFrameStruct));
+    m_skipMapCompressed.resize(lvGetLZ4CompressBound(static_cast<int>(m_skipMapData.capacity())));
+  }
+
+  void FrameSearch::prepareReference(uint32_t iReference)
+  {
+    if(m_residual.size() > iReference)
+      return;
+    m_residual.resize(iReference + 1);
+    m_filtered.resize(iReference + 1);
+    m_compressed.resize(iReference + 1);
+    m_residual[iReference] = allocPlaneSet(m_planeSizeList);
+    for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+    {
+      m_filtered[iReference].push_back(allocPlaneSet(m_planeSizeList));
+      m_compressed[iReference].emplace_back();
+      for(const PlaneSize &s : m_planeSizeList)
+        m_compressed[iReference][mode].emplace_back(lvGetLZ4CompressBound(static_cast<int>(s.width * s.height)));
+    }
+  }
+
+  void FrameSearch::pruneReferences(const PlaneSet &curr, const std::vector<SearchReference> &referenceList, std::vector<bool> &active)
+  {
+    uint32_t nReference = static_cast<uint32_t>(referenceList.size());
+    active.assign(nReference, true);
+    if(m_pruneMargin < 0.0f || nReference < 2)
+      return;
+
+    // bits of the filtered residuals, each non-zero one costs its magnitude plus a literal overhead, zero ones vanish in runs
+    std::vector<double> costList(nReference, 0.0);
+    for(uint32_t r = 0; r < nReference; ++r)
+    {
+      for(uint32_t c = 0; c < m_planeSizeList.size(); ++c)
+      {
+        const PlaneSize &s = m_planeSizeList[c];
+        // delta residuals drop like lvComputeResidual8(), key frames are taken lossless since their lossy intra filters
+        // predict from dropped samples, so small steps add up instead of vanishing
+        const uint8_t *ref = referenceList[r].planeSet ? (*referenceList[r].planeSet)[c].data() : nullptr;
+        uint64_t sumAbs, nZero;
+        lvResidualStats8(curr[c].data(), ref, static_cast<int>(s.width), static_cast<int>(s.height), ref ? m_dropThreshold : 0, &sumAbs, &nZero);
+        uint64_t nNonZero = static_cast<uint64_t>(s.width) * s.height - nZero;
+        if(nNonZero)
+          costList[r] += static_cast<double>(nNonZero) * (2.0 + std::log2(1.0 + static_cast<double>(sumAbs) / static_cast<double>(nNonZero)));
+      }
+    }
+    double limit = *std::min_element(costList.begin(), costList.end()) * (1.0 + m_pruneMargin);
+    for(uint32_t r = 0; r < nReference; ++r)
+      active[r] = costList[r] <= limit;
+  }
+
+  double FrameSearch::candidateCost(const SearchReference &reference, int mode, uint32_t c) const
+  {
+    const PlaneSize &s = m_planeSizeList[c];
+    double cost = m_costModel.intraCost[mode];
+    if(reference.planeSet)
+      cost += reference.scale != 0 || reference.moveX != 0 || reference.moveY != 0 ? m_costModel.motionCost : m_costModel.deltaCost;
+    return cost * static_cast<double>(s.width) * static_cast<double>(s.height);
+  }
+
+  double FrameSearch::minimumCost(const SearchReference &reference) const
+  {
+    double cost = m_frameCost + reference.restoreCost;
+    for(uint32_t c = 0; c < m_planeSizeList.size(); ++c)
+    {
+      double channelCost = candidateCost(reference, 0, c);
+      for(int mode = 1; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+        channelCost = std::min(channelCost, candidateCost(reference, mode, c));
+      cost += channelCost;
+    }
+    return cost;
+  }
+
+  double FrameSearch::resultCost(const SearchReference &reference, const IntraPredictMode *modeList) const
+  {
+    double cost = m_frameCost + reference.restoreCost;
+    for(uint32_t c = 0; c < m_planeSizeList.size(); ++c)
+      cost += candidateCost(reference, modeList[c], c);
+    return cost;
+  }
+
+  bool FrameSearch::isBlockUnchanged(const PlaneSet &residual, uint32_t b) const
+  {
+    for(uint32_t c = 0; c < m_planeSizeList.size(); ++c)
+    {
+      const BlockRect &rect = m_blockRect[c][b];
+      for(uint32_t y = rect.y; y < rect.y + rect.height; ++y)
+      {
+        const uint8_t *row = residual[c].data() + static_cast<size_t>(y) * m_planeSizeList[c].width + rect.x;
+        if(!std::all_of(row, row + rect.width, [](uint8_t v) { return v == 0; }))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  bool FrameSearch::countChangedSamples(const SearchReference &reference, uint32_t r, uint64_t *changedList) const
+  {
+    if(m_blockRect.empty() || !reference.planeSet || reference.scale != 0 || reference.moveX != 0 || reference.moveY != 0)
+      return false;
+    uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+    uint32_t nBlock = static_cast<uint32_t>(m_blockRect[0].size());
+    std::fill(changedList, changedList + nChannel, 0);
+    bool skipped = false;
+    for(uint32_t b = 0; b < nBlock; ++b)
+    {
+      if(isBlockUnchanged(m_residual[r], b))
+      {
+        skipped = true;
+        continue;
+      }
+      for(uint32_t c = 0; c < nChannel; ++c)
+        changedList[c] += static_cast<uint64_t>(m_blockRect[c][b].width) * m_blockRect[c][b].height;
+    }
+    return skipped;
+  }
+
+  double FrameSearch::skipMapCost(const SearchReference &reference, const IntraPredictMode *modeList, const uint64_t *changedList) const
+  {
+    // every sample takes the reference, changed blocks are decompressed and defiltered one by one, blockCost is per 16 x 16 of them
+    uint64_t recordSize = sizeof(VideoFrameStruct) + m_bitmapSize, nChanged = 0;
+    double cost = reference.restoreCost;
+    for(uint32_t c = 0; c < m_planeSizeList.size(); ++c)
+    {
+      const PlaneSize &s = m_planeSizeList[c];
+      recordSize += changedList[c];
+      nChanged += changedList[c];
+      cost += static_cast<double>(changedList[c]) * m_costModel.intraCost[modeList[c]];
+      cost += static_cast<double>(s.width) * static_cast<double>(s.height) * m_costModel.deltaCost;
+    }
+    cost += static_cast<double>(recordSize) * m_costModel.decompressCost;
+    return cost + static_cast<double>(nChanged) / 256.0 * m_costModel.blockCost;
+  }
+
+  double FrameSearch::budgetReferences(const std::vector<SearchReference> &referenceList, std::vector<bool> &active) const
+  {
+    uint32_t nReference = static_cast<uint32_t>(referenceList.size());
+    std::vector<double> costList(nReference);
+    uint32_t cheapest = 0;
+    bool fits = false;
+    for(uint32_t r = 0; r < nReference; ++r)
+    {
+      costList[r] = minimumCost(referenceList[r]);
+      if(costList[r] < costList[cheapest])
+        cheapest = r;
+      fits = fits || (active[r] && costList[r] <= m_decodeBudget);
+    }
+    if(!fits)
+    {
+      active.assign(nReference, false);
+      active[cheapest] = true;
+      return costList[cheapest] * (1.0 + budgetTolerance);
+    }
+    for(uint32_t r = 0; r < nReference; ++r)
+      active[r] = active[r] && costList[r] <= m_decodeBudget;
+    return m_decodeBudget * (1.0 + budgetTolerance);
+  }
+
+  void FrameSearch::budgetCandidates(const std::vector<SearchReference> &referenceList, double budget, std::vector<bool> &feasible) const
+  {
+    uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+    uint32_t nReference = static_cast<uint32_t>(referenceList.size());
+    for(uint32_t r = 0; r < nReference; ++r)
+    {
+      double minCost = minimumCost(referenceList[r]);
+      for(uint32_t c = 0; c < nChannel; ++c)
+      {
+        double channelMin = candidateCost(referenceList[r], 0, c);
+        for(int mode = 1; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+          channelMin = std::min(channelMin, candidateCost(referenceList[r], mode, c));
+        for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+          feasible[(mode * nReference + r) * nChannel + c] = minCost - channelMin + candidateCost(referenceList[r], mode, c) <= budget;
+      }
+    }
+  }
+
+  void FrameSearch::selectCheapest(const std::vector<SearchReference> &referenceList, std::vector<bool> &selected) const
+  {
+    uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+    uint32_t nReference = static_cast<uint32_t>(referenceList.size());
+    for(uint32_t r = 0; r < nReference; ++r)
+    {
+      bool any = false;
+      for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+      {
+        for(uint32_t c = 0; c < nChannel; ++c)
+          any = any || selected[(mode * nReference + r) * nChannel + c];
+      }
+      if(!any)
+        continue;
+      for(uint32_t c = 0; c < nChannel; ++c)
+      {
+        int cheapest = 0;
+        for(int mode = 1; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+        {
+          if(candidateCost(referenceList[r], mode, c) < candidateCost(referenceList[r], cheapest, c))
+            cheapest = mode;
+        }
+        selected[(cheapest * nReference + r) * nChannel + c] = true;
+      }
+    }
+  }
+
+  void FrameSearch::selectCandidates(const std::vector<bool> &active, const std::vector<bool> &feasible, std::vector<bool> &selected)
+  {
+    uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+    uint32_t nReference = static_cast<uint32_t>(active.size());
+    selected.assign(_INTRAPREDICTMODE_ENUM_MAX * nReference * nChannel, false);
+    if(m_candidateCount == 0)
+    {
+      for(size_t i = 0; i < selected.size(); ++i)
+        selected[i] = active[(i / nChannel) % nReference] && feasible[i];
+      return;
+    }
+
+    // stable sorts keep the order of the exhaustive search among equal estimates
+    std::vector<uint64_t> referenceEstimate(nReference, UINT64_MAX);
+    std::vector<std::vector<int>> modeOrder(nReference * nChannel);
+    uint32_t nActive = 0;
+    for(uint32_t r = 0; r < nReference; ++r)
+    {
+      if(!active[r])
+        continue;
+      ++nActive;
+      referenceEstimate[r] = 0;
+      for(uint32_t c = 0; c < nChannel; ++c)
+      {
+        int estimate[_INTRAPREDICTMODE_ENUM_MAX];
+        for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+        {
+          const std::vector<uint8_t> &filtered = m_filtered[r][mode][c];
+          estimate[mode] = lvEstimateLZ4Size(filtered.data(), static_cast<int>(filtered.size()));
+        }
+        std::vector<int> &order = modeOrder[r * nChannel + c];
+        for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+        {
+          if(feasible[(mode * nReference + r) * nChannel + c])
+            order.push_back(mode);
+        }
+        std::stable_sort(order.begin(), order.end(), [&estimate](int a, int b) { return estimate[a] < estimate[b]; });
+        // an active reference keeps at least its cheapest mode feasible on every channel
+        referenceEstimate[r] += static_cast<uint64_t>(estimate[order[0]]);
+      }
+    }
+    std::vector<uint32_t> referenceOrder(nReference);
+    std::iota(referenceOrder.begin(), referenceOrder.end(), 0);
+    std::stable_sort(referenceOrder.begin(), referenceOrder.end(), [&referenceEstimate](uint32_t a, uint32_t b) { return referenceEstimate[a] < referenceEstimate[b]; });
+
+    uint32_t nSelectedReference = std::min(nActive, m_candidateCount);
+    uint32_t nSelectedMode = std::min(static_cast<uint32_t>(_INTRAPREDICTMODE_ENUM_MAX), m_candidateCount);
+    for(uint32_t i = 0; i < nSelectedReference; ++i)
+    {
+      uint32_t r = referenceOrder[i];
+      for(uint32_t c = 0; c < nChannel; ++c)
+      {
+        const std::vector<int> &order = modeOrder[r * nChannel + c];
+        for(uint32_t j = 0; j < nSelectedMode && j < order.size(); ++j)
+          selected[(order[j] * nReference + r) * nChannel + c] = true;
+      }
+    }
+  }
+
+  SearchResult FrameSearch::search(const PlaneSet &curr, const std::vector<SearchReference> &referenceList)
+  {
+    lveAssert(!referenceList.empty());
+    uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+    uint32_t nReference = static_cast<uint32_t>(referenceList.size());
+    std::vector<bool> active;
+    pruneReferences(curr, referenceList, active);
+    double budget = m_decodeBudget > 0.0f ? budgetReferences(referenceList, active) : 0.0;
+    for(uint32_t r = 0; r < nReference; ++r)
+    {
+      prepareReference(r);
+      if(!active[r])
+        continue;
+      const SearchReference &reference = referenceList[r];
+      // a key frame drops inside the intra filter, a delta frame already dropped in its residual
+      uint8_t threshold = reference.planeSet ? 0 : m_dropThreshold;
+      for(uint32_t c = 0; c < nChannel; ++c)
+      {
+        const PlaneSize &s = m_planeSizeList[c];
+        std::vector<uint8_t> &residual = m_residual[r][c];
+        if(reference.planeSet)
+          lvComputeResidual8(curr[c].data(), (*reference.planeSet)[c].data(), residual.data(), nullptr, static_cast<int64_t>(residual.size()), m_dropThreshold);
+        else
+          std::copy(curr[c].begin(), curr[c].end(), residual.begin());
+        for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+        {
+          std::vector<uint8_t> &filtered = m_filtered[r][mode][c];
+          std::copy(residual.begin(), residual.end(), filtered.begin());
+          if(filterList[mode])
+            filterList[mode](filtered.data(), static_cast<int>(s.width), static_cast<int>(s.height), threshold);
+        }
+      }
+    }
+
+    std::vector<bool> feasible(_INTRAPREDICTMODE_ENUM_MAX * nReference * nChannel, true), selected;
+    if(budget > 0.0)
+      budgetCandidates(referenceList, budget, feasible);
+    selectCandidates(active, feasible, selected);
+    if(budget > 0.0)
+      selectCheapest(referenceList, selected);
+
+    /*
+      The candidates of a channel share a size bound, so a mode that starts after a smaller one finished aborts once it is larger.
+      Tasks are posted mode by mode across all channels, so the first modes of every channel run first and set the bounds early.
+    */
+    uint32_t nGroup = nReference * nChannel;
+    std::vector<LZ4SizeBound*> boundList(nGroup);
+    for(uint32_t g = 0; g < nGroup; ++g)
+      boundList[g] = lvCreateLZ4SizeBound();
+    // mode -> reference -> channel, null for candidates that are not selected
+    std::vector<LZ4CompressionTask*> taskList;
+    taskList.reserve(nGroup * _INTRAPREDICTMODE_ENUM_MAX);
+    for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+    {
+      for(uint32_t r = 0; r < nReference; ++r)
+      {
+        for(uint32_t c = 0; c < nChannel; ++c)
+        {
+          if(!selected[taskList.size()])
+          {
+            taskList.push_back(nullptr);
+            continue;
+          }
+          std::vector<uint8_t> &filtered = m_filtered[r][mode][c];
+          std::vector<char> &compressed = m_compressed[r][mode][c];
+          // the smallest mode of a channel may not fit the budget along with the modes of the other channels,
+          // so it must not abort a larger one through a shared bound
+          if(budget > 0.0)
+            taskList.push_back(lvCreateLZ4CompressionTaskInto(reinterpret_cast<const char*>(filtered.data()), static_cast<int>(filtered.size()),
+              compressed.data(), static_cast<int>(compressed.size()), lvHighCompression, m_searchLevel, false, nullptr, nullptr));
+          else
+            taskList.push_back(lvCreateBoundedLZ4CompressionTaskInto(reinterpret_cast<const char*>(filtered.data()), static_cast<int>(filtered.size()),
+              compressed.data(), static_cast<int>(compressed.size()), lvHighCompression, m_searchLevel, boundList[r * nChannel + c]));
+        }
+      }
+    }
+
+    std::vector<int> sizeList(taskList.size(), 0);
+    for(size_t i = 0; i < taskList.size(); ++i)
+    {
+      if(!taskList[i])
+        continue;
+      sizeList[i] = lvGetLZ4CompressionTaskResultSize(taskList[i]);
+      lvDestroyLZ4CompressionTask(taskList[i]);
+    }
+    for(LZ4SizeBound *bound : boundList)
+      lvDestroyLZ4SizeBound(bound);
+
+    SearchResult best = {};
+    bool found = false;
+    if(budget > 0.0)
+    {
+      for(uint32_t r = 0; r < nReference; ++r)
+        chooseWithinBudget(referenceList, sizeList, r, budget, best, found);
+      if(!found)
+        throw CompressionError("Failed to compress a candidate.");
+      return best;
+    }
+    for(uint32_t r = 0; r < nReference; ++r)
+    {
+      SearchResult result = {};
+      result.referenceIndex = r;
+      result.referenceType = referenceList[r].referenceType;
+      uint32_t nCompressedChannel = 0;
+      for(uint32_t c = 0; c < nChannel; ++c)
+      {
+        // aborted candidates report 0, the smallest one always completes
+        int bestSize = -1;
+        for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+        {
+          int size = sizeList[(mode * nReference + r) * nChannel + c];
+          if(size > 0 && (bestSize < 0 || size < bestSize))
+          {
+            bestSize = size;
+            result.modeList[c] = static_cast<IntraPredictMode>(mode);
+            result.dataList[c] = m_filtered[r][mode][c].data();
+          }
+        }
+        if(bestSize < 0)
+          break;
+        result.compressedSize += static_cast<uint64_t>(bestSize);
+        ++nCompressedChannel;
+      }
+      // references that were not selected have no sizes
+      if(nCompressedChannel < nChannel)
+        continue;
+      result.decodeCost = resultCost(referenceList[r], result.modeList);
+      result.skipMapAllowed = true;
+      if(!found || result.compressedSize < best.compressedSize)
+      {
+        best = result;
+        found = true;
+      }
+    }
+    if(!found)
+      throw CompressionError("Failed to compress a candidate.");
+    return best;
+  }
+
+  void FrameSearch::chooseWithinBudget(const std::vector<SearchReference> &referenceList, const std::vector<int> &sizeList, uint32_t r, double budget,
+    SearchResult &best, bool &found)
+  {
+    uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+    uint32_t nReference = static_cast<uint32_t>(referenceList.size());
+    // every combination of the compressed modes, at most 5^4 of them, walked channel by channel with the cost so far
+    int modeList[maxChannel], bestModeList[maxChannel];
+    uint64_t bestSize = UINT64_MAX;
+    std::function<void(uint32_t, double, uint64_t)> walk = [&](uint32_t c, double cost, uint64_t size)
+    {
+      if(c == nChannel)
+      {
+        if(size < bestSize)
+        {
+          bestSize = size;
+          std::copy(modeList, modeList + nChannel, bestModeList);
+        }
+        return;
+      }
+      for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+      {
+        int candidateSize = sizeList[(mode * nReference + r) * nChannel + c];
+        double candidate = cost + candidateCost(referenceList[r], mode, c);
+        if(candidateSize <= 0 || candidate > budget || size + static_cast<uint64_t>(candidateSize) >= bestSize)
+          continue;
+        modeList[c] = mode;
+        walk(c + 1, candidate, size + static_cast<uint64_t>(candidateSize));
+      }
+    };
+    walk(0, m_frameCost + referenceList[r].restoreCost, 0);
+    if(bestSize == UINT64_MAX || (found && bestSize >= best.compressedSize))
+      return;
+    best = {};
+    best.referenceIndex = r;
+    best.referenceType = referenceList[r].referenceType;
+    best.compressedSize = bestSize;
+    for(uint32_t c = 0; c < nChannel; ++c)
+    {
+      best.modeList[c] = static_cast<IntraPredictMode>(bestModeList[c]);
+      best.dataList[c] = m_filtered[r][bestModeList[c]][c].data();
+    }
+    best.decodeCost = resultCost(referenceList[r], best.modeList);
+    // a skip map decompresses less but defilters its changed blocks one by one, so it may cost more than the channels
+    uint64_t changedList[maxChannel];
+    best.skipMapAllowed = !countChangedSamples(referenceList[r], r, changedList) || skipMapCost(referenceList[r], best.modeList, changedList) <= budget;
+    found = true;
+  }
+
+  bool FrameSearch::applySkipMap(SearchResult &result, const std::vector<SearchReference> &referenceList)
+  {
+    const SearchReference &reference = referenceList[result.referenceIndex];
+    if(m_blockRect.empty() || !result.skipMapAllowed || !reference.planeSet || reference.scale != 0 || reference.moveX != 0 || reference.moveY != 0)
+      return false;
+    const PlaneSet &residual = m_residual[result.referenceIndex];
+    uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+    uint32_t nBlock = static_cast<uint32_t>(m_blockRect[0].size()), nSkipped = 0;
+    uint64_t changedList[maxChannel] = {};
+    m_skipMapData.assign(m_bitmapSize, 0);
+    for(uint32_t b = 0; b < nBlock; ++b)
+    {
+      if(isBlockUnchanged(residual, b))
+      {
+        m_skipMapData[b / 8] |= static_cast<uint8_t>(1 << (b % 8));
+        ++nSkipped;
+        continue;
+      }
+      // a delta frame already dropped in its residual, so blocks filter lossless
+      for(uint32_t c = 0; c < nChannel; ++c)
+      {
+        const BlockRect &rect = m_blockRect[c][b];
+        size_t begin = m_skipMapData.size();
+        for(uint32_t y = rect.y; y < rect.y + rect.height; ++y)
+        {
+          const uint8_t *row = residual[c].data() + static_cast<size_t>(y) * m_planeSizeList[c].width + rect.x;
+          m_skipMapData.insert(m_skipMapData.end(), row, row + rect.width);
+        }
+        if(filterList[result.modeList[c]] && rect.width > 0 && rect.height > 0)
+          filterList[result.modeList[c]](m_skipMapData.data() + begin, static_cast<int>(rect.width), static_cast<int>(rect.height), 0);
+        changedList[c] += static_cast<uint64_t>(rect.width) * rect.height;
+      }
+    }
+    if(nSkipped == 0)
+      return false;
+
+    // the record compresses as a whole while the channels were compressed one by one, close enough to rank them,
+    // a capacity of the planes' size makes a larger record fail early
+    int capacity = static_cast<int>(std::min<uint64_t>(m_skipMapCompressed.size(), result.compressedSize));
+    LZ4CompressionTask *task = lvCreateLZ4CompressionTaskInto(reinterpret_cast<const char*>(m_skipMapData.data()), static_cast<int>(m_skipMapData.size()),
+      m_skipMapCompressed.data(), capacity, lvHighCompression, m_searchLevel, false, nullptr, nullptr);
+    int size = lvGetLZ4CompressionTaskResultSize(task);
+    lvDestroyLZ4CompressionTask(task);
+    if(size <= 0)
+      return false;
+    result.skipBlockSize = m_skipBlockSize;
+    result.skipMapData = m_skipMapData.data();
+    result.skipMapSize = static_cast<uint32_t>(m_skipMapData.size());
+    result.compressedSize = static_cast<uint64_t>(size);
+    result.decodeCost = skipMapCost(reference, result.modeList, changedList);
+    return true;
+  }
+
+  void FrameSearch::applyTiles(SearchResult &result)
+  {
+    if(m_tileRect.empty())
+      return;
+    uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+    uint32_t nTile = static_cast<uint32_t>(m_tileRect[0].size());
+    // the residual of a key frame is the frame itself, which drops inside the intra filter
+    const PlaneSet &residual = m_residual[result.referenceIndex];
+    uint8_t threshold = result.referenceType == NoReference ? m_dropThreshold : 0;
+    m_tileData.assign(static_cast<size_t>(nTile) * nChannel, 0);
+    m_tileEnd.clear();
+    for(uint32_t t = 0; t < nTile; ++t)
+    {
+      for(uint32_t c = 0; c < nChannel; ++c)
+      {
+        const BlockRect &rect = m_tileRect[c][t];
+        IntraPredictMode searched = result.modeList[c];
+        m_tileData[t * nChannel + c] = searched;
+        int size = static_cast<int>(rect.width * rect.height);
+        if(size == 0)
+          continue;
+        copyBlock(residual[c].data(), m_planeSizeList[c].width, rect, m_tilePart.data());
+        // a mode no slower than the searched one keeps the frame within the decode budget
+        int bestEstimate = -1;
+        size_t begin = m_tileData.size();
+        for(int mode = 0; mode < _INTRAPREDICTMODE_ENUM_MAX; ++mode)
+        {
+          if(m_decodeBudget > 0.0f && m_costModel.intraCost[mode] > m_costModel.intraCost[searched])
+            continue;
+          std::copy(m_tilePart.begin(), m_tilePart.begin() + size, m_tileFiltered.begin());
+          if(filterList[mode])
+            filterList[mode](m_tileFiltered.data(), static_cast<int>(rect.width), static_cast<int>(rect.height), threshold);
+          int estimate = lvEstimateLZ4Size(m_tileFiltered.data(), size);
+          if(bestEstimate < 0 || estimate < bestEstimate || (estimate == bestEstimate && mode == searched))
+          {
+            bestEstimate = estimate;
+            m_tileData[t * nChannel + c] = static_cast<uint8_t>(mode);
+            m_tileData.resize(begin);
+            m_tileData.insert(m_tileData.end(), m_tileFiltered.begin(), m_tileFiltered.begin() + size);
+          }
+        }
+      }
+      m_tileEnd.push_back(static_cast<uint32_t>(m_tileData.size()));
+    }
+    result.tileData = m_tileData.data();
+    result.tileEndList = m_tileEnd.data();
+    result.nTile = nTile;
+  }
+
+  void FrameSearch::reconstruct(const SearchResult &result, const PlaneSet &curr, const std::vector<SearchReference> &referenceList, PlaneSet &out)
+  {
+    const PlaneSet *ref = referenceList[result.referenceIndex].planeSet;
+    lveAssert(ref != &out);
+    for(uint32_t c = 0; c < m_planeSizeList.size(); ++c)
+    {
+      const PlaneSize &s = m_planeSizeList[c];
+      std::vector<uint8_t> &plane = out[c];
+      // the residual is computed again, the same as searched, to get the reconstruction in the same pass
+      if(ref)
+        lvComputeResidual8(curr[c].data(), (*ref)[c].data(), m_residual[result.referenceIndex][c].data(), plane.data(), static_cast<int64_t>(plane.size()), m_dropThreshold);
+      else if(m_dropThreshold == 0 || (!result.tileData && !defilterList[result.modeList[c]]))
+        std::copy(curr[c].begin(), curr[c].end(), plane.begin());
+      else if(result.tileData)
+      {
+        uint32_t nChannel = static_cast<uint32_t>(m_planeSizeList.size());
+        const uint8_t *tile = result.tileData + result.nTile * nChannel;
+        for(uint32_t t = 0; t < result.nTile; ++t)
+        {
+          // the channel part of tile t follows the parts of the channels before it
+          const uint8_t *part = tile;
+          for(uint32_t i = 0; i < c; ++i)
+            part += m_tileRect[i][t].width * m_tileRect[i][t].height;
+          const BlockRect &rect = m_tileRect[c][t];
+          IntraPredictMode mode = static_cast<IntraPredictMode>(result.tileData[t * nChannel + c]);
+          std::copy(part, part + rect.width * rect.height, m_tilePart.begin());
+          if(defilterList[mode] && rect.width > 0 && rect.height > 0)
+            defilterList[mode](m_tilePart.data(), static_cast<int>(rect.width), static_cast<int>(rect.height), 1);
+          for(uint32_t y = 0; y < rect.height; ++y)
+            std::copy(m_tilePart.begin() + static_cast<size_t>(y) * rect.width, m_tilePart.begin() + static_cast<size_t>(y + 1) * rect.width,
+              plane.begin() + static_cast<size_t>(rect.y + y) * s.width + rect.x);
+          tile = result.tileData + result.tileEndList[t];
+        }
+      }
+      else
+      {
+        // lossy intra filters predict from what is reconstructed, so only defiltering gives the decoded planes
+        std::copy(result.dataList[c], result.dataList[c] + plane.size(), plane.begin());
+        defilterList[result.modeList[c]](plane.data(), static_cast<int>(s.width), static_cast<int>(s.height), 1);
+      }
+    }
+  }
+
+  bool isRepeatFrame(const PlaneSet &curr, const PlaneSet &prev, uint8_t dropThreshold)
+  {
+    for(size_t c = 0; c < curr.size(); ++c)
+    {
+      const std::vector<uint8_t> &a = curr[c], &b = prev[c];
+      if(dropThreshold == 0)
+      {
+        if(a != b)
+          return false;
+        continue;
+      }
+      for(size_t i = 0; i < a.size(); ++i)
+      {
+        int delta = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+        if((a[i] < dropThreshold && b[i] > dropThreshold) || std::abs(delta) > dropThreshold)
+          return false;
+      }
+    }
+    return true;
+  }
+} // namespace LightVideoEncoder
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "plane_p.hpp"
+#include "../encoder.hpp"
+#include <vector>
+
+namespace LightVideoEncoder
+{
+  struct SearchReference
+  {
+    ReferenceType referenceType;
+    const PlaneSet *planeSet; // null for NoReference, already warped by the global motion
+    int16_t scale, moveX, moveY; // global motion written to the frame, in samples of the full size channels
+    double restoreCost; // modeled decode time of the key frame a LongTermReference slot is restored from after a seek, 0 for the others
+  };
+
+  struct SearchResult
+  {
+    uint32_t referenceIndex; // into the reference list given to FrameSearch::search()
+    ReferenceType referenceType;
+    IntraPredictMode modeList[maxChannel];
+    const uint8_t *dataList[maxChannel]; // filtered channels, valid until the next search
+    uint64_t compressedSize; // sum of the channel sizes at the search level
+    double decodeCost; // modeled decode time of the record, along with the restore of its slot
+    bool skipMapAllowed; // false if a skip map would take the record over the decode budget
+    // set by FrameSearch::applySkipMap(), the record data then is skipMapData instead of the channels
+    SkipBlockSize skipBlockSize;
+    const uint8_t *skipMapData;
+    uint32_t skipMapSize;
+    // set by FrameSearch::applyTiles(), the record data then is tileData instead of the channels, tile t ends at tileEndList[t] in it
+    const uint8_t *tileData;
+    const uint32_t *tileEndList;
+    uint32_t nTile;
+  };
+
+  struct BlockRect
+  {
+    uint32_t x, y, width, height;
+  };
+
+  /*
+    Tries every intra mode on every channel against every reference and keeps the reference with the smallest sum of channel sizes.
+    A candidate is ranked by its own LZ4 HC size, all candidates of a frame are compressed concurrently and losing ones abort early.
+    With a prune margin, references are ranked by lvResidualStats8() first and those clearly losing are not filtered at all.
+    With a candidate count, candidates are ranked by lvEstimateLZ4Size() first and only the best intra modes of every channel
+    of the best references are compressed.
+    With a decode budget, references whose cheapest candidate is over it are not searched, counting the restore of a long-term slot, candidates that can't fit it along with the
+    cheapest modes of the other channels are not compressed, and the cheapest mode of every channel always is. Candidates then compress
+    without a shared bound, since a larger one may be the only one within the budget.
+    A delta result can then leave out the blocks whose residual is all zero, with each changed block filtered on its own,
+    unless the cost of defiltering the blocks one by one takes it over the budget.
+    Tiled streams filter every tile on its own instead, with the mode that estimates smallest among those no slower than the searched one.
+    Work buffers are kept across frames.
+  */
+  class FrameSearch final
+  {
+  public:
+    FrameSearch(const std::vector<PlaneSize> &planeSizeList, int searchLevel, uint32_t candidateCount, float pruneMargin, uint8_t dropThreshold,
+      const DecodeCostModel &costModel, float decodeBudget, SkipBlockSize skipBlockSize, uint16_t tileWidth, uint16_t tileHeight);
+
+    SearchResult search(const PlaneSet &curr, const std::vector<SearchReference> &referenceList);
+    /*
+      Turns a delta result into a skip map record if any block is unchanged and the record compresses to at most its size.
+      Blocks are taken from the reference in place, so references warped by a global motion keep their planes. Returns true if applied.
+    */
+    bool applySkipMap(SearchResult &result, const std::vector<SearchReference> &referenceList);
+    // turns result into a tiled record laid out like TileLayout of fastdecoder, does nothing for untiled streams
+    void applyTiles(SearchResult &result);
+    // the planes the decoder reconstructs from result, out must not be a reference of it
+    void reconstruct(const SearchResult &result, const PlaneSet &curr, const std::vector<SearchReference> &referenceList, PlaneSet &out);
+
+  private:
+    void prepareReference(uint32_t iReference);
+    // active[r] is cleared for the references whose residual costs more than pruneMargin above the cheapest one
+    void pruneReferences(const PlaneSet &curr, const std::vector<SearchReference> &referenceList, std::vector<bool> &active);
+    // selected[(mode * nReference + r) * nChannel + c] is set for the feasible candidates worth compressing, indexed the same way
+    void selectCandidates(const std::vector<bool> &active, const std::vector<bool> &feasible, std::vector<bool> &selected);
+    // modeled decode time of channel c filtered by mode against reference, in nanoseconds
+    double candidateCost(const SearchReference &reference, int mode, uint32_t c) const;
+    // the decode time of the cheapest candidate of every channel, along with the restore of the slot
+    double minimumCost(const SearchReference &reference) const;
+    // modeled decode time of the channels of reference filtered by modeList, along with the restore of the slot
+    double resultCost(const SearchReference &reference, const IntraPredictMode *modeList) const;
+    // true if block b of every channel of residual is all zero
+    bool isBlockUnchanged(const PlaneSet &residual, uint32_t b) const;
+    // counts the samples per channel of the blocks of reference r with a changed residual, false if no block would be left out
+    bool countChangedSamples(const SearchReference &reference, uint32_t r, uint64_t *changedList) const;
+    // modeled decode time of a skip map record of reference filtered by modeList with changedList samples per channel left in
+    double skipMapCost(const SearchReference &reference, const IntraPredictMode *modeList, const uint64_t *changedList) const;
+    // clears active[r] for the references over budget and returns the budget the frame is held to, raised to the cheapest reference if none fits
+    double budgetReferences(const std::vector<SearchReference> &referenceList, std::vector<bool> &active) const;
+    // clears feasible for the candidates that can't fit budget along with the cheapest modes of the other channels
+    void budgetCandidates(const std::vector<SearchReference> &referenceList, double budget, std::vector<bool> &feasible) const;
+    // selects the cheapest mode of every channel of the references with any candidate selected, so a combination within budget is compressed
+    void selectCheapest(const std::vector<SearchReference> &referenceList, std::vector<bool> &selected) const;
+    // replaces best by the smallest combination of the compressed modes of reference r within budget, if it is smaller
+    void chooseWithinBudget(const std::vector<SearchReference> &referenceList, const std::vector<int> &sizeList, uint32_t r, double budget,
+      SearchResult &best, bool &found);
+
+    std::vector<PlaneSize> m_planeSizeList;
+    int m_searchLevel;
+    uint32_t m_candidateCount;
+    float m_pruneMargin;
+    uint8_t m_dropThreshold;
+    DecodeCostModel m_costModel;
+    float m_decodeBudget;
+    double m_frameCost; // decompressing the record, the same for every candidate
+    SkipBlockSize m_skipBlockSize;
+    std::vector<std::vector<BlockRect>> m_blockRect; // channel -> block, laid out like the tiles of fastdecoder
+    std::vector<std::vector<BlockRect>> m_tileRect; // channel -> tile, empty for untiled streams
+    uint32_t m_bitmapSize;
+    std::vector<uint8_t> m_skipMapData; // bitmap, then the changed blocks
+    std::vector<char> m_skipMapCompressed;
+    std::vector<uint8_t> m_tileData; // mode table, then the tiles
+    std::vector<uint32_t> m_tileEnd;
+    std::vector<uint8_t> m_tilePart, m_tileFiltered;
+    std::vector<PlaneSet> m_residual; // reference -> channel
+    std::vector<std::vector<PlaneSet>> m_filtered; // reference -> mode -> channel
+    std::vector<std::vector<std::vector<std::vector<char>>>> m_compressed; // reference -> mode -> channel, only the size is used
+  };
+
+  // true if every residual against prev is dropped by the rule of lvComputeResidual8(), so the frame decodes to prev
+  bool isRepeatFrame(const PlaneSet &curr, const PlaneSet &prev, uint8_t dropThreshold);
+} // namespace LightVideoEncoder
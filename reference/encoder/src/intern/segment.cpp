@@ -0,0 +1,189 @@
+#include "../segment.hpp"
+#include "../error.hpp"
+#include "util_p.hpp"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstring>
+
+namespace LightVideoEncoder
+{
+  namespace
+  {
+    // a stream kept in memory until it is its turn to be written
+    struct MemoryStream
+    {
+      std::vector<char> data;
+      size_t pos = 0;
+
+      void write(const char *src, int64_t size)
+      {
+        if(pos + size > data.size())
+          data.resize(pos + size);
+        memcpy(data.data() + pos, src, static_cast<size_t>(size));
+        pos += static_cast<size_t>(size);
+      }
+    };
+
+    void addStats(EncoderStats &total, const EncoderStats &stats)
+    {
+      total.frameCount += stats.frameCount;
+      total.keyFrameCount += stats.keyFrameCount;
+      total.repeatFrameCount += stats.repeatFrameCount;
+      total.packetCount += stats.packetCount;
+      total.rawBytes += stats.rawBytes;
+      total.writtenBytes += stats.writtenBytes - sizeof(MainStruct);
+    }
+
+    bool isSameFormat(MainStruct a, MainStruct b)
+    {
+      a.nFrame = b.nFrame = 0;
+      return memcmp(&a, &b, sizeof(MainStruct)) == 0;
+    }
+  } // namespace
+
+  EncoderStats encodeSegmented(Encoder::WriteFunc writeFunc, const EncoderConfig &config, uint32_t nFrame, uint32_t segmentLength, uint32_t nThread,
+    SegmentFeedFunc feedFunc)
+  {
+    lveAssert(writeFunc && feedFunc);
+    if(nFrame == 0 || segmentLength == 0)
+      throw ConfigError("nFrame and segmentLength must be greater than 0.");
+    uint32_t nSegment = (nFrame - 1) / segmentLength + 1;
+    if(nThread == 0)
+      nThread = std::max(1U, std::thread::hardware_concurrency());
+    nThread = std::min(nThread, nSegment);
+
+    EncoderStats total = {0, 0, 0, 0, 0, sizeof(MainStruct)};
+    std::atomic<uint32_t> nextSegment(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex lock;
+    std::condition_variable written;
+    uint32_t nextWrite = 0;
+    auto fail = [&](std::exception_ptr e)
+    {
+      std::unique_lock<std::mutex> locker(lock);
+      if(!error)
+        error = e;
+      failed = true;
+      written.notify_all();
+    };
+
+    // segments are taken in order, so the one a thread waits to write after is always in progress on another thread
+    auto run = [&]()
+    {
+      for(uint32_t s = nextSegment++; s < nSegment && !failed; s = nextSegment++)
+      {
+        MemoryStream out;
+        EncoderStats stats;
+        try
+        {
+          Encoder encoder([&out](const char *data, int64_t size) { out.write(data, size); }, [&out](int64_t pos) { out.pos = static_cast<size_t>(pos); }, config);
+          uint32_t begin = s * segmentLength, end = begin + std::min(segmentLength, nFrame - begin);
+          for(uint32_t f = begin; f < end && !failed; ++f)
+            feedFunc(f, encoder);
+          if(failed)
+            return;
+          encoder.finish();
+          stats = encoder.stats();
+        }
+        catch(...)
+        {
+          fail(std::current_exception());
+          return;
+        }
+
+        std::unique_lock<std::mutex> locker(lock);
+        written.wait(locker, [&]() { return nextWrite == s || failed; });
+        if(failed)
+          return;
+        try
+        {
+          // the first segment brings the main structure, it only lacks the total frame count
+          if(s == 0)
+          {
+            MainStruct mainStruct;
+            memcpy(&mainStruct, out.data.data(), sizeof(MainStruct));
+            mainStruct.nFrame = nFrame;
+            writeFunc(reinterpret_cast<const char*>(&mainStruct), sizeof(MainStruct));
+          }
+          writeFunc(out.data.data() + sizeof(MainStruct), static_cast<int64_t>(out.data.size() - sizeof(MainStruct)));
+        }
+        catch(...)
+        {
+          // the lock is held, so fail() can't be called, an encoder may already have failed before the write got its turn
+          if(!error)
+            error = std::current_exception();
+          failed = true;
+          written.notify_all();
+          return;
+        }
+        addStats(total, stats);
+        ++nextWrite;
+        written.notify_all();
+      }
+    };
+
+    std::vector<std::thread> threadList;
+    for(uint32_t i = 1; i < nThread; ++i)
+      threadList.emplace_back(run);
+    run();
+    for(std::thread &thread : threadList)
+      thread.join();
+    if(error)
+      std::rethrow_exception(error);
+    return total;
+  }
+
+  uint64_t concatStreams(Encoder::WriteFunc writeFunc, const std::vector<StreamSource> &sourceList)
+  {
+    lveAssert(writeFunc && !sourceList.empty());
+    std::vector<MainStruct> mainList(sourceList.size());
+    uint64_t nFrame = 0;
+    for(size_t i = 0; i < sourceList.size(); ++i)
+    {
+      const StreamSource &source = sourceList[i];
+      lveAssert(source.read && source.seek);
+      source.seek(0);
+      source.read(reinterpret_cast<char*>(&mainList[i]), sizeof(MainStruct));
+      if(memcmp(mainList[i].aria, "ARiA", 4) != 0)
+        throw IOError("Invalid stream.");
+      if(!isSameFormat(mainList[i], mainList[0]))
+        throw ConfigError("Streams have different formats.");
+      nFrame += mainList[i].nFrame;
+    }
+    if(nFrame > UINT32_MAX)
+      throw ConfigError("Too many frames.");
+
+    MainStruct mainStruct = mainList[0];
+    mainStruct.nFrame = static_cast<uint32_t>(nFrame);
+    writeFunc(reinterpret_cast<const char*>(&mainStruct), sizeof(MainStruct));
+    uint64_t writtenBytes = sizeof(MainStruct);
+
+    // packets are walked like the decoder indexes them, anything after the last frame is left out
+    std::vector<char> packet;
+    for(size_t i = 0; i < sourceList.size(); ++i)
+    {
+      const StreamSource &source = sourceList[i];
+      int64_t offset = sizeof(MainStruct);
+      for(uint32_t n = 0; n < mainList[i].nFrame;)
+      {
+        VideoFramePacket vfpk;
+        source.seek(offset);
+        source.read(reinterpret_cast<char*>(&vfpk), sizeof(VideoFramePacket));
+        if(memcmp(vfpk.vfpk, "VFPK", 4) != 0 || vfpk.nFrame == 0)
+          throw IOError("Invalid packet.");
+        packet.resize(sizeof(VideoFramePacket) + vfpk.size);
+        memcpy(packet.data(), &vfpk, sizeof(VideoFramePacket));
+        source.read(packet.data() + sizeof(VideoFramePacket), vfpk.size);
+        writeFunc(packet.data(), static_cast<int64_t>(packet.size()));
+        writtenBytes += packet.size();
+        offset += static_cast<int64_t>(packet.size());
+        n += vfpk.nFrame;
+      }
+    }
+    return writtenBytes;
+  }
+} // namespace LightVideoEncoder
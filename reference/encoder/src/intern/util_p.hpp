@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#define _lv_S(a) _lv__S(a)
+#define _lv__S(a) #a
+
+#define lveAssert(a, ...) \
+        (void)((!(a)) ?  ( \
+            ( \
+            fprintf(stderr, \
+                "lveAssert failed: %s:%d, %s(), at \'%s\' " __VA_ARGS__ "\n", \
+                __FILE__, __LINE__, __func__, _lv_S(a)), \
+            std::abort(), \
+            NULL)) : NULL)
+
+namespace LightVideoEncoder
+{
+  template<typename T>static inline T clip(T min, T v, T max)
+  { return std::min(std::max(min, v), max); }
+} // namespace LightVideoEncoder
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "encoder.hpp"
+#include <vector>
+
+namespace LightVideoEncoder
+{
+  // feeds frame frameNumber into encoder with Encoder::feedFrame() or Encoder::feedFrameRGB(), called concurrently from the segment threads
+  typedef std::function<void(uint32_t frameNumber, Encoder &encoder)> SegmentFeedFunc;
+
+  /*
+    Encodes nFrame frames in segments of segmentLength frames, every segment on a thread of its own with an encoder of its own.
+    A segment starts with a key frame and no frame references one of an earlier segment, so the packets of all segments
+    simply follow each other under one main structure. Segments are written in order as soon as the ones before them are,
+    at most nThread of them are held in memory. nThread 0 uses the hardware concurrency.
+    The main structure is written once with the final frame count, so no seek is needed. Returns the stats summed over the segments.
+  */
+  EncoderStats encodeSegmented(Encoder::WriteFunc writeFunc, const EncoderConfig &config, uint32_t nFrame, uint32_t segmentLength, uint32_t nThread,
+    SegmentFeedFunc feedFunc);
+
+  struct StreamSource
+  {
+    std::function<void(char*, int64_t)> read;
+    std::function<void(int64_t)> seek;
+  };
+
+  /*
+    Concatenates complete streams written by Encoder, for segments encoded by separate processes.
+    Every stream has to have the same format, the packets are copied as they are and nFrame of the result is their sum.
+    Returns the bytes written.
+  */
+  uint64_t concatStreams(Encoder::WriteFunc writeFunc, const std::vector<StreamSource> &sourceList);
+} // namespace LightVideoEncoder
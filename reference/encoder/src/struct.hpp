@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+  Stream structures as read by fastdecoder, see fastdecoder/src/struct.hpp.
+  Both copies have to be changed together.
+*/
+namespace LightVideoEncoder
+{
+  enum CompressionMethod : uint8_t
+  {
+    NoCompression = 0x0,
+    LZ4Compression,
+    ChunkedLZ4Compression,
+    _COMPRESSION_ENUM_MAX,
+  };
+
+  enum IntraPredictMode : uint8_t
+  {
+    NoIntraPredict = 0x0,
+    SubTop,
+    SubLeft,
+    SubAvg,
+    SubPaeth,
+    _INTRAPREDICTMODE_ENUM_MAX
+  };
+
+  enum ReferenceType : uint8_t
+  {
+    NoReference = 0x0,
+    PreviousFullReference,
+    PreviousReference,
+    RepeatPreviousReference,
+    LongTermReference,
+    _REFERENCETYPE_ENUM_MAX
+  };
+
+  enum SkipBlockSize : uint8_t
+  {
+    NoSkipMap = 0x0,
+    SkipBlock16,
+    SkipBlock32,
+    _SKIPBLOCKSIZE_ENUM_MAX
+  };
+
+  enum ColorFormat : uint8_t
+  {
+    YUV420P = 0x0,
+    YUVA420P,
+    _COLORFORMAT_ENUM_MAX
+  };
+
+  struct MainStruct
+  {
+    char aria[4];
+    uint8_t version;
+    ColorFormat colorFormat;
+    uint8_t framerate;
+    uint8_t maxPacketSize;
+    uint8_t nLongTermSlot;
+    char _reserved_1[3];
+    uint16_t tileWidth, tileHeight;
+    uint32_t width, height;
+    uint32_t nFrame;
+    char _reserved_2[4];
+  };
+
+  struct VideoFramePacket
+  {
+    char vfpk[4];
+    uint8_t nFrame, nFullFrame;
+    CompressionMethod compressionMethod;
+    uint8_t storeSlotMask;
+    uint32_t size;
+    uint32_t checksum; // adler32 of the payload
+  };
+
+  struct VideoFrameStruct
+  {
+    char vfrm[4];
+    ReferenceType referenceType;
+    SkipBlockSize skipBlockSize;
+    uint8_t referenceSlot, storeSlotMask;
+    int16_t scale, moveX, moveY; // global motion of the reference, half size channels take half of it
+    IntraPredictMode intraPredictModeList[8];
+    char _reserved_1[10];
+  };
+
+  struct LZ4ChunkEntry
+  {
+    uint32_t uncompressedEnd, compressedEnd;
+  };
+
+  constexpr uint32_t minChunkSize = 4096;
+
+  constexpr uint32_t maxLongTermSlot = 4;
+
+  static_assert(sizeof(MainStruct) == 32, "MainStruct layout changed.");
+  static_assert(sizeof(VideoFramePacket) == 16, "VideoFramePacket layout changed.");
+  static_assert(sizeof(VideoFrameStruct) == 32, "VideoFrameStruct layout changed.");
+} // namespace LightVideoEncoder
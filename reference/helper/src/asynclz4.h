@@ -9,13 +9,54 @@ extern "C"
 #endif // __cplusplus
 
   struct LZ4CompressionTask;
+  struct LZ4SizeBound;
   enum LZ4CompressionMode
   {
     lvFastCompression = 0x0,
     lvHighCompression
   };
+  /*
+    Called on a worker thread when a task is done, before lvWaitLZ4CompressionTask() reports it finished.
+    compressedSize is 0 if compression failed or the result doesn't fit dst.
+  */
+  typedef void (*LZ4CompressionCallback)(void *userData, int compressedSize, uint32_t adler32);
 
   LIGHTVIDEO_EXPORT LZ4CompressionTask *lvCreateLZ4CompressionTask(const char *src, int srcSize, int mode, int level, bool calcAdler32);
+  /*
+    Compresses src as a ChunkedLZ4Compression payload, chunkSize bytes per chunk (at least 4096, the last chunk may be shorter).
+    Chunks are compressed in parallel, the result is read with the same functions as a plain task.
+  */
+  LIGHTVIDEO_EXPORT LZ4CompressionTask *lvCreateChunkedLZ4CompressionTask(const char *src, int srcSize, int chunkSize, int mode, int level, bool calcAdler32);
+  /*
+    Zero-copy variants, src and dst are borrowed until the task is finished and must stay valid and untouched until then.
+    The result is written straight to dst, a dstCapacity below lvGetLZ4CompressBound() or lvGetChunkedLZ4CompressBound() makes the task fail
+    with size 0 when the result doesn't fit. callback may be null, the task is then polled with lvWaitLZ4CompressionTask().
+    The task still has to be destroyed.
+  */
+  LIGHTVIDEO_EXPORT LZ4CompressionTask *lvCreateLZ4CompressionTaskInto(const char *src, int srcSize, char *dst, int dstCapacity, int mode, int level,
+    bool calcAdler32, LZ4CompressionCallback callback, void *userData);
+  LIGHTVIDEO_EXPORT LZ4CompressionTask *lvCreateChunkedLZ4CompressionTaskInto(const char *src, int srcSize, int chunkSize, char *dst, int dstCapacity,
+    int mode, int level, bool calcAdler32, LZ4CompressionCallback callback, void *userData);
+  /*
+    Like lvCreateChunkedLZ4CompressionTaskInto() but chunk i ends at chunkEndList[i], so chunks can follow the layout of the data.
+    The source size is the last end, every chunk but the last one must hold at least 4096 bytes.
+  */
+  LIGHTVIDEO_EXPORT LZ4CompressionTask *lvCreateChunkedLZ4CompressionTaskByEndsInto(const char *src, const int *chunkEndList, int nChunk,
+    char *dst, int dstCapacity, int mode, int level, bool calcAdler32, LZ4CompressionCallback callback, void *userData);
+  /*
+    Tasks competing for the smallest result share a size bound, it holds the smallest size any of them reached so far.
+    A bounded task caps dst at the bound when it starts, so a candidate that can't beat an earlier one aborts as soon as its output
+    outgrows it and reports size 0. A result equal to the bound still fits, so the smallest candidate always completes.
+    The bound must outlive its tasks.
+  */
+  LIGHTVIDEO_EXPORT LZ4SizeBound *lvCreateLZ4SizeBound();
+  LIGHTVIDEO_EXPORT int lvGetLZ4SizeBound(LZ4SizeBound *bound);
+  LIGHTVIDEO_EXPORT void lvDestroyLZ4SizeBound(LZ4SizeBound *bound);
+  LIGHTVIDEO_EXPORT LZ4CompressionTask *lvCreateBoundedLZ4CompressionTaskInto(const char *src, int srcSize, char *dst, int dstCapacity, int mode, int level,
+    LZ4SizeBound *bound);
+  LIGHTVIDEO_EXPORT int lvGetLZ4CompressBound(int srcSize);
+  LIGHTVIDEO_EXPORT int lvGetChunkedLZ4CompressBound(int srcSize, int chunkSize);
+  LIGHTVIDEO_EXPORT int lvGetChunkedLZ4CompressBoundByEnds(const int *chunkEndList, int nChunk);
   LIGHTVIDEO_EXPORT int lvWaitLZ4CompressionTask(LZ4CompressionTask *task, int msec);
   LIGHTVIDEO_EXPORT int lvGetLZ4CompressionTaskResultSize(LZ4CompressionTask *task);
   LIGHTVIDEO_EXPORT void lvGetLZ4CompressionTaskResultData(LZ4CompressionTask *task, char *dst, int dstCapacity);
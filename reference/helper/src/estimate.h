@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+* Compressibility estimation
+*/
+
+#include "publicutil.h"
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+  /*
+    Approximate LZ4 compressed size of data in one pass, meant to rank filter candidates before compressing only the best ones.
+    Zero runs are taken as single matches, other matches are found at sampled positions with a small hash table,
+    and the literals left over are weighted by the byte entropy, since LZ4 HC finds more matches in low entropy data than the sampling does.
+    Only the order of estimates of equally sized buffers is meaningful.
+  */
+  LIGHTVIDEO_EXPORT int lvEstimateLZ4Size(const uint8_t *data, int size);
+#ifdef __cplusplus
+} // extern "C"
+#endif // __cplusplus
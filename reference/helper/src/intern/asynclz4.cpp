@@ -1,27 +1,64 @@
 #include "..\asynclz4.h"
 #include "privateutil.hpp"
-#include <future>
+#include "taskpool.hpp"
 #include <chrono>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstring>
+#include <limits>
 #include "lz4.h"
 #include "lz4hc.h"
+#include "struct.hpp"
 
 using namespace LightVideo;
 
-struct LZ4CompressionResult
+constexpr static int minLZ4ChunkSize = 4096;
+
+struct LZ4SizeBound
 {
-  char *compressedData;
-  int compressedSize;
-  uint32_t adler32;
+  std::atomic<int> size;
 };
 
+/*
+  Tasks run as jobs of the global task pool, a chunked task runs one job per chunk and the job that finishes last assembles the payload.
+  Copying tasks take their source copy and result from the global buffer pool, borrowing tasks use the buffers of the caller.
+*/
 struct LZ4CompressionTask
 {
-  LZ4CompressionResult resultCache;
-  std::future<LZ4CompressionResult> future;
-  bool cacheValid, calcAdler32;
+  const char *src;
+  char *ownedSrc; // null when borrowed
+  size_t srcCapacity;
+  int srcSize;
+  int mode, level;
+  bool calcAdler32;
+  LZ4CompressionCallback callback;
+  void *userData;
+  LZ4SizeBound *sizeBound;
+
+  // chunked tasks, chunk i ends at chunkEndList[i] in src and is compressed to chunkData + chunkOffsetList[i], empty for plain tasks
+  std::vector<int> chunkEndList;
+  std::vector<size_t> chunkOffsetList;
+  char *chunkData;
+  size_t chunkDataCapacity;
+  std::vector<int> chunkSizeList;
+  std::atomic<int> nPendingChunk;
+
+  // result, compressedCapacity is 0 when compressedData is borrowed
+  char *compressedData;
+  size_t compressedCapacity;
+  int maxCompressedSize;
+  int compressedSize;
+  uint32_t adler32;
+  std::atomic<int> status;
 };
 
+// completion of every task is signalled here, tasks are too many and too short for a condition variable each
+static std::mutex g_taskDoneLock;
+static std::condition_variable g_taskDone;
+
 static inline void doAder_16(const uint8_t *data, uint_fast32_t &a, uint_fast32_t &b)
 {
   a += data[0]; b += a;
@@ -108,69 +145,385 @@ static uint32_t doCalcAdler32(const uint8_t *data, int dataSize)
   return a + b * 65536;
 }
 
-static LZ4CompressionResult compressCore(char *src, int srcSize, int mode, int level, bool calcAdler32)
+static int compressBlock(WorkerContext &context, const char *src, int srcSize, char *dest, int maxDestSize, int mode, int level)
 {
-  int maxDestSize = LZ4_compressBound(srcSize);
-  char *dest = GUARDED_ALLOC(char, maxDestSize);
-  int compressedSize;
   if(mode == lvFastCompression)
-    compressedSize = LZ4_compress_fast(src, dest, srcSize, maxDestSize, level);
+    return LZ4_compress_fast_extState(context.lz4State, src, dest, srcSize, maxDestSize, level);
   else
-    compressedSize = LZ4_compress_HC(src, dest, srcSize, maxDestSize, level);
-  lvFree(src);
+    return LZ4_compress_HC_extStateHC(context.lz4HCState, src, dest, srcSize, maxDestSize, level);
+}
 
-  uint32_t checksum = 0;
-  if(calcAdler32)
-    checksum = doCalcAdler32(reinterpret_cast<uint8_t*>(dest), compressedSize);
+static void finishTask(LZ4CompressionTask *task)
+{
+  if(task->ownedSrc)
+    globalBufferPool().release(task->ownedSrc, task->srcCapacity);
+  task->src = task->ownedSrc = nullptr;
+  if(task->calcAdler32)
+    task->adler32 = doCalcAdler32(reinterpret_cast<uint8_t*>(task->compressedData), task->compressedSize);
+  // the callback returns before the task is finished, so the caller may destroy it as soon as it sees lvFinished
+  if(task->callback)
+    task->callback(task->userData, task->compressedSize, task->adler32);
+  std::unique_lock<std::mutex> locker(g_taskDoneLock);
+  task->status = lvFinished;
+  g_taskDone.notify_all();
+}
 
-  return {
-    dest,
-    compressedSize,
-    checksum
-  };
+static void compressJob(void *arg, uint32_t, WorkerContext &context)
+{
+  LZ4CompressionTask *task = reinterpret_cast<LZ4CompressionTask*>(arg);
+  task->status = lvRunning;
+  int maxDestSize = task->maxCompressedSize;
+  if(task->sizeBound)
+    maxDestSize = std::min(maxDestSize, task->sizeBound->size.load());
+  task->compressedSize = compressBlock(context, task->src, task->srcSize, task->compressedData, maxDestSize, task->mode, task->level);
+  if(task->sizeBound && task->compressedSize > 0)
+  {
+    int size = task->sizeBound->size.load();
+    while(task->compressedSize < size && !task->sizeBound->size.compare_exchange_weak(size, task->compressedSize));
+  }
+  finishTask(task);
 }
 
-static void ensureCache(LZ4CompressionTask *task)
+static void assembleChunks(LZ4CompressionTask *task)
 {
-  if(!task->cacheValid)
+  int nChunk = static_cast<int>(task->chunkSizeList.size());
+  bool failed = false;
+  int compressedSize = static_cast<int>(sizeof(uint32_t) + sizeof(LZ4ChunkEntry) * nChunk);
+  for(int i = 0; i < nChunk; ++i)
+  {
+    failed = failed || task->chunkSizeList[i] <= 0;
+    compressedSize += task->chunkSizeList[i];
+  }
+
+  // a failed task keeps a buffer like a plain task does and reports size 0
+  if(!task->compressedData)
   {
-    task->resultCache = task->future.get();
-    task->cacheValid = true;
+    task->compressedData = globalBufferPool().acquire(failed ? 1 : compressedSize, task->compressedCapacity);
+    task->maxCompressedSize = compressedSize;
   }
+  char *dest = task->compressedData;
+  if(failed || compressedSize > task->maxCompressedSize)
+    compressedSize = 0;
+  else
+  {
+    uint32_t n = static_cast<uint32_t>(nChunk);
+    memcpy(dest, &n, sizeof(n));
+    LZ4ChunkEntry *table = reinterpret_cast<LZ4ChunkEntry*>(dest + sizeof(n));
+    char *p = dest + sizeof(n) + sizeof(LZ4ChunkEntry) * nChunk;
+    uint32_t compressedEnd = 0;
+    for(int i = 0; i < nChunk; ++i)
+    {
+      memcpy(p, task->chunkData + task->chunkOffsetList[i], task->chunkSizeList[i]);
+      p += task->chunkSizeList[i];
+      compressedEnd += task->chunkSizeList[i];
+      table[i].uncompressedEnd = static_cast<uint32_t>(task->chunkEndList[i]);
+      table[i].compressedEnd = compressedEnd;
+    }
+  }
+  globalBufferPool().release(task->chunkData, task->chunkDataCapacity);
+  task->chunkData = nullptr;
+  task->compressedSize = compressedSize;
+  finishTask(task);
 }
 
-LZ4CompressionTask *lvCreateLZ4CompressionTask(const char *src, int srcSize, int mode, int level, bool calcAdler32)
+static void compressChunkJob(void *arg, uint32_t index, WorkerContext &context)
+{
+  LZ4CompressionTask *task = reinterpret_cast<LZ4CompressionTask*>(arg);
+  task->status = lvRunning;
+  int begin = index ? task->chunkEndList[index - 1] : 0;
+  int bound = static_cast<int>(task->chunkOffsetList[index + 1] - task->chunkOffsetList[index]);
+  task->chunkSizeList[index] = compressBlock(context, task->src + begin, task->chunkEndList[index] - begin, task->chunkData + task->chunkOffsetList[index],
+    bound, task->mode, task->level);
+  if(--task->nPendingChunk == 0)
+    assembleChunks(task);
+}
+
+static bool checkTaskArguments(const char *src, int srcSize, int mode, int level)
 {
   if(!src)
   {
     fatal("Invalid src.");
-    return nullptr;
+    return false;
   }
 
   if(srcSize <= 0)
   {
     fatal("srcSize must be greater than 0");
-    return nullptr;
+    return false;
   }
 
   if(mode != lvFastCompression && mode != lvHighCompression)
   {
     fatal("Invalid mode.");
-    return nullptr;
+    return false;
   }
 
   if(level < 0)
   {
     fatal("Invalid level.");
-    return nullptr;
+    return false;
+  }
+  return true;
+}
+
+// every chunk but the last one must hold at least minLZ4ChunkSize bytes
+static bool checkChunkEndList(const int *chunkEndList, int nChunk)
+{
+  if(!chunkEndList || nChunk <= 0)
+  {
+    fatal("Invalid chunkEndList.");
+    return false;
+  }
+
+  int begin = 0;
+  for(int i = 0; i < nChunk; ++i)
+  {
+    if(chunkEndList[i] <= begin || (i + 1 < nChunk && chunkEndList[i] - begin < minLZ4ChunkSize))
+    {
+      fatal("Chunks must be ascending and hold at least 4096 bytes but the last.");
+      return false;
+    }
+    begin = chunkEndList[i];
+  }
+  return true;
+}
+
+static std::vector<int> getChunkEndList(int srcSize, int chunkSize)
+{
+  std::vector<int> chunkEndList;
+  for(int end = 0; end < srcSize;)
+  {
+    end += std::min(chunkSize, srcSize - end);
+    chunkEndList.push_back(end);
   }
+  return chunkEndList;
+}
+
+static int getChunkedCompressBound(const std::vector<int> &chunkEndList)
+{
+  int bound = static_cast<int>(sizeof(uint32_t) + sizeof(LZ4ChunkEntry) * chunkEndList.size());
+  for(size_t i = 0; i < chunkEndList.size(); ++i)
+    bound += LZ4_compressBound(chunkEndList[i] - (i ? chunkEndList[i - 1] : 0));
+  return bound;
+}
 
+// src is copied unless dst is given, in which case both are borrowed, an empty chunkEndList makes a plain task
+static LZ4CompressionTask *createTask(const char *src, int srcSize, std::vector<int> chunkEndList, char *dst, int dstCapacity, int mode, int level,
+  bool calcAdler32, LZ4CompressionCallback callback, void *userData)
+{
   LZ4CompressionTask *task = new LZ4CompressionTask;
-  char *copiedSrc = GUARDED_ALLOC(char, srcSize);
-  std::copy(src, src + srcSize, copiedSrc);
-  task->future = std::async(std::launch::async, compressCore, copiedSrc, srcSize, mode, level, calcAdler32);
-  task->cacheValid = false;
+  if(dst)
+  {
+    task->src = src;
+    task->ownedSrc = nullptr;
+    task->srcCapacity = 0;
+  }
+  else
+  {
+    task->ownedSrc = globalBufferPool().acquire(srcSize, task->srcCapacity);
+    std::copy(src, src + srcSize, task->ownedSrc);
+    task->src = task->ownedSrc;
+  }
+  task->srcSize = srcSize;
+  task->chunkEndList = std::move(chunkEndList);
+  task->mode = mode;
+  task->level = level;
   task->calcAdler32 = calcAdler32;
+  task->callback = callback;
+  task->userData = userData;
+  task->sizeBound = nullptr;
+  task->chunkData = nullptr;
+  task->chunkDataCapacity = 0;
+  task->nPendingChunk = 0;
+  task->compressedData = dst;
+  task->compressedCapacity = 0;
+  task->maxCompressedSize = dstCapacity;
+  task->compressedSize = 0;
+  task->adler32 = 0;
+  task->status = lvNotRunned;
+  return task;
+}
+
+static void postTask(LZ4CompressionTask *task)
+{
+  if(task->chunkEndList.empty())
+  {
+    // without dst a plain task gets a pooled one of bound size, a chunked task gets its own once the size is known
+    if(!task->compressedData)
+    {
+      task->maxCompressedSize = LZ4_compressBound(task->srcSize);
+      task->compressedData = globalBufferPool().acquire(task->maxCompressedSize, task->compressedCapacity);
+    }
+    globalTaskPool().post({compressJob, task, 0});
+    return;
+  }
+  int nChunk = static_cast<int>(task->chunkEndList.size());
+  task->chunkOffsetList.assign(nChunk + 1, 0);
+  for(int i = 0; i < nChunk; ++i)
+    task->chunkOffsetList[i + 1] = task->chunkOffsetList[i] + LZ4_compressBound(task->chunkEndList[i] - (i ? task->chunkEndList[i - 1] : 0));
+  task->chunkData = globalBufferPool().acquire(task->chunkOffsetList.back(), task->chunkDataCapacity);
+  task->chunkSizeList.resize(nChunk);
+  task->nPendingChunk = nChunk;
+  std::vector<PoolJob> jobList(nChunk);
+  for(int i = 0; i < nChunk; ++i)
+    jobList[i] = {compressChunkJob, task, static_cast<uint32_t>(i)};
+  globalTaskPool().post(jobList.data(), static_cast<uint32_t>(nChunk));
+}
+
+static void waitTask(LZ4CompressionTask *task)
+{
+  if(task->status != lvFinished)
+  {
+    std::unique_lock<std::mutex> locker(g_taskDoneLock);
+    g_taskDone.wait(locker, [task]() { return task->status == lvFinished; });
+  }
+}
+
+LZ4SizeBound *lvCreateLZ4SizeBound()
+{
+  LZ4SizeBound *bound = new LZ4SizeBound;
+  bound->size = std::numeric_limits<int>::max();
+  return bound;
+}
+
+int lvGetLZ4SizeBound(LZ4SizeBound *bound)
+{
+  if(!bound)
+  {
+    fatal("Invalid bound.");
+    return 0;
+  }
+  return bound->size;
+}
+
+void lvDestroyLZ4SizeBound(LZ4SizeBound *bound)
+{ delete bound; }
+
+int lvGetLZ4CompressBound(int srcSize)
+{ return LZ4_compressBound(srcSize); }
+
+int lvGetChunkedLZ4CompressBound(int srcSize, int chunkSize)
+{
+  if(srcSize <= 0 || chunkSize < minLZ4ChunkSize)
+  {
+    fatal("Invalid srcSize or chunkSize.");
+    return 0;
+  }
+  return getChunkedCompressBound(getChunkEndList(srcSize, chunkSize));
+}
+
+int lvGetChunkedLZ4CompressBoundByEnds(const int *chunkEndList, int nChunk)
+{
+  if(!checkChunkEndList(chunkEndList, nChunk))
+    return 0;
+  return getChunkedCompressBound(std::vector<int>(chunkEndList, chunkEndList + nChunk));
+}
+
+LZ4CompressionTask *lvCreateLZ4CompressionTask(const char *src, int srcSize, int mode, int level, bool calcAdler32)
+{
+  if(!checkTaskArguments(src, srcSize, mode, level))
+    return nullptr;
+
+  LZ4CompressionTask *task = createTask(src, srcSize, {}, nullptr, 0, mode, level, calcAdler32, nullptr, nullptr);
+  postTask(task);
+  return task;
+}
+
+LZ4CompressionTask *lvCreateChunkedLZ4CompressionTask(const char *src, int srcSize, int chunkSize, int mode, int level, bool calcAdler32)
+{
+  if(!checkTaskArguments(src, srcSize, mode, level))
+    return nullptr;
+
+  if(chunkSize < minLZ4ChunkSize)
+  {
+    fatal("chunkSize must be at least 4096.");
+    return nullptr;
+  }
+
+  LZ4CompressionTask *task = createTask(src, srcSize, getChunkEndList(srcSize, chunkSize), nullptr, 0, mode, level, calcAdler32, nullptr, nullptr);
+  postTask(task);
+  return task;
+}
+
+LZ4CompressionTask *lvCreateLZ4CompressionTaskInto(const char *src, int srcSize, char *dst, int dstCapacity, int mode, int level, bool calcAdler32,
+  LZ4CompressionCallback callback, void *userData)
+{
+  if(!checkTaskArguments(src, srcSize, mode, level))
+    return nullptr;
+
+  if(!dst || dstCapacity <= 0)
+  {
+    fatal("Invalid dst.");
+    return nullptr;
+  }
+
+  LZ4CompressionTask *task = createTask(src, srcSize, {}, dst, dstCapacity, mode, level, calcAdler32, callback, userData);
+  postTask(task);
+  return task;
+}
+
+LZ4CompressionTask *lvCreateChunkedLZ4CompressionTaskInto(const char *src, int srcSize, int chunkSize, char *dst, int dstCapacity, int mode, int level,
+  bool calcAdler32, LZ4CompressionCallback callback, void *userData)
+{
+  if(!checkTaskArguments(src, srcSize, mode, level))
+    return nullptr;
+
+  if(chunkSize < minLZ4ChunkSize)
+  {
+    fatal("chunkSize must be at least 4096.");
+    return nullptr;
+  }
+
+  if(!dst || dstCapacity <= 0)
+  {
+    fatal("Invalid dst.");
+    return nullptr;
+  }
+
+  LZ4CompressionTask *task = createTask(src, srcSize, getChunkEndList(srcSize, chunkSize), dst, dstCapacity, mode, level, calcAdler32, callback, userData);
+  postTask(task);
+  return task;
+}
+
+LZ4CompressionTask *lvCreateChunkedLZ4CompressionTaskByEndsInto(const char *src, const int *chunkEndList, int nChunk, char *dst, int dstCapacity,
+  int mode, int level, bool calcAdler32, LZ4CompressionCallback callback, void *userData)
+{
+  if(!checkChunkEndList(chunkEndList, nChunk) || !checkTaskArguments(src, chunkEndList[nChunk - 1], mode, level))
+    return nullptr;
+
+  if(!dst || dstCapacity <= 0)
+  {
+    fatal("Invalid dst.");
+    return nullptr;
+  }
+
+  LZ4CompressionTask *task = createTask(src, chunkEndList[nChunk - 1], std::vector<int>(chunkEndList, chunkEndList + nChunk), dst, dstCapacity,
+    mode, level, calcAdler32, callback, userData);
+  postTask(task);
+  return task;
+}
+
+LZ4CompressionTask *lvCreateBoundedLZ4CompressionTaskInto(const char *src, int srcSize, char *dst, int dstCapacity, int mode, int level,
+  LZ4SizeBound *bound)
+{
+  if(!checkTaskArguments(src, srcSize, mode, level))
+    return nullptr;
+
+  if(!dst || dstCapacity <= 0)
+  {
+    fatal("Invalid dst.");
+    return nullptr;
+  }
+
+  if(!bound)
+  {
+    fatal("Invalid bound.");
+    return nullptr;
+  }
+
+  LZ4CompressionTask *task = createTask(src, srcSize, {}, dst, dstCapacity, mode, level, false, nullptr, nullptr);
+  task->sizeBound = bound;
+  postTask(task);
   return task;
 }
 
@@ -182,13 +535,16 @@ int lvWaitLZ4CompressionTask(LZ4CompressionTask *task, int msec)
     return lvNotRunned;
   }
 
-  std::future_status status = std::future_status::ready;
-  if(msec < 0)
-    task->future.wait();
-  else
-    status = task->future.wait_for(std::chrono::milliseconds(msec));
+  if(task->status != lvFinished)
+  {
+    std::unique_lock<std::mutex> locker(g_taskDoneLock);
+    if(msec < 0)
+      g_taskDone.wait(locker, [task]() { return task->status == lvFinished; });
+    else
+      g_taskDone.wait_for(locker, std::chrono::milliseconds(msec), [task]() { return task->status == lvFinished; });
+  }
 
-  return futureStatusToLvTaskStatus(status);
+  return task->status;
 }
 
 int lvGetLZ4CompressionTaskResultSize(LZ4CompressionTask *task)
@@ -199,8 +555,8 @@ int lvGetLZ4CompressionTaskResultSize(LZ4CompressionTask *task)
     return -1;
   }
   
-  ensureCache(task);
-  return task->resultCache.compressedSize;
+  waitTask(task);
+  return task->compressedSize;
 }
 
 void lvGetLZ4CompressionTaskResultData(LZ4CompressionTask *task, char *dst, int dstCapacity)
@@ -211,8 +567,10 @@ void lvGetLZ4CompressionTaskResultData(LZ4CompressionTask *task, char *dst, int
     return;
   }
 
-  ensureCache(task);
-  std::copy(task->resultCache.compressedData, task->resultCache.compressedData + std::min(task->resultCache.compressedSize, dstCapacity), dst);
+  waitTask(task);
+  // a borrowing task may be read into its own dst
+  if(dst != task->compressedData)
+    std::copy(task->compressedData, task->compressedData + std::min(task->compressedSize, dstCapacity), dst);
 }
 
 uint32_t lvGetLZ4CompressionTaskResultAdler32(LZ4CompressionTask *task)
@@ -228,14 +586,15 @@ uint32_t lvGetLZ4CompressionTaskResultAdler32(LZ4CompressionTask *task)
     return 0;
   }
 
-  ensureCache(task);
-  return task->resultCache.adler32;
+  waitTask(task);
+  return task->adler32;
 }
 
 void lvDestroyLZ4CompressionTask(LZ4CompressionTask *task)
 {
-  ensureCache(task);
-  lvFree(task->resultCache.compressedData);
+  waitTask(task);
+  if(task->compressedCapacity)
+    globalBufferPool().release(task->compressedData, task->compressedCapacity);
   delete task;
 }
 
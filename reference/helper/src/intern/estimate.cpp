@@ -0,0 +1,173 @@
+#include "../estimate.h"
+#include "privateutil.hpp"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+using namespace LightVideo;
+
+namespace
+{
+  constexpr int hashBit = 12;
+  constexpr int sampleStep = 4;
+  constexpr int minMatch = 4;
+  constexpr int maxOffset = 65535;
+  // token and offset of a sequence
+  constexpr int sequenceCost = 3;
+
+  inline uint32_t read32(const uint8_t *p)
+  {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  inline uint32_t hash32(uint32_t v)
+  { return (v * 2654435761U) >> (32 - hashBit); }
+
+  inline int countTrailingZero(uint32_t v)
+  {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, v);
+    return static_cast<int>(index);
+#else // _MSC_VER
+    return __builtin_ctz(v);
+#endif // _MSC_VER
+  }
+
+  // number of equal bytes at a and b, b < a, up to end
+  inline int matchLength(const uint8_t *a, const uint8_t *b, const uint8_t *end)
+  {
+    const uint8_t *begin = a;
+#ifdef __SSE2__
+    while(a + 16 <= end)
+    {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+      __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+      uint32_t diff = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) ^ 0xFFFF;
+      if(diff)
+        return static_cast<int>(a - begin) + countTrailingZero(diff);
+      a += 16;
+      b += 16;
+    }
+#endif // __SSE2__
+    while(a < end && *a == *b)
+    {
+      ++a;
+      ++b;
+    }
+    return static_cast<int>(a - begin);
+  }
+
+  // length of the run of zero bytes at p, counted 16 bytes at a time
+  inline int zeroRunLength(const uint8_t *p, const uint8_t *end)
+  {
+    const uint8_t *begin = p;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    while(p + 16 <= end)
+    {
+      uint32_t nonZero = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), zero))) ^ 0xFFFF;
+      if(nonZero)
+        return static_cast<int>(p - begin) + countTrailingZero(nonZero);
+      p += 16;
+    }
+#endif // __SSE2__
+    while(p < end && *p == 0)
+      ++p;
+    return static_cast<int>(p - begin);
+  }
+
+  // bits per byte of data
+  double byteEntropy(const uint8_t *data, int size)
+  {
+    // four tables so consecutive equal bytes don't wait on each other
+    uint32_t hist[4][256];
+    memset(hist, 0, sizeof(hist));
+    int i = 0;
+    for(; i + 4 <= size; i += 4)
+    {
+      ++hist[0][data[i]];
+      ++hist[1][data[i + 1]];
+      ++hist[2][data[i + 2]];
+      ++hist[3][data[i + 3]];
+    }
+    for(; i < size; ++i)
+      ++hist[0][data[i]];
+
+    double entropy = 0.0;
+    for(int v = 0; v < 256; ++v)
+    {
+      uint32_t n = hist[0][v] + hist[1][v] + hist[2][v] + hist[3][v];
+      if(n)
+      {
+        double p = static_cast<double>(n) / size;
+        entropy -= p * std::log2(p);
+      }
+    }
+    return entropy;
+  }
+}
+
+int lvEstimateLZ4Size(const uint8_t *data, int size)
+{
+  lvAssert(data && size > 0, "Invalid data.");
+  // positions are stored + 1, 0 is empty
+  static thread_local uint32_t table[1 << hashBit];
+  memset(table, 0, sizeof(table));
+
+  const uint8_t *end = data + size;
+  int64_t nLiteral = 0, nCovered = 0, nSequence = 0;
+  int pos = 0, literalBegin = 0;
+  while(pos + minMatch <= size)
+  {
+    int length = 0;
+    if(data[pos] == 0 && pos > 0)
+    {
+      // a zero run is a match of offset 1 as soon as a zero precedes it
+      length = zeroRunLength(data + pos, end);
+      if(length < minMatch)
+        length = 0;
+    }
+    if(length == 0)
+    {
+      uint32_t v = read32(data + pos);
+      uint32_t &entry = table[hash32(v)];
+      int candidate = static_cast<int>(entry) - 1;
+      entry = static_cast<uint32_t>(pos + 1);
+      if(candidate >= 0 && pos - candidate <= maxOffset && read32(data + candidate) == v)
+      {
+        // extend backwards over the literals the sampling stepped over
+        int back = 0;
+        while(back < pos - literalBegin && back < candidate && data[pos - back - 1] == data[candidate - back - 1])
+          ++back;
+        pos -= back;
+        candidate -= back;
+        length = minMatch + matchLength(data + pos + minMatch, data + candidate + minMatch, end);
+      }
+    }
+    if(length == 0)
+    {
+      pos += sampleStep;
+      continue;
+    }
+    nLiteral += pos - literalBegin;
+    nCovered += length;
+    nSequence += 1;
+    pos += length;
+    literalBegin = pos;
+  }
+  nLiteral += size - std::min(size, literalBegin);
+
+  // literals of a low entropy buffer are partly matched by LZ4 HC even though the sampling missed them
+  double literalCost = 0.5 + 0.5 * byteEntropy(data, size) / 8.0;
+  double estimate = nLiteral * literalCost + nLiteral / 255.0 + nSequence * sequenceCost + nCovered / 255.0;
+  return std::max(1, static_cast<int>(estimate));
+}
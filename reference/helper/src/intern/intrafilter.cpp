@@ -32,6 +32,24 @@ void lvDefilterSubLeft16(uint16_t *data, int width, int height, int bpp)
 void lvDefilterSubAvg16(uint16_t *data, int width, int height, int bpp)
 { return defilterSubAvg(data, width, height, bpp); }
 
+#ifdef __SSE2__
+void lvFilterSubTop8(uint8_t *data, int width, int height, uint8_t threshold)
+{ return filter_subtop_sse2(data, width, height, threshold); }
+void lvFilterSubLeft8(uint8_t *data, int width, int height, uint8_t threshold)
+{ return filter_subleft_sse2(data, width, height, threshold); }
+void lvFilterSubAvg8(uint8_t *data, int width, int height, uint8_t threshold)
+{ return filter_subavg_sse2(data, width, height, threshold); }
+void lvFilterSubPaeth8(uint8_t *data, int width, int height, uint8_t threshold)
+{ return filter_subpaeth_sse2(data, width, height, threshold); }
+void lvFilterSubTop16(uint16_t *data, int width, int height, uint16_t threshold)
+{ return filter_subtop_sse2(data, width, height, threshold); }
+void lvFilterSubLeft16(uint16_t *data, int width, int height, uint16_t threshold)
+{ return filter_subleft_sse2(data, width, height, threshold); }
+void lvFilterSubAvg16(uint16_t *data, int width, int height, uint16_t threshold)
+{ return filter_subavg_sse2(data, width, height, threshold); }
+void lvFilterSubPaeth16(uint16_t *data, int width, int height, uint16_t threshold)
+{ return filter_subpaeth_sse2(data, width, height, threshold); }
+#else // __SSE2__
 void lvFilterSubTop8(uint8_t *data, int width, int height, uint8_t threshold)
 { return filterSubTop(data, width, height, threshold); }
 void lvFilterSubLeft8(uint8_t *data, int width, int height, uint8_t threshold)
@@ -47,4 +65,5 @@ void lvFilterSubLeft16(uint16_t *data, int width, int height, uint16_t threshold
 void lvFilterSubAvg16(uint16_t *data, int width, int height, uint16_t threshold)
 { return filterSubAvg(data, width, height, threshold); }
 void lvFilterSubPaeth16(uint16_t *data, int width, int height, uint16_t threshold)
-{ return filterSubPaeth(data, width, height, threshold); }
\ No newline at end of file
+{ return filterSubPaeth(data, width, height, threshold); }
+#endif // __SSE2__
\ No newline at end of file
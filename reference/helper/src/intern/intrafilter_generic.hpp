@@ -5,35 +5,72 @@ using namespace LightVideo;
 
 namespace LightVideo
 {
-  template<typename T>static inline void filterSubTop(T *data, int width, int height, T threshold)
+  /*
+    A lossy filter first replaces every sample whose residual is dropped by its prediction, in place, top to bottom.
+    The lossless filter of the result then yields exactly the residuals the decoder adds up, so no copy of the frame is needed.
+    Lossless filters run bottom to top and right to left, so every prediction still reads unfiltered samples.
+  */
+  template<typename T>static inline bool isResidualDropped(T curr, T pred, T threshold)
   {
-    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
-    auto workMem = GUARDED_ALLOC(typename std::remove_pointer<decltype(data)>::type, width * height);
-    std::copy(data, data + width * height, workMem);
-    if(threshold == 0)
+    // dark details are kept, a sample at or below the threshold is never pulled up to a brighter prediction
+    // bitwise operators keep the data dependent decision free of branches
+    int v = static_cast<int>(curr) - static_cast<int>(pred);
+    return (std::abs(v) <= static_cast<int>(threshold)) & !((curr <= threshold) & (pred > threshold));
+  }
+
+  /*
+    Drop pass of the filters predicting from the left, a sample depends on the one before it, so a row is a serial chain.
+    Groups of rows are run interleaved, each row one column behind the row above, so the chains overlap
+    while the top and upper left samples a row reads are already final.
+  */
+  template<typename T, typename Predict>static inline void dropInterleaved(T *data, int width, int height, T threshold, int firstRow, Predict predict)
+  {
+    constexpr int nInterleave = 4;
+    for(int y0 = firstRow; y0 < height; y0 += nInterleave)
     {
-      for(int y = 1; y < height; ++y)
+      int nRow = std::min(nInterleave, height - y0);
+      for(int step = 1; step < width + nRow - 1; ++step)
       {
-        for(int x = 0; x < width; ++x)
-          data[y * width + x] -= workMem[(y - 1) * width + x];
+        for(int r = 0; r < nRow; ++r)
+        {
+          int x = step - r;
+          if(x < 1 || x >= width)
+            continue;
+          T *p = data + (y0 + r) * width + x;
+          T curr = *p, pred = predict(p, width);
+          *p = isResidualDropped(curr, pred, threshold) ? pred : curr;
+        }
       }
     }
-    else
+  }
+
+  template<typename T>static inline void dropSubTop(T *data, int width, int height, T threshold)
+  {
+    for(int y = 1; y < height; ++y)
     {
-      for(int y = 1; y < height; ++y)
+      for(int x = 0; x < width; ++x)
       {
-        for(int x = 0; x < width; ++x)
-        {
-          int v = static_cast<int>(data[y * width + x]) - workMem[(y - 1) * width + x];
-          if(data[y * width + x] <= threshold && workMem[(y - 1) * width + x] > threshold)
-            data[y * width + x] = static_cast<uint8_t>(v);
-          else
-            data[y * width + x] = static_cast<uint8_t>(absDrop(v, static_cast<int>(threshold)));
-          workMem[y * width + x] = workMem[(y - 1) * width + x] + data[y * width + x];
-        }
+        T curr = data[y * width + x], pred = data[(y - 1) * width + x];
+        data[y * width + x] = isResidualDropped(curr, pred, threshold) ? pred : curr;
       }
     }
-    lvFree(workMem);
+  }
+
+  template<typename T>static inline void filterSubTopLossless(T *data, int width, int height)
+  {
+    for(int y = height - 1; y >= 1; --y)
+    {
+      for(int x = 0; x < width; ++x)
+        data[y * width + x] -= data[(y - 1) * width + x];
+    }
+  }
+
+  template<typename T>static inline void filterSubTop(T *data, int width, int height, T threshold)
+  {
+    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
+    if(threshold != 0)
+      dropSubTop(data, width, height, threshold);
+    filterSubTopLossless(data, width, height);
   }
 
   template<typename T>static inline void defilterSubTop(T *data, int width, int height, int bpp)
@@ -47,40 +84,26 @@ namespace LightVideo
     }
   }
 
-  template<typename T>static inline void filterSubLeft(T *data, int width, int height, T threshold)
+  template<typename T>static inline void dropSubLeft(T *data, int width, int height, T threshold)
+  { dropInterleaved(data, width, height, threshold, 0, [](const T *p, int) { return p[-1]; }); }
+
+  template<typename T>static inline void filterSubLeftLossless(T *data, int width, int height)
   {
-    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
-    if(threshold == 0)
-    {
-      for(int y = 0; y < height; ++y)
-      {
-        T t = data[y * width];
-        for(int x = 1; x < width; ++x)
-        {
-          T v = data[y * width + x] - t;
-          t = data[y * width + x];
-          data[y * width + x] = v;
-        }
-      }
-    }
-    else
+    for(int y = 0; y < height; ++y)
     {
-      for(int y = 0; y < height; ++y)
-      {
-        T t = data[y * width];
-        for(int x = 1; x < width; ++x)
-        {
-          int v = static_cast<int>(data[y * width + x]) - static_cast<int>(t);
-          if(data[y * width + x] <= threshold && t > threshold)
-            data[y * width + x] = static_cast<T>(v);
-          else
-            data[y * width + x] = static_cast<T>(absDrop(v, static_cast<int>(threshold)));
-          t += data[y * width + x];
-        }
-      }
+      for(int x = width - 1; x >= 1; --x)
+        data[y * width + x] -= data[y * width + x - 1];
     }
   }
 
+  template<typename T>static inline void filterSubLeft(T *data, int width, int height, T threshold)
+  {
+    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
+    if(threshold != 0)
+      dropSubLeft(data, width, height, threshold);
+    filterSubLeftLossless(data, width, height);
+  }
+
   template<typename T>static inline void defilterSubLeft(T *data, int width, int height, int bpp)
   {
     static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
@@ -165,44 +188,30 @@ namespace LightVideo
       std::abort();
   }
 
-  template<typename T>static inline void filterSubAvg(T *data, int width, int height, T threshold)
+  template<typename T>static inline void dropSubAvg(T *data, int width, int height, T threshold)
   {
-    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
-    auto workMem = GUARDED_ALLOC(typename std::remove_pointer<decltype(data)>::type, width * height);
-    std::copy(data, data + width, workMem);
-    if(threshold == 0)
-    {
-      for(int y = 1; y < height; ++y)
-      {
-        T t = data[y * width];
-        for(int x = 1; x < width; ++x)
-        {
-          T avg = (static_cast<unsigned int>(t) + static_cast<unsigned int>(workMem[x])) / 2;
-          t = workMem[x] = data[y * width + x];
-          data[y * width + x] -= avg;
-        }
-      }
-    }
-    else
+    dropInterleaved(data, width, height, threshold, 1, [](const T *p, int width)
+      { return static_cast<T>((static_cast<unsigned int>(p[-1]) + static_cast<unsigned int>(p[-width])) / 2); });
+  }
+
+  template<typename T>static inline void filterSubAvgLossless(T *data, int width, int height)
+  {
+    for(int y = height - 1; y >= 1; --y)
     {
-      for(int y = 1; y < height; ++y)
+      for(int x = width - 1; x >= 1; --x)
       {
-        T t = data[y * width];
-        for(int x = 1; x < width; ++x)
-        {
-          T avg = (static_cast<unsigned int>(t) + static_cast<unsigned int>(workMem[x])) / 2;
-          int v = static_cast<int>(data[y * width + x]) - static_cast<int>(avg);
-          T delta;
-          if(data[y * width + x] <= threshold && avg > threshold)
-            delta = static_cast<T>(v);
-          else
-            delta = static_cast<T>(absDrop(v, static_cast<int>(threshold)));
-          t = workMem[x] = avg + delta;
-          data[y * width + x] = delta;
-        }
+        T avg = (static_cast<unsigned int>(data[y * width + x - 1]) + static_cast<unsigned int>(data[(y - 1) * width + x])) / 2;
+        data[y * width + x] -= avg;
       }
     }
-    lvFree(workMem);
+  }
+
+  template<typename T>static inline void filterSubAvg(T *data, int width, int height, T threshold)
+  {
+    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
+    if(threshold != 0)
+      dropSubAvg(data, width, height, threshold);
+    filterSubAvgLossless(data, width, height);
   }
 
   template<typename T>static inline void defilterSubAvg(T *data, int width, int height, int bpp)
@@ -239,41 +248,24 @@ namespace LightVideo
       return _c;
   }
 
-  template<typename T>static inline void filterSubPaeth(T *data, int width, int height, T threshold)
+  template<typename T>static inline void dropSubPaeth(T *data, int width, int height, T threshold)
+  { dropInterleaved(data, width, height, threshold, 1, [](const T *p, int width) { return paeth(p[-1], p[-width], p[-width - 1]); }); }
+
+  template<typename T>static inline void filterSubPaethLossless(T *data, int width, int height)
   {
-    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
-    auto workMem = GUARDED_ALLOC(typename std::remove_pointer<decltype(data)>::type, width * height);
-    std::copy(data, data + width * height, workMem);
-    if(threshold == 0)
+    for(int y = height - 1; y >= 1; --y)
     {
-      for(int y = 1; y < height; ++y)
-      {
-        for(int x = 1; x < width; ++x)
-        {
-          T filtered = paeth(workMem[y * width + x - 1], workMem[(y - 1) * width + x], workMem[(y - 1) * width + x - 1]);
-          data[y * width + x] -= filtered;
-        }
-      }
+      for(int x = width - 1; x >= 1; --x)
+        data[y * width + x] -= paeth(data[y * width + x - 1], data[(y - 1) * width + x], data[(y - 1) * width + x - 1]);
     }
-    else
-    {
-      for(int y = 1; y < height; ++y)
-      {
-        for(int x = 1; x < width; ++x)
-        {
-          T filtered = paeth(workMem[y * width + x - 1], workMem[(y - 1) * width + x], workMem[(y - 1) * width + x - 1]);
-          int v = static_cast<int>(data[y * width + x]) - static_cast<int>(filtered);
-          T delta;
-          if(data[y * width + x] <= threshold && filtered > threshold)
-            delta = static_cast<T>(v);
-          else
-            delta = static_cast<T>(absDrop(v, static_cast<int>(threshold)));
-          workMem[y * width + x] = filtered + delta;
-          data[y * width + x] = delta;
-        }
-      }
-    }
-    lvFree(workMem);
+  }
+
+  template<typename T>static inline void filterSubPaeth(T *data, int width, int height, T threshold)
+  {
+    static_assert(std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value, "unsupported data type");
+    if(threshold != 0)
+      dropSubPaeth(data, width, height, threshold);
+    filterSubPaethLossless(data, width, height);
   }
 
   template<typename T>static inline void defilterSubPaeth(T *data, int width, int height, int bpp)
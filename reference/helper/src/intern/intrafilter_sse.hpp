@@ -861,4 +861,306 @@ namespace LightVideo
       }
     }
   }
-}
\ No newline at end of file
+}
+namespace LightVideo
+{
+  /*
+    Encoder filters, see intrafilter_generic.hpp for the drop and filter passes.
+    Lane operations are picked by sample type, Paeth decides in the next wider type and blends the samples with the narrowed masks.
+  */
+  template<typename T>struct FilterLane;
+
+  template<>struct FilterLane<uint8_t>
+  {
+    static constexpr int n = 16;
+    static inline __m128i set1(uint8_t v) { return _mm_set1_epi8(static_cast<char>(v)); }
+    static inline __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi8(a, b); }
+    static inline __m128i subs(__m128i a, __m128i b) { return _mm_subs_epu8(a, b); }
+    static inline __m128i isZero(__m128i a) { return _mm_cmpeq_epi8(a, _mm_setzero_si128()); }
+    // floor((a + b) / 2)
+    static inline __m128i avg(__m128i a, __m128i b) { return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), set1(1))); }
+    static inline __m128i widenLo(__m128i a) { return _mm_unpacklo_epi8(a, _mm_setzero_si128()); }
+    static inline __m128i widenHi(__m128i a) { return _mm_unpackhi_epi8(a, _mm_setzero_si128()); }
+    static inline __m128i narrowMask(__m128i lo, __m128i hi) { return _mm_packs_epi16(lo, hi); }
+    static inline __m128i wideSub(__m128i a, __m128i b) { return _mm_sub_epi16(a, b); }
+    static inline __m128i wideAdd(__m128i a, __m128i b) { return _mm_add_epi16(a, b); }
+    static inline __m128i wideAbs(__m128i a) { return _mm_max_epi16(a, _mm_sub_epi16(_mm_setzero_si128(), a)); }
+    static inline __m128i wideLess(__m128i a, __m128i b) { return _mm_cmplt_epi16(a, b); }
+    static inline __m128i interleaveLo(__m128i a, __m128i b) { return _mm_unpacklo_epi8(a, b); }
+    static inline __m128i interleaveHi(__m128i a, __m128i b) { return _mm_unpackhi_epi8(a, b); }
+  };
+
+  template<>struct FilterLane<uint16_t>
+  {
+    static constexpr int n = 8;
+    static inline __m128i set1(uint16_t v) { return _mm_set1_epi16(static_cast<short>(v)); }
+    static inline __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi16(a, b); }
+    static inline __m128i subs(__m128i a, __m128i b) { return _mm_subs_epu16(a, b); }
+    static inline __m128i isZero(__m128i a) { return _mm_cmpeq_epi16(a, _mm_setzero_si128()); }
+    static inline __m128i avg(__m128i a, __m128i b) { return _mm_sub_epi16(_mm_avg_epu16(a, b), _mm_and_si128(_mm_xor_si128(a, b), set1(1))); }
+    static inline __m128i widenLo(__m128i a) { return _mm_unpacklo_epi16(a, _mm_setzero_si128()); }
+    static inline __m128i widenHi(__m128i a) { return _mm_unpackhi_epi16(a, _mm_setzero_si128()); }
+    static inline __m128i narrowMask(__m128i lo, __m128i hi) { return _mm_packs_epi32(lo, hi); }
+    static inline __m128i wideSub(__m128i a, __m128i b) { return _mm_sub_epi32(a, b); }
+    static inline __m128i wideAdd(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+    static inline __m128i wideAbs(__m128i a)
+    {
+      __m128i sign = _mm_srai_epi32(a, 31);
+      return _mm_sub_epi32(_mm_xor_si128(a, sign), sign);
+    }
+    static inline __m128i wideLess(__m128i a, __m128i b) { return _mm_cmplt_epi32(a, b); }
+    static inline __m128i interleaveLo(__m128i a, __m128i b) { return _mm_unpacklo_epi16(a, b); }
+    static inline __m128i interleaveHi(__m128i a, __m128i b) { return _mm_unpackhi_epi16(a, b); }
+  };
+
+  static inline __m128i loadLane(const void *p)
+  { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+
+  static inline void storeLane(void *p, __m128i v)
+  { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+
+  static inline __m128i blendLane(__m128i mask, __m128i a, __m128i b)
+  { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+
+  // mask of the lanes isResidualDropped() is true for
+  template<typename T>static inline __m128i droppedLanes(__m128i curr, __m128i pred, __m128i threshold)
+  {
+    typedef FilterLane<T> L;
+    __m128i absDiff = _mm_or_si128(L::subs(curr, pred), L::subs(pred, curr));
+    __m128i small = L::isZero(L::subs(absDiff, threshold));
+    __m128i keep = _mm_andnot_si128(L::isZero(L::subs(pred, threshold)), L::isZero(L::subs(curr, threshold)));
+    return _mm_andnot_si128(keep, small);
+  }
+
+  // transposes an n x n block of samples, log2(n) rounds of interleaving row k with row k + n / 2
+  template<typename T>static inline void transposeLanes(__m128i *v)
+  {
+    typedef FilterLane<T> L;
+    __m128i tmp[L::n];
+    for(int round = 1; round < L::n; round *= 2)
+    {
+      for(int k = 0; k < L::n / 2; ++k)
+      {
+        tmp[2 * k] = L::interleaveLo(v[k], v[k + L::n / 2]);
+        tmp[2 * k + 1] = L::interleaveHi(v[k], v[k + L::n / 2]);
+      }
+      for(int k = 0; k < L::n; ++k)
+        v[k] = tmp[k];
+    }
+  }
+
+  /*
+    Rows are independent in SubLeft, so blocks of n rows are transposed and every vector step runs the chain of one column for n rows.
+    Rows and columns left over take the scalar path.
+  */
+  template<typename T>static inline void drop_subleft_sse2(T *data, const int width, const int height, const T threshold)
+  {
+    typedef FilterLane<T> L;
+    const __m128i t = L::set1(threshold);
+    const int blockHeight = height - height % L::n;
+    const int blockWidth = width - width % L::n;
+    for(int y0 = 0; y0 < blockHeight; y0 += L::n)
+    {
+      __m128i v[L::n];
+      __m128i left = _mm_setzero_si128();
+      for(int x0 = 0; x0 < blockWidth; x0 += L::n)
+      {
+        for(int r = 0; r < L::n; ++r)
+          v[r] = loadLane(data + (y0 + r) * width + x0);
+        transposeLanes<T>(v);
+        int k = 0;
+        if(x0 == 0)
+        {
+          left = v[0];
+          k = 1;
+        }
+        for(; k < L::n; ++k)
+        {
+          left = blendLane(droppedLanes<T>(v[k], left, t), left, v[k]);
+          v[k] = left;
+        }
+        transposeLanes<T>(v);
+        for(int r = 0; r < L::n; ++r)
+          storeLane(data + (y0 + r) * width + x0, v[r]);
+      }
+      for(int r = 0; r < L::n; ++r)
+      {
+        T *row = data + (y0 + r) * width;
+        for(int x = std::max(1, blockWidth); x < width; ++x)
+          row[x] = isResidualDropped(row[x], row[x - 1], threshold) ? row[x - 1] : row[x];
+      }
+    }
+    dropSubLeft(data + blockHeight * width, width, height - blockHeight, threshold);
+  }
+
+  template<typename T>static inline __m128i paethLanes(__m128i a, __m128i b, __m128i c)
+  {
+    typedef FilterLane<T> L;
+    __m128i mask[2][2];
+    for(int half = 0; half < 2; ++half)
+    {
+      __m128i wa = half ? L::widenHi(a) : L::widenLo(a);
+      __m128i wb = half ? L::widenHi(b) : L::widenLo(b);
+      __m128i wc = half ? L::widenHi(c) : L::widenLo(c);
+      // p = a + b - c, pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+      __m128i db = L::wideSub(wb, wc), da = L::wideSub(wa, wc);
+      __m128i pa = L::wideAbs(db), pb = L::wideAbs(da), pc = L::wideAbs(L::wideAdd(da, db));
+      __m128i useA = _mm_and_si128(L::wideLess(pa, pb), L::wideLess(pa, pc));
+      mask[0][half] = useA;
+      mask[1][half] = _mm_andnot_si128(useA, L::wideLess(pb, pc));
+    }
+    __m128i useA = L::narrowMask(mask[0][0], mask[0][1]);
+    __m128i useB = L::narrowMask(mask[1][0], mask[1][1]);
+    return blendLane(useA, a, blendLane(useB, b, c));
+  }
+
+  /*
+    SubAvg and SubPaeth predict from the top as well, so rows of a block are skewed: row r is loaded r columns to the left,
+    after the transpose a vector holds the diagonal where every row reads the final samples of the row above from the previous two vectors.
+    The triangles at both ends of a block and the rows left over take the scalar path.
+  */
+  template<typename T, typename PredictLanes, typename Predict>
+  static inline void drop_skewed_sse2(T *data, const int width, const int height, const T threshold, PredictLanes predictLanes, Predict predict)
+  {
+    typedef FilterLane<T> L;
+    const __m128i t = L::set1(threshold);
+    auto dropSample = [&](T *p) { p[0] = isResidualDropped(p[0], predict(p, width), threshold) ? predict(p, width) : p[0]; };
+    int y0 = 1;
+    for(; width >= 2 * L::n && y0 + L::n <= height; y0 += L::n)
+    {
+      for(int r = 0; r < L::n; ++r)
+      {
+        for(int x = 1; x < L::n - r; ++x)
+          dropSample(data + (y0 + r) * width + x);
+      }
+      T lane[L::n];
+      for(int r = 0; r < L::n; ++r)
+        lane[r] = data[(y0 + r) * width + L::n - 1 - r];
+      __m128i prev = loadLane(lane);
+      for(int r = 0; r < L::n; ++r)
+        lane[r] = r < L::n - 1 ? data[(y0 + r) * width + L::n - 2 - r] : 0;
+      __m128i prevPrev = loadLane(lane);
+
+      const T *above = data + (y0 - 1) * width;
+      int stepEnd = L::n;
+      for(; stepEnd + L::n <= width; stepEnd += L::n)
+      {
+        __m128i v[L::n];
+        for(int r = 0; r < L::n; ++r)
+          v[r] = loadLane(data + (y0 + r) * width + stepEnd - r);
+        transposeLanes<T>(v);
+        for(int k = 0; k < L::n; ++k)
+        {
+          int step = stepEnd + k;
+          __m128i top = _mm_or_si128(_mm_slli_si128(prev, sizeof(T)), _mm_cvtsi32_si128(above[step]));
+          __m128i topLeft = _mm_or_si128(_mm_slli_si128(prevPrev, sizeof(T)), _mm_cvtsi32_si128(above[step - 1]));
+          __m128i pred = predictLanes(prev, top, topLeft);
+          prevPrev = prev;
+          prev = blendLane(droppedLanes<T>(v[k], pred, t), pred, v[k]);
+          v[k] = prev;
+        }
+        transposeLanes<T>(v);
+        for(int r = 0; r < L::n; ++r)
+          storeLane(data + (y0 + r) * width + stepEnd - r, v[r]);
+      }
+
+      for(int r = 0; r < L::n; ++r)
+      {
+        for(int x = stepEnd - r; x < width; ++x)
+          dropSample(data + (y0 + r) * width + x);
+      }
+    }
+    if(y0 < height)
+      dropInterleaved(data, width, height, threshold, y0, predict);
+  }
+
+  template<typename T>static inline void filter_subtop_sse2(T *data, const int width, const int height, const T threshold)
+  {
+    typedef FilterLane<T> L;
+    const int vecEnd = width - width % L::n;
+    if(threshold != 0)
+    {
+      const __m128i t = L::set1(threshold);
+      for(int y = 1; y < height; ++y)
+      {
+        T *row = data + y * width, *up = row - width;
+        for(int x = 0; x < vecEnd; x += L::n)
+        {
+          __m128i curr = loadLane(row + x), pred = loadLane(up + x);
+          storeLane(row + x, blendLane(droppedLanes<T>(curr, pred, t), pred, curr));
+        }
+        for(int x = vecEnd; x < width; ++x)
+          row[x] = isResidualDropped(row[x], up[x], threshold) ? up[x] : row[x];
+      }
+    }
+    for(int y = height - 1; y >= 1; --y)
+    {
+      T *row = data + y * width, *up = row - width;
+      for(int x = 0; x < vecEnd; x += L::n)
+        storeLane(row + x, L::sub(loadLane(row + x), loadLane(up + x)));
+      for(int x = vecEnd; x < width; ++x)
+        row[x] -= up[x];
+    }
+  }
+
+  // the lossless passes below go right to left, every vector is loaded before the one left of it is stored
+  template<typename T>static inline void filter_subleft_sse2(T *data, const int width, const int height, const T threshold)
+  {
+    typedef FilterLane<T> L;
+    if(threshold != 0)
+      drop_subleft_sse2(data, width, height, threshold);
+    for(int y = 0; y < height; ++y)
+    {
+      T *row = data + y * width;
+      int x = width;
+      for(; x - L::n >= 1; x -= L::n)
+        storeLane(row + x - L::n, L::sub(loadLane(row + x - L::n), loadLane(row + x - L::n - 1)));
+      for(--x; x >= 1; --x)
+        row[x] -= row[x - 1];
+    }
+  }
+
+  template<typename T>static inline void filter_subavg_sse2(T *data, const int width, const int height, const T threshold)
+  {
+    typedef FilterLane<T> L;
+    if(threshold != 0)
+    {
+      drop_skewed_sse2(data, width, height, threshold, [](__m128i left, __m128i top, __m128i) { return L::avg(left, top); },
+        [](const T *p, int width) { return static_cast<T>((static_cast<unsigned int>(p[-1]) + static_cast<unsigned int>(p[-width])) / 2); });
+    }
+    for(int y = height - 1; y >= 1; --y)
+    {
+      T *row = data + y * width, *up = row - width;
+      int x = width;
+      for(; x - L::n >= 1; x -= L::n)
+      {
+        __m128i avg = L::avg(loadLane(row + x - L::n - 1), loadLane(up + x - L::n));
+        storeLane(row + x - L::n, L::sub(loadLane(row + x - L::n), avg));
+      }
+      for(--x; x >= 1; --x)
+        row[x] -= static_cast<T>((static_cast<unsigned int>(row[x - 1]) + static_cast<unsigned int>(up[x])) / 2);
+    }
+  }
+
+  template<typename T>static inline void filter_subpaeth_sse2(T *data, const int width, const int height, const T threshold)
+  {
+    typedef FilterLane<T> L;
+    if(threshold != 0)
+    {
+      drop_skewed_sse2(data, width, height, threshold, [](__m128i left, __m128i top, __m128i topLeft) { return paethLanes<T>(left, top, topLeft); },
+        [](const T *p, int width) { return paeth(p[-1], p[-width], p[-width - 1]); });
+    }
+    for(int y = height - 1; y >= 1; --y)
+    {
+      T *row = data + y * width, *up = row - width;
+      int x = width;
+      for(; x - L::n >= 1; x -= L::n)
+      {
+        __m128i filtered = paethLanes<T>(loadLane(row + x - L::n - 1), loadLane(up + x - L::n), loadLane(up + x - L::n - 1));
+        storeLane(row + x - L::n, L::sub(loadLane(row + x - L::n), filtered));
+      }
+      for(--x; x >= 1; --x)
+        row[x] -= paeth(row[x - 1], up[x], up[x - 1]);
+    }
+  }
+} // namespace LightVideo
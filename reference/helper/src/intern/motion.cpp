@@ -0,0 +1,172 @@
+#include "../motion.h"
+#include "privateutil.hpp"
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+using namespace LightVideo;
+
+namespace
+{
+  // the coarsest level keeps at least this many samples along its shorter side
+  constexpr int minLevelLength = 32;
+  constexpr int maxLevel = 4;
+  // steps of one sample the estimate may walk on each finer level
+  constexpr int maxRefineStep = 4;
+
+  struct PlaneView
+  {
+    const uint8_t *data;
+    int width, height;
+  };
+
+  struct Motion
+  {
+    int scale, moveX, moveY;
+  };
+
+  // 2x box filter, an odd last row or column is dropped
+  void downsample(const PlaneView &src, std::vector<uint8_t> &out, PlaneView &view)
+  {
+    view.width = src.width / 2;
+    view.height = src.height / 2;
+    out.resize(static_cast<size_t>(view.width) * view.height);
+    for(int y = 0; y < view.height; ++y)
+    {
+      const uint8_t *a = src.data + static_cast<size_t>(2 * y) * src.width, *b = a + src.width;
+      uint8_t *o = out.data() + static_cast<size_t>(y) * view.width;
+      for(int x = 0; x < view.width; ++x)
+        o[x] = static_cast<uint8_t>((a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2);
+    }
+    view.data = out.data();
+  }
+
+  uint64_t rowSAD(const uint8_t *a, const uint8_t *b, int n)
+  {
+    uint64_t sum = 0;
+    int x = 0;
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    for(; x + 16 <= n; x += 16)
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x))));
+    uint64_t lane[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane), acc);
+    sum = lane[0] + lane[1];
+#endif // __SSE2__
+    for(; x < n; ++x)
+      sum += static_cast<uint64_t>(std::abs(a[x] - b[x]));
+    return sum;
+  }
+
+  /*
+    SAD of curr against ref resampled like lvMotionResample8() does, the mapped rows are gathered into row first.
+    The sum is given up once it exceeds limit, the result is then only known to be above it.
+  */
+  uint64_t motionSAD(const PlaneView &curr, const PlaneView &ref, const Motion &motion, uint64_t limit, std::vector<int> &mapX, std::vector<uint8_t> &row)
+  {
+    int width = curr.width, height = curr.height, scaledWidth, scaledHeight;
+    getMotionScaledSize(width, height, motion.scale, scaledWidth, scaledHeight);
+    int halfDiffW = (scaledWidth - width) / 2, halfDiffH = (scaledHeight - height) / 2;
+    for(int x = 0; x < width; ++x)
+      mapX[x] = static_cast<int>(clip<int64_t>(0, static_cast<int64_t>(x + halfDiffW - motion.moveX) * width / scaledWidth, width - 1));
+
+    uint64_t sum = 0;
+    for(int y = 0; y < height && sum <= limit; ++y)
+    {
+      int mappedY = static_cast<int>(clip<int64_t>(0, static_cast<int64_t>(y + halfDiffH - motion.moveY) * height / scaledHeight, height - 1));
+      const uint8_t *src = ref.data + static_cast<size_t>(mappedY) * width;
+      for(int x = 0; x < width; ++x)
+        row[x] = src[mapX[x]];
+      sum += rowSAD(curr.data + static_cast<size_t>(y) * width, row.data(), width);
+    }
+    return sum;
+  }
+
+  uint64_t motionSearch(const uint8_t *curr, const uint8_t *ref, int width, int height, int maxScale, int maxMove, int *scale, int *moveX, int *moveY)
+  {
+    lvAssert(curr && ref && scale && moveX && moveY);
+    lvAssert(width > 0 && height > 0 && maxScale >= 0 && maxMove >= 0);
+    // level i is 2^i times smaller, the search range shrinks with it
+    std::vector<PlaneView> currLevel = {{curr, width, height}}, refLevel = {{ref, width, height}};
+    std::vector<std::vector<uint8_t>> storage;
+    storage.reserve(2 * maxLevel);
+    for(int level = 1; level <= maxLevel && (std::min(width, height) >> level) >= minLevelLength && (std::max(maxScale, maxMove) >> level) > 0; ++level)
+    {
+      PlaneView c, r;
+      storage.emplace_back();
+      downsample(currLevel.back(), storage.back(), c);
+      storage.emplace_back();
+      downsample(refLevel.back(), storage.back(), r);
+      currLevel.push_back(c);
+      refLevel.push_back(r);
+    }
+    std::vector<int> mapX(width);
+    std::vector<uint8_t> row(width);
+
+    // exhaustive on the coarsest level, zero motion first so it wins ties
+    int top = static_cast<int>(currLevel.size()) - 1;
+    int scaleRange = maxScale >> top, moveRange = maxMove >> top;
+    Motion best = {0, 0, 0};
+    uint64_t bestSAD = motionSAD(currLevel[top], refLevel[top], best, UINT64_MAX, mapX, row);
+    for(int s = -scaleRange; s <= scaleRange; ++s)
+      for(int my = -moveRange; my <= moveRange; ++my)
+        for(int mx = -moveRange; mx <= moveRange; ++mx)
+        {
+          Motion m = {s, mx, my};
+          uint64_t sad = motionSAD(currLevel[top], refLevel[top], m, bestSAD, mapX, row);
+          if(sad < bestSAD)
+          {
+            best = m;
+            bestSAD = sad;
+          }
+        }
+
+    // every finer level doubles the estimate and walks it by one sample per parameter while that improves
+    for(int level = top - 1; level >= 0; --level)
+    {
+      scaleRange = maxScale >> level;
+      moveRange = maxMove >> level;
+      best = {clip(-scaleRange, best.scale * 2, scaleRange), clip(-moveRange, best.moveX * 2, moveRange), clip(-moveRange, best.moveY * 2, moveRange)};
+      bestSAD = motionSAD(currLevel[level], refLevel[level], best, UINT64_MAX, mapX, row);
+      for(int step = 0; step < maxRefineStep; ++step)
+      {
+        Motion center = best;
+        for(int ds = -1; ds <= 1; ++ds)
+          for(int dy = -1; dy <= 1; ++dy)
+            for(int dx = -1; dx <= 1; ++dx)
+            {
+              Motion m = {center.scale + ds, center.moveX + dx, center.moveY + dy};
+              if((ds == 0 && dx == 0 && dy == 0) || std::abs(m.scale) > scaleRange || std::abs(m.moveX) > moveRange || std::abs(m.moveY) > moveRange)
+                continue;
+              uint64_t sad = motionSAD(currLevel[level], refLevel[level], m, bestSAD, mapX, row);
+              if(sad < bestSAD)
+              {
+                best = m;
+                bestSAD = sad;
+              }
+            }
+        if(best.scale == center.scale && best.moveX == center.moveX && best.moveY == center.moveY)
+          break;
+      }
+    }
+
+    // a coarse estimate may be worse than no motion at all
+    if(best.scale != 0 || best.moveX != 0 || best.moveY != 0)
+    {
+      uint64_t zeroSAD = motionSAD(currLevel[0], refLevel[0], {0, 0, 0}, bestSAD, mapX, row);
+      if(zeroSAD <= bestSAD)
+      {
+        best = {0, 0, 0};
+        bestSAD = zeroSAD;
+      }
+    }
+    *scale = best.scale;
+    *moveX = best.moveX;
+    *moveY = best.moveY;
+    return bestSAD;
+  }
+} // namespace
+
+uint64_t lvMotionSearch8(const uint8_t *curr, const uint8_t *ref, int width, int height, int maxScale, int maxMove, int *scale, int *moveX, int *moveY)
+{ return motionSearch(curr, ref, width, height, maxScale, maxMove, scale, moveX, moveY); }
@@ -68,6 +68,21 @@ namespace LightVideo
   template<typename T>static inline T clip(T min, T v, T max)
   { return std::min(std::max(min, v), max); }
 
+  // size lvMotionResample8() scales a plane to, scale is added to the shorter side and the other one keeps the aspect ratio
+  static inline void getMotionScaledSize(int width, int height, int scale, int &scaledWidth, int &scaledHeight)
+  {
+    if(height < width)
+    {
+      scaledHeight = std::max(1, height + scale);
+      scaledWidth = std::max(1, static_cast<int>(static_cast<int64_t>(width) * static_cast<int64_t>(scaledHeight) / static_cast<int64_t>(height)));
+    }
+    else
+    {
+      scaledWidth = std::max(1, width + scale);
+      scaledHeight = std::max(1, static_cast<int>(static_cast<int64_t>(height) * static_cast<int64_t>(scaledWidth) / static_cast<int64_t>(width)));
+    }
+  }
+
   template<typename T>static inline T absDrop(T x, T dropOrigin, T dropDst)
   {
     if(std::abs(x) - dropOrigin <= dropDst)
@@ -123,5 +138,8 @@ namespace LightVideo
 
   TaskStatus futureStatusToLvTaskStatus(std::future_status status);
 
+  // true if the CPU and the OS support AVX2, only the kernels of files built with AVX2 may be called otherwise
+  bool hasAVX2();
+
   void vPrintMessage(MessageCategory category, const char *msg, va_list args);
 }
\ No newline at end of file
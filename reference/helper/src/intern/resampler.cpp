@@ -7,27 +7,18 @@ template<typename T>void lvMontionResmpleImpl(const T *LV_RESTRICT src, int widt
 {
   lvAssert(width > 0 && height > 0, "width and height must be greater than 0");
   int nScaledW, nScaledH;
-  if(height < width)
-  {
-    nScaledH = std::max(1, height + scale);
-    nScaledW = std::max(1, static_cast<int>(static_cast<int64_t>(width) * static_cast<int64_t>(nScaledH) / static_cast<int64_t>(height)));
-  }
-  else
-  {
-    nScaledW = std::max(1, width + scale);
-    nScaledH = std::max(1, static_cast<int>(static_cast<int64_t>(height) * static_cast<int64_t>(nScaledW) / static_cast<int64_t>(width)));
-  }
+  getMotionScaledSize(width, height, scale, nScaledW, nScaledH);
 
   int halfDiffW = (nScaledW - width) / 2;
   int halfDiffH = (nScaledH - height) / 2;
+  // rows are width samples apart, products in 64 bit as the decoder takes them
   for(int i = 0; i < height; ++i)
   {
+    int mappedY = static_cast<int>(clip<int64_t>(0, static_cast<int64_t>(i + halfDiffH - moveY) * height / nScaledH, height - 1));
     for(int j = 0; j < width; ++j)
     {
-      int mappedX = clip(0, (j + halfDiffW - moveX) * width / nScaledW, width - 1);
-      int mappedY = clip(0, (i + halfDiffH - moveY) * height / nScaledH, height - 1);
-      T ref = src[mappedY * height + mappedX];
-      out[i * height + j] = ref;
+      int mappedX = static_cast<int>(clip<int64_t>(0, static_cast<int64_t>(j + halfDiffW - moveX) * width / nScaledW, width - 1));
+      out[static_cast<size_t>(i) * width + j] = src[static_cast<size_t>(mappedY) * width + mappedX];
     }
   }
 }
@@ -0,0 +1,157 @@
+#include "../residual.h"
+#include "privateutil.hpp"
+#include <cstdlib>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+using namespace LightVideo;
+
+namespace
+{
+  template<typename T>
+  inline bool isResidualKept(T curr, T ref, T threshold)
+  { return (curr < threshold && ref > threshold) || std::abs(static_cast<int>(curr) - static_cast<int>(ref)) > threshold; }
+
+  template<typename T>
+  inline T residualOf(T curr, T ref, T threshold)
+  { return isResidualKept(curr, ref, threshold) ? static_cast<T>(curr - ref) : 0; }
+
+#ifdef __SSE2__
+  template<typename T>struct ResidualLane;
+  template<>struct ResidualLane<uint8_t>
+  {
+    static inline __m128i set1(uint8_t v) { return _mm_set1_epi8(static_cast<char>(v)); }
+    static inline __m128i add(__m128i a, __m128i b) { return _mm_add_epi8(a, b); }
+    static inline __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi8(a, b); }
+    static inline __m128i subs(__m128i a, __m128i b) { return _mm_subs_epu8(a, b); }
+    static inline __m128i isZero(__m128i a) { return _mm_cmpeq_epi8(a, _mm_setzero_si128()); }
+  };
+  template<>struct ResidualLane<uint16_t>
+  {
+    static inline __m128i set1(uint16_t v) { return _mm_set1_epi16(static_cast<short>(v)); }
+    static inline __m128i add(__m128i a, __m128i b) { return _mm_add_epi16(a, b); }
+    static inline __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi16(a, b); }
+    static inline __m128i subs(__m128i a, __m128i b) { return _mm_subs_epu16(a, b); }
+    static inline __m128i isZero(__m128i a) { return _mm_cmpeq_epi16(a, _mm_setzero_si128()); }
+  };
+
+  // all ones in the lanes whose residual is zero or dropped, the threshold may be 0
+  template<typename T>
+  inline __m128i droppedLanes(__m128i curr, __m128i ref, __m128i threshold)
+  {
+    typedef ResidualLane<T> L;
+    // saturating differences give |curr - ref| <= t, curr >= t and ref <= t as zero tests
+    __m128i absDiff = _mm_or_si128(L::subs(curr, ref), L::subs(ref, curr));
+    __m128i notDark = _mm_or_si128(L::isZero(L::subs(threshold, curr)), L::isZero(L::subs(ref, threshold)));
+    return _mm_and_si128(L::isZero(L::subs(absDiff, threshold)), notDark);
+  }
+#endif // __SSE2__
+
+  template<typename T>
+  void computeResidual(const T *curr, const T *ref, T *residual, T *recon, int64_t size, T threshold)
+  {
+    lvAssert(size >= 0);
+    int64_t i = 0;
+#ifdef __SSE2__
+    typedef ResidualLane<T> L;
+    constexpr int n = 16 / sizeof(T);
+    const __m128i t = L::set1(threshold);
+    for(; i + n <= size; i += n)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + i));
+      __m128i out = L::sub(a, b);
+      if(threshold != 0)
+        out = _mm_andnot_si128(droppedLanes<T>(a, b, t), out);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(residual + i), out);
+      if(recon)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(recon + i), L::add(b, out));
+    }
+#endif // __SSE2__
+    for(; i < size; ++i)
+    {
+      residual[i] = residualOf(curr[i], ref[i], threshold);
+      if(recon)
+        recon[i] = static_cast<T>(ref[i] + residual[i]);
+    }
+  }
+
+  template<typename T>
+  inline T residualAt(const T *curr, const T *ref, int x, T threshold)
+  { return residualOf(curr[x], ref ? ref[x] : static_cast<T>(0), threshold); }
+
+  // a step of the residual as the SubLeft filter leaves it, zero steps are counted and the others summed by their wrapped magnitude
+  template<typename T>
+  inline void accumulateStep(T residual, T left, uint64_t &sumAbs, uint64_t &nZero)
+  {
+    T step = static_cast<T>(residual - left);
+    if(step == 0)
+      ++nZero;
+    else
+      sumAbs += std::min<uint64_t>(step, static_cast<T>(0 - step));
+  }
+
+  // samples [begin, end) of a row, begin > 0, returns the first sample left to the scalar path
+  template<typename T>
+  inline int accumulateStepLanes(const T *, const T *, int begin, int, T, uint64_t &, uint64_t &)
+  { return begin; }
+#ifdef __SSE2__
+  template<>
+  inline int accumulateStepLanes<uint8_t>(const uint8_t *curr, const uint8_t *ref, int begin, int end, uint8_t threshold, uint64_t &sumAbs, uint64_t &nZero)
+  {
+    typedef ResidualLane<uint8_t> L;
+    const __m128i t = L::set1(threshold), one = L::set1(1), zero = _mm_setzero_si128();
+    auto residualLanes = [&](int x)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + x));
+      __m128i b = ref ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + x)) : zero;
+      return _mm_andnot_si128(droppedLanes<uint8_t>(a, b, t), L::sub(a, b));
+    };
+    // psadbw sums the step magnitudes and the zero flags into 64 bit halves
+    __m128i sum = zero, count = zero;
+    int x = begin;
+    for(; x + 16 <= end; x += 16)
+    {
+      __m128i step = L::sub(residualLanes(x), residualLanes(x - 1));
+      __m128i magnitude = _mm_min_epu8(step, L::sub(zero, step));
+      sum = _mm_add_epi64(sum, _mm_sad_epu8(magnitude, zero));
+      count = _mm_add_epi64(count, _mm_sad_epu8(_mm_and_si128(L::isZero(step), one), zero));
+    }
+    uint64_t lane[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane), sum);
+    sumAbs += lane[0] + lane[1];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane), count);
+    nZero += lane[0] + lane[1];
+    return x;
+  }
+#endif // __SSE2__
+
+  template<typename T>
+  void residualStats(const T *curr, const T *ref, int width, int height, T threshold, uint64_t *sumAbs, uint64_t *nZero)
+  {
+    lvAssert(width > 0 && height > 0);
+    uint64_t sum = 0, count = 0;
+    for(int y = 0; y < height; ++y)
+    {
+      const T *currRow = curr + static_cast<size_t>(y) * width;
+      const T *refRow = ref ? ref + static_cast<size_t>(y) * width : nullptr;
+      accumulateStep(residualAt(currRow, refRow, 0, threshold), static_cast<T>(0), sum, count);
+      int x = accumulateStepLanes(currRow, refRow, 1, width, threshold, sum, count);
+      for(; x < width; ++x)
+        accumulateStep(residualAt(currRow, refRow, x, threshold), residualAt(currRow, refRow, x - 1, threshold), sum, count);
+    }
+    *sumAbs = sum;
+    *nZero = count;
+  }
+} // namespace
+
+void lvComputeResidual8(const uint8_t *curr, const uint8_t *ref, uint8_t *residual, uint8_t *recon, int64_t size, uint8_t threshold)
+{ return computeResidual(curr, ref, residual, recon, size, threshold); }
+void lvComputeResidual16(const uint16_t *curr, const uint16_t *ref, uint16_t *residual, uint16_t *recon, int64_t size, uint16_t threshold)
+{ return computeResidual(curr, ref, residual, recon, size, threshold); }
+void lvResidualStats8(const uint8_t *curr, const uint8_t *ref, int width, int height, uint8_t threshold, uint64_t *sumAbs, uint64_t *nZero)
+{ return residualStats(curr, ref, width, height, threshold, sumAbs, nZero); }
+void lvResidualStats16(const uint16_t *curr, const uint16_t *ref, int width, int height, uint16_t threshold, uint64_t *sumAbs, uint64_t *nZero)
+{ return residualStats(curr, ref, width, height, threshold, sumAbs, nZero); }
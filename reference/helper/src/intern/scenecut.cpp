@@ -0,0 +1,56 @@
+#include "../scenecut.h"
+#include "privateutil.hpp"
+#include <cstring>
+#include <cstdlib>
+
+using namespace LightVideo;
+
+namespace
+{
+  constexpr int nBinBit = 6;
+  constexpr int nBin = 1 << nBinBit;
+  constexpr int maxChannel = 4;
+
+  template<typename T>
+  void sceneCutMetric(const T *curr, const T *prev, int width, int height, int nChannel, int step, float *histDiff, float *sad)
+  {
+    lvAssert(nChannel > 0 && nChannel <= maxChannel);
+    lvAssert(width > 0 && height > 0 && step > 0);
+    constexpr int binShift = sizeof(T) * 8 - nBinBit;
+    constexpr double maxValue = (1 << (sizeof(T) * 8)) - 1;
+    uint32_t currHist[maxChannel][nBin], prevHist[maxChannel][nBin];
+    memset(currHist, 0, sizeof(currHist));
+    memset(prevHist, 0, sizeof(prevHist));
+
+    uint64_t sum = 0, nSample = 0;
+    for(int y = 0; y < height; y += step)
+    {
+      const T *currLine = curr + static_cast<size_t>(y) * width * nChannel;
+      const T *prevLine = prev + static_cast<size_t>(y) * width * nChannel;
+      for(int x = 0; x < width; x += step)
+      {
+        for(int c = 0; c < nChannel; ++c)
+        {
+          int a = currLine[x * nChannel + c], b = prevLine[x * nChannel + c];
+          ++currHist[c][a >> binShift];
+          ++prevHist[c][b >> binShift];
+          sum += std::abs(a - b);
+        }
+        ++nSample;
+      }
+    }
+
+    uint64_t distance = 0;
+    for(int c = 0; c < nChannel; ++c)
+      for(int i = 0; i < nBin; ++i)
+        distance += currHist[c][i] > prevHist[c][i] ? currHist[c][i] - prevHist[c][i] : prevHist[c][i] - currHist[c][i];
+    nSample *= nChannel;
+    *histDiff = static_cast<float>(distance / (2.0 * nSample));
+    *sad = static_cast<float>(sum / (maxValue * nSample));
+  }
+} // namespace
+
+void lvSceneCutMetric8(const uint8_t *curr, const uint8_t *prev, int width, int height, int nChannel, int step, float *histDiff, float *sad)
+{ return sceneCutMetric(curr, prev, width, height, nChannel, step, histDiff, sad); }
+void lvSceneCutMetric16(const uint16_t *curr, const uint16_t *prev, int width, int height, int nChannel, int step, float *histDiff, float *sad)
+{ return sceneCutMetric(curr, prev, width, height, nChannel, step, histDiff, sad); }
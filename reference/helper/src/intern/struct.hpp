@@ -7,7 +7,8 @@ namespace LightVideo
   enum CompressionMethod : uint8_t
   {
     NoCompression = 0x0,
-    LZ4Compression
+    LZ4Compression,
+    ChunkedLZ4Compression
   };
 
   enum IntraPredictMode : uint8_t
@@ -23,7 +24,9 @@ namespace LightVideo
   {
     NoReference = 0x0,
     PreviousFullReference,
-    PreviousReference
+    PreviousReference,
+    RepeatPreviousReference,
+    LongTermReference
   };
 
   enum ColorType : uint8_t
@@ -47,6 +50,12 @@ namespace LightVideo
     char _reserved_2[4];
   };
 
+  // ChunkedLZ4Compression payload: uint32_t nChunk, nChunk entries, then the chunks as independent LZ4 blocks
+  struct LZ4ChunkEntry
+  {
+    uint32_t uncompressedEnd, compressedEnd;
+  };
+
   struct VideoFramePacket
   {
     char vfpk[4];
@@ -0,0 +1,129 @@
+#include "taskpool.hpp"
+#include "lz4.h"
+#include "lz4hc.h"
+#include <algorithm>
+
+namespace LightVideo
+{
+  constexpr static size_t minBufferClass = 4096;
+  constexpr static size_t maxPooledBytes = static_cast<size_t>(256) << 20;
+
+  TaskPool::TaskPool(uint32_t threadCount)
+    : m_quit(false)
+  {
+    if(threadCount == 0)
+      threadCount = std::max(1U, std::thread::hardware_concurrency());
+    for(uint32_t i = 0; i < threadCount; ++i)
+      m_threadList.emplace_back(&TaskPool::work, this);
+  }
+
+  TaskPool::~TaskPool()
+  {
+    {
+      std::unique_lock<std::mutex> locker(m_lock);
+      m_quit = true;
+    }
+    m_jobReady.notify_all();
+    for(std::thread &t : m_threadList)
+      t.join();
+  }
+
+  void TaskPool::post(const PoolJob &job)
+  { post(&job, 1); }
+
+  void TaskPool::post(const PoolJob *jobList, uint32_t n)
+  {
+    {
+      std::unique_lock<std::mutex> locker(m_lock);
+      m_queue.insert(m_queue.end(), jobList, jobList + n);
+    }
+    if(n == 1)
+      m_jobReady.notify_one();
+    else
+      m_jobReady.notify_all();
+  }
+
+  uint32_t TaskPool::threadCount() const
+  { return static_cast<uint32_t>(m_threadList.size()); }
+
+  void TaskPool::work()
+  {
+    // pooled memory lives as long as the process, it is kept out of the allocation guard so lvCheckAllocated() doesn't list it
+    WorkerContext context;
+    context.lz4State = new char[LZ4_sizeofState()];
+    context.lz4HCState = new char[LZ4_sizeofStateHC()];
+    for(;;)
+    {
+      PoolJob job;
+      {
+        std::unique_lock<std::mutex> locker(m_lock);
+        m_jobReady.wait(locker, [this]() { return m_quit || !m_queue.empty(); });
+        if(m_quit)
+          break;
+        job = m_queue.front();
+        m_queue.pop_front();
+      }
+      job.func(job.arg, job.index, context);
+    }
+    delete[] static_cast<char*>(context.lz4State);
+    delete[] static_cast<char*>(context.lz4HCState);
+  }
+
+  BufferPool::BufferPool(size_t maxFreeBytes)
+    : m_freeBytes(0), m_maxFreeBytes(maxFreeBytes)
+  {}
+
+  BufferPool::~BufferPool()
+  {
+    for(auto &pair : m_freeList)
+    {
+      for(char *buffer : pair.second)
+        delete[] buffer;
+    }
+  }
+
+  char *BufferPool::acquire(size_t size, size_t &capacity)
+  {
+    capacity = minBufferClass;
+    while(capacity < size)
+      capacity *= 2;
+    {
+      std::unique_lock<std::mutex> locker(m_lock);
+      auto it = m_freeList.find(capacity);
+      if(it != m_freeList.end() && !it->second.empty())
+      {
+        char *buffer = it->second.back();
+        it->second.pop_back();
+        m_freeBytes -= capacity;
+        return buffer;
+      }
+    }
+    return new char[capacity];
+  }
+
+  void BufferPool::release(char *buffer, size_t capacity)
+  {
+    {
+      std::unique_lock<std::mutex> locker(m_lock);
+      if(m_freeBytes + capacity <= m_maxFreeBytes)
+      {
+        m_freeList[capacity].push_back(buffer);
+        m_freeBytes += capacity;
+        return;
+      }
+    }
+    delete[] buffer;
+  }
+
+  TaskPool &globalTaskPool()
+  {
+    static TaskPool *pool = new TaskPool();
+    return *pool;
+  }
+
+  BufferPool &globalBufferPool()
+  {
+    static BufferPool *pool = new BufferPool(maxPooledBytes);
+    return *pool;
+  }
+} // namespace LightVideo
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <map>
+
+namespace LightVideo
+{
+  // scratch owned by one worker for its whole life
+  struct WorkerContext
+  {
+    void *lz4State, *lz4HCState;
+  };
+
+  struct PoolJob
+  {
+    void (*func)(void *arg, uint32_t index, WorkerContext &context);
+    void *arg;
+    uint32_t index;
+  };
+
+  /*
+    Persistent workers running queued jobs in FIFO order.
+    Jobs are plain function pointers, so posting one allocates nothing.
+  */
+  class TaskPool final
+  {
+  public:
+    // threadCount 0 uses the hardware concurrency
+    TaskPool(uint32_t threadCount = 0);
+    ~TaskPool();
+
+    void post(const PoolJob &job);
+    void post(const PoolJob *jobList, uint32_t n);
+    uint32_t threadCount() const;
+
+  private:
+    void work();
+
+    std::vector<std::thread> m_threadList;
+    std::mutex m_lock;
+    std::condition_variable m_jobReady;
+    std::deque<PoolJob> m_queue;
+    bool m_quit;
+  };
+
+  /*
+    Free lists of buffers by power of two size class, so repeated tasks of similar sizes reuse their buffers.
+    At most maxFreeBytes are kept, buffers beyond it are freed on release.
+  */
+  class BufferPool final
+  {
+  public:
+    BufferPool(size_t maxFreeBytes);
+    ~BufferPool();
+
+    // capacity receives the size class of the buffer, which has to be given back to release()
+    char *acquire(size_t size, size_t &capacity);
+    void release(char *buffer, size_t capacity);
+
+  private:
+    std::mutex m_lock;
+    std::map<size_t, std::vector<char*>> m_freeList;
+    size_t m_freeBytes, m_maxFreeBytes;
+  };
+
+  // both are created on first use and never destroyed, joining workers while the DLL unloads would deadlock
+  TaskPool &globalTaskPool();
+  BufferPool &globalBufferPool();
+} // namespace LightVideo
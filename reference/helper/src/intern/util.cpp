@@ -4,6 +4,9 @@
 #include <mutex>
 #include <cstdarg>
 #include <future>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 using namespace LightVideo;
 
@@ -135,6 +138,31 @@ namespace LightVideo
       return lvFinished;
   }
 
+  bool hasAVX2()
+  {
+    static const bool supported = []()
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+      int info[4];
+      __cpuid(info, 0);
+      if(info[0] < 7)
+        return false;
+      // the OS has to save the ymm registers, which OSXSAVE and XCR0 tell
+      __cpuid(info, 1);
+      if(!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+        return false;
+      __cpuidex(info, 7, 0);
+      return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") != 0;
+#else
+      return false;
+#endif
+    }();
+    return supported;
+  }
+
   void debug(const char * msg, ...)
   {
     va_list args;
@@ -1,16 +1,137 @@
 #include "../yuv.h"
 #include "privateutil.hpp"
+#include "taskpool.hpp"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 #include "yuv_generic.hpp"
 
 using namespace LightVideo;
 
+namespace LightVideo
+{
+  // defined in yuv_avx2.cpp, the only file built with AVX2, so it is only called once hasAVX2() holds
+  int rgbi2yuv420pRowsAVX2(const uint8_t *row0, const uint8_t *row1, int nChannel, uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+    uint8_t *a0, uint8_t *a1, int width);
+}
+
+namespace
+{
+  // a band is at least this many chroma rows, smaller ones cost more in posting than they save
+  constexpr int minBandRows = 16;
+
+  /*
+    Bands are claimed by an atomic counter from both the caller and the posted jobs, so the caller never waits for a job that hasn't started.
+    Jobs starting after every band is claimed only drop their reference, the last reference frees the job.
+  */
+  struct YUV420Job
+  {
+    const uint8_t *rgb;
+    int nChannel, rowStride;
+    uint8_t *y, *u, *v, *a;
+    int width, height, halfWidth, halfHeight, bandRows, nBand;
+    bool avx2; // the AVX2 kernel converts the rows up to its last full step, the scalar code the rest
+    std::atomic<int> nextBand, nDone, nRef;
+    std::mutex lock;
+    std::condition_variable done;
+  };
+
+  void convertChromaRow(const YUV420Job &job, int j)
+  {
+    int r0 = 2 * j, r1 = std::min(2 * j + 1, job.height - 1);
+    const uint8_t *row0 = job.rgb + static_cast<size_t>(r0) * job.rowStride, *row1 = job.rgb + static_cast<size_t>(r1) * job.rowStride;
+    uint8_t *y0 = job.y + static_cast<size_t>(r0) * job.width, *y1 = r1 != r0 ? job.y + static_cast<size_t>(r1) * job.width : nullptr;
+    uint8_t *a0 = job.a ? job.a + static_cast<size_t>(r0) * job.width : nullptr, *a1 = job.a && y1 ? job.a + static_cast<size_t>(r1) * job.width : nullptr;
+    uint8_t *u = job.u + static_cast<size_t>(j) * job.halfWidth, *v = job.v + static_cast<size_t>(j) * job.halfWidth;
+    int x = 0;
+    if(y1 && job.avx2)
+      x = rgbi2yuv420pRowsAVX2(row0, row1, job.nChannel, y0, y1, u, v, a0, a1, job.width);
+    rgbi2yuv420pRowPair(row0, row1, job.nChannel, y0, y1, u, v, a0, a1, job.width, job.halfWidth, x);
+  }
+
+  void runBands(YUV420Job &job)
+  {
+    for(int b = job.nextBand++; b < job.nBand; b = job.nextBand++)
+    {
+      int end = std::min(job.halfHeight, (b + 1) * job.bandRows);
+      for(int j = b * job.bandRows; j < end; ++j)
+        convertChromaRow(job, j);
+      // the last row of an odd height belongs to no chroma row
+      if(b == job.nBand - 1 && job.height > 1 && job.height % 2)
+      {
+        size_t r = static_cast<size_t>(job.height - 1);
+        rgbi2yuv420pRow(job.rgb + r * job.rowStride, job.nChannel, job.y + r * job.width, job.a ? job.a + r * job.width : nullptr, job.width);
+      }
+      if(++job.nDone == job.nBand)
+      {
+        std::unique_lock<std::mutex> locker(job.lock);
+        job.done.notify_all();
+      }
+    }
+  }
+
+  void releaseJob(YUV420Job *job)
+  {
+    if(--job->nRef == 0)
+      delete job;
+  }
+
+  void yuv420Job(void *arg, uint32_t, WorkerContext&)
+  {
+    YUV420Job *job = reinterpret_cast<YUV420Job*>(arg);
+    runBands(*job);
+    releaseJob(job);
+  }
+
+  void rgbi2yuv420p(const uint8_t *rgb, int nChannel, int rowStride, uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a, int width, int height, int nThread)
+  {
+    lvAssert(rgb && y && u && v);
+    lvAssert(nChannel == 3 || nChannel == 4, "nChannel must be 3 or 4");
+    lvAssert(!a || nChannel == 4, "alpha needs 4 channels");
+    lvAssert(width > 0 && height > 0 && rowStride >= width * nChannel && nThread >= 0);
+    YUV420Job *job = new YUV420Job;
+    job->rgb = rgb;
+    job->nChannel = nChannel;
+    job->rowStride = rowStride;
+    job->y = y;
+    job->u = u;
+    job->v = v;
+    job->a = a;
+    job->width = width;
+    job->height = height;
+    job->halfWidth = std::max(1, width / 2);
+    job->halfHeight = std::max(1, height / 2);
+    job->avx2 = hasAVX2();
+    int nWorker = nThread == 0 ? static_cast<int>(globalTaskPool().threadCount()) + 1 : nThread;
+    job->nBand = clip(1, job->halfHeight / minBandRows, nWorker);
+    job->bandRows = (job->halfHeight + job->nBand - 1) / job->nBand;
+    job->nBand = (job->halfHeight + job->bandRows - 1) / job->bandRows;
+    job->nextBand = 0;
+    job->nDone = 0;
+    job->nRef = job->nBand;
+    if(job->nBand > 1)
+    {
+      std::vector<PoolJob> jobList(job->nBand - 1, {yuv420Job, job, 0});
+      globalTaskPool().post(jobList.data(), static_cast<uint32_t>(jobList.size()));
+    }
+    runBands(*job);
+    {
+      std::unique_lock<std::mutex> locker(job->lock);
+      job->done.wait(locker, [job]() { return job->nDone == job->nBand; });
+    }
+    releaseJob(job);
+  }
+} // namespace
+
 void lvYUVP2RGBI8(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *rgb, int stride, int width, int height)
 { yuvp2rgbi(y, u, v, rgb, stride, width, height); }
 void lvRGBI2YUVP8(const uint8_t *rgb, int stride, uint8_t *y, uint8_t *u, uint8_t *v, int width, int height)
 { rgbi2yuvp(rgb, stride, y, u, v, width, height); }
+void lvRGBI2YUV420P8(const uint8_t *rgb, int nChannel, int rowStride, uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a, int width, int height, int nThread)
+{ rgbi2yuv420p(rgb, nChannel, rowStride, y, u, v, a, width, height, nThread); }
 
 void lvYUVP2RGBI16(const uint16_t *y, const uint16_t *u, const uint16_t *v, uint16_t *rgb, int stride, int width, int height)
 { yuvp2rgbi(y, u, v, rgb, stride, width, height); }
 void lvRGBI2YUVP16(const uint16_t *rgb, int stride, uint16_t *y, uint16_t *u, uint16_t *v, int width, int height)
-{ rgbi2yuvp(rgb, stride, y, u, v, width, height); }
\ No newline at end of file
+{ rgbi2yuvp(rgb, stride, y, u, v, width, height); }
@@ -0,0 +1,16 @@
+#include "yuv_avx2.hpp"
+
+/*
+  Built with AVX2 while the rest of the helper is not, so the kernels of yuv_avx2.hpp are only instantiated here.
+  Callers check hasAVX2() first and fall back to the scalar code of yuv_generic.hpp.
+*/
+namespace LightVideo
+{
+  int rgbi2yuv420pRowsAVX2(const uint8_t *row0, const uint8_t *row1, int nChannel, uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+    uint8_t *a0, uint8_t *a1, int width)
+  {
+    if(nChannel == 4)
+      return rgbi2yuv420pRowPairAVX2<4>(row0, row1, y0, y1, u, v, a0, a1, width);
+    return rgbi2yuv420pRowPairAVX2<3>(row0, row1, y0, y1, u, v, a0, a1, width);
+  }
+} // namespace LightVideo
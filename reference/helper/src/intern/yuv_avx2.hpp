@@ -0,0 +1,83 @@
+#pragma once
+
+#include "privateutil.hpp"
+#include <cstdint>
+#include <immintrin.h>
+
+namespace LightVideo
+{
+  /*
+    Channels of 16 interleaved pixels as words. Every 128 bit lane loads 4 pixels and groups their channels by pshufb,
+    so the words come in the pixel order 0-3, 8-11 | 4-7, 12-15, which storeWords16() restores.
+  */
+  struct RGBWords
+  {
+    __m256i r, g, b, a;
+  };
+
+  template<int nChannel>static inline RGBWords loadRGB16(const uint8_t *p)
+  {
+    const __m256i group = nChannel == 4 ?
+      _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15, 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15) :
+      _mm256_setr_epi8(0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11, -1, -1, -1, -1, 0, 3, 6, 9, 1, 4, 7, 10, 2, 5, 8, 11, -1, -1, -1, -1);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4 * nChannel)), 1);
+    __m256i hi = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 8 * nChannel))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12 * nChannel)), 1);
+    lo = _mm256_shuffle_epi8(lo, group);
+    hi = _mm256_shuffle_epi8(hi, group);
+    __m256i rg = _mm256_unpacklo_epi32(lo, hi), ba = _mm256_unpackhi_epi32(lo, hi);
+    return {_mm256_unpacklo_epi8(rg, zero), _mm256_unpackhi_epi8(rg, zero), _mm256_unpacklo_epi8(ba, zero), _mm256_unpackhi_epi8(ba, zero)};
+  }
+
+  static inline void storeWords16(uint8_t *dst, __m256i words)
+  {
+    __m256i bytes = _mm256_packus_epi16(words, words);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi32(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1)));
+  }
+
+  // same formulas as rgb2ycocg<uint8_t>(), the lower clip is a signed max and the upper one can't be reached
+  static inline __m256i lumaWords(const RGBWords &p)
+  { return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(p.r, p.b), _mm256_slli_epi16(p.g, 1)), 2); }
+
+  static inline __m256i coWords(const RGBWords &p)
+  { return _mm256_max_epi16(_mm256_srai_epi16(_mm256_add_epi16(_mm256_sub_epi16(p.r, p.b), _mm256_set1_epi16(254)), 1), _mm256_setzero_si256()); }
+
+  static inline __m256i cgWords(const RGBWords &p)
+  {
+    __m256i d = _mm256_sub_epi16(_mm256_slli_epi16(p.g, 1), _mm256_add_epi16(p.r, p.b));
+    return _mm256_max_epi16(_mm256_srai_epi16(_mm256_add_epi16(d, _mm256_set1_epi16(508)), 2), _mm256_setzero_si256());
+  }
+
+  /*
+    rgbi2yuv420pRowPair() for two distinct rows, 16 pixels and 8 chroma samples per step.
+    Returns the column the scalar version has to continue from, with 3 channels the last load of a step reads 4 bytes past it.
+  */
+  template<int nChannel>static inline int rgbi2yuv420pRowPairAVX2(const uint8_t *LV_RESTRICT row0, const uint8_t *LV_RESTRICT row1,
+    uint8_t *LV_RESTRICT y0, uint8_t *LV_RESTRICT y1, uint8_t *LV_RESTRICT u, uint8_t *LV_RESTRICT v, uint8_t *LV_RESTRICT a0, uint8_t *LV_RESTRICT a1, int width)
+  {
+    constexpr int overread = nChannel == 3 ? 4 : 0;
+    const __m256i one = _mm256_set1_epi16(1), two = _mm256_set1_epi32(2);
+    int x = 0;
+    for(; (x + 16) * nChannel + overread <= width * nChannel; x += 16)
+    {
+      RGBWords p0 = loadRGB16<nChannel>(row0 + x * nChannel), p1 = loadRGB16<nChannel>(row1 + x * nChannel);
+      storeWords16(y0 + x, lumaWords(p0));
+      storeWords16(y1 + x, lumaWords(p1));
+      if(nChannel == 4 && a0)
+      {
+        storeWords16(a0 + x, p0.a);
+        storeWords16(a1 + x, p1.a);
+      }
+      // vertical sums, then madd adds the horizontal pairs, lane 0 holds the samples 0, 1, 4, 5 and lane 1 holds 2, 3, 6, 7
+      __m256i co = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_add_epi16(coWords(p0), coWords(p1)), one), two), 2);
+      __m256i cg = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_add_epi16(cgWords(p0), cgWords(p1)), one), two), 2);
+      __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(co, cg), _mm256_setzero_si256());
+      __m128i chroma = _mm_unpacklo_epi16(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), chroma);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), _mm_srli_si128(chroma, 8));
+    }
+    return x;
+  }
+} // namespace LightVideo
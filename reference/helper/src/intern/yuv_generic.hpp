@@ -1,4 +1,6 @@
 #include "privateutil.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <limits>
 
 namespace LightVideo
@@ -21,21 +23,81 @@ namespace LightVideo
     }
   }
 
+  // YCoCg of one pixel in fixed point, exact to the former double math since it only divides by powers of two and floors
+  template<typename T>static inline void rgb2ycocg(int r, int g, int b, int &cy, int &co, int &cg)
+  {
+    constexpr int vmax = std::numeric_limits<T>::max();
+    constexpr int ihvmax = vmax / 2;
+    cy = (r + 2 * g + b) >> 2;
+    co = clip(0, (r - b + 2 * ihvmax) >> 1, vmax);
+    cg = clip(0, (2 * g - r - b + 4 * ihvmax) >> 2, vmax);
+  }
+
   template<typename T>static inline void rgbi2yuvp(const T *LV_RESTRICT rgb, int stride, T *LV_RESTRICT y, T *LV_RESTRICT u, T *LV_RESTRICT v, int width, int height)
   {
-    constexpr double vmax = static_cast<double>(std::numeric_limits<T>::max());
-    constexpr double ihvmax = static_cast<double>(static_cast<int>(vmax / 2.0));
     for(int i = 0; i < width * height; ++i)
     {
-      double r = static_cast<double>(rgb[i * stride]);
-      double g = static_cast<double>(rgb[i * stride + 1]);
-      double b = static_cast<double>(rgb[i * stride + 2]);
-      double cy = r * 0.25 + g * 0.5 + b * 0.25;
-      double cg = (-r * 0.25 + g * 0.5 - b * 0.25) + ihvmax;
-      double co = (r * 0.5 - b * 0.5) + ihvmax;
-      y[i] = static_cast<T>(clip(0.0, cy, vmax));
-      u[i] = static_cast<T>(clip(0.0, co, vmax));
-      v[i] = static_cast<T>(clip(0.0, cg, vmax));
+      int cy, co, cg;
+      rgb2ycocg<T>(rgb[i * stride], rgb[i * stride + 1], rgb[i * stride + 2], cy, co, cg);
+      y[i] = static_cast<T>(cy);
+      u[i] = static_cast<T>(co);
+      v[i] = static_cast<T>(cg);
+    }
+  }
+
+  /*
+    Luma and alpha of the rows row0 and row1 from column xBegin on, and the rounded 2x2 box average of their chroma into u and v.
+    A plane of one row passes it as both rows with y1 and a1 null. The second column of a pair is clamped to the row, a is null without alpha.
+  */
+  static inline void rgbi2yuv420pRowPair(const uint8_t *LV_RESTRICT row0, const uint8_t *LV_RESTRICT row1, int nChannel,
+    uint8_t *LV_RESTRICT y0, uint8_t *LV_RESTRICT y1, uint8_t *LV_RESTRICT u, uint8_t *LV_RESTRICT v, uint8_t *LV_RESTRICT a0, uint8_t *LV_RESTRICT a1,
+    int width, int halfWidth, int xBegin)
+  {
+    for(int x = xBegin; x < width; ++x)
+    {
+      int cy, co, cg;
+      rgb2ycocg<uint8_t>(row0[x * nChannel], row0[x * nChannel + 1], row0[x * nChannel + 2], cy, co, cg);
+      y0[x] = static_cast<uint8_t>(cy);
+      if(y1)
+      {
+        rgb2ycocg<uint8_t>(row1[x * nChannel], row1[x * nChannel + 1], row1[x * nChannel + 2], cy, co, cg);
+        y1[x] = static_cast<uint8_t>(cy);
+      }
+      if(a0)
+      {
+        a0[x] = row0[x * nChannel + 3];
+        if(a1)
+          a1[x] = row1[x * nChannel + 3];
+      }
+    }
+    for(int i = xBegin / 2; i < halfWidth; ++i)
+    {
+      int sumCo = 2, sumCg = 2;
+      for(int x : {2 * i, std::min(2 * i + 1, width - 1)})
+      {
+        for(const uint8_t *p : {row0 + x * nChannel, row1 + x * nChannel})
+        {
+          int cy, co, cg;
+          rgb2ycocg<uint8_t>(p[0], p[1], p[2], cy, co, cg);
+          sumCo += co;
+          sumCg += cg;
+        }
+      }
+      u[i] = static_cast<uint8_t>(sumCo >> 2);
+      v[i] = static_cast<uint8_t>(sumCg >> 2);
+    }
+  }
+
+  // luma and alpha only, for the last row of a plane of odd height which no chroma row covers
+  static inline void rgbi2yuv420pRow(const uint8_t *LV_RESTRICT row, int nChannel, uint8_t *LV_RESTRICT y, uint8_t *LV_RESTRICT a, int width)
+  {
+    for(int x = 0; x < width; ++x)
+    {
+      int cy, co, cg;
+      rgb2ycocg<uint8_t>(row[x * nChannel], row[x * nChannel + 1], row[x * nChannel + 2], cy, co, cg);
+      y[x] = static_cast<uint8_t>(cy);
+      if(a)
+        a[x] = row[x * nChannel + 3];
     }
   }
 } // namespace LightVideo
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+* Global motion search
+*/
+
+#include "publicutil.h"
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+  /*
+    Finds the scale and move of ref, as lvMotionResample8() applies them, whose result is closest to curr in SAD.
+    Scales within [-maxScale, maxScale] and moves within [-maxMove, maxMove] are searched exhaustively on a 2x box pyramid of both planes,
+    then refined by one sample per parameter on each finer level. Zero motion is always measured at full size and wins ties.
+    Returns the SAD of the chosen motion at full size.
+  */
+  LIGHTVIDEO_EXPORT uint64_t lvMotionSearch8(const uint8_t *curr, const uint8_t *ref, int width, int height, int maxScale, int maxMove, int *scale, int *moveX, int *moveY);
+#ifdef __cplusplus
+} // extern "C"
+#endif // __cplusplus
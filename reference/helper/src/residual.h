@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+* Delta frame residual
+*/
+
+#include "publicutil.h"
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+  /*
+    residual = curr - ref, wrapping like the decoder adds it, in one pass without temporaries.
+    With a threshold residuals up to it are dropped, unless curr is below the threshold while ref is above it, so dark details are kept.
+    recon receives ref + residual, the samples the decoder reconstructs, and may be null.
+    curr, ref, residual and recon are size samples each, residual and recon must not overlap curr or ref.
+  */
+  LIGHTVIDEO_EXPORT void lvComputeResidual8(const uint8_t *curr, const uint8_t *ref, uint8_t *residual, uint8_t *recon, int64_t size, uint8_t threshold);
+  LIGHTVIDEO_EXPORT void lvComputeResidual16(const uint16_t *curr, const uint16_t *ref, uint16_t *residual, uint16_t *recon, int64_t size, uint16_t threshold);
+  /*
+    Statistics of the residual lvComputeResidual8() would give after a SubLeft filter, without writing either, to rank references before filtering them.
+    Offsets of whole regions such as a brightness change cost nothing, like they do once filtered. A null ref is all zero, standing in for a key frame.
+    sumAbs receives the sum of the wrapped magnitudes of the filtered residuals, nZero the number of them that are zero.
+  */
+  LIGHTVIDEO_EXPORT void lvResidualStats8(const uint8_t *curr, const uint8_t *ref, int width, int height, uint8_t threshold, uint64_t *sumAbs, uint64_t *nZero);
+  LIGHTVIDEO_EXPORT void lvResidualStats16(const uint16_t *curr, const uint16_t *ref, int width, int height, uint16_t threshold, uint64_t *sumAbs, uint64_t *nZero);
+#ifdef __cplusplus
+} // extern "C"
+#endif // __cplusplus
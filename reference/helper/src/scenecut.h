@@ -0,0 +1,21 @@
+#pragma once
+
+/*
+* Scene cut detection
+*/
+
+#include "publicutil.h"
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+  // every step-th sample of every step-th row is compared, both outputs are normalized to [0, 1]
+  // histDiff: half the L1 distance between the per-channel histograms
+  // sad: mean absolute difference divided by the maximum sample value
+  LIGHTVIDEO_EXPORT void lvSceneCutMetric8(const uint8_t *curr, const uint8_t *prev, int width, int height, int nChannel, int step, float *histDiff, float *sad);
+  LIGHTVIDEO_EXPORT void lvSceneCutMetric16(const uint16_t *curr, const uint16_t *prev, int width, int height, int nChannel, int step, float *histDiff, float *sad);
+#ifdef __cplusplus
+} // extern "C"
+#endif // __cplusplus
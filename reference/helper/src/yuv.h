@@ -14,6 +14,13 @@ extern "C"
   LIGHTVIDEO_EXPORT void lvYUVP2RGBI8(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *rgb, int outputStride, int width, int height);
   LIGHTVIDEO_EXPORT void lvRGBI2YUVP8(const uint8_t *rgb, int inputStride, uint8_t *y, uint8_t *u, uint8_t *v, int width, int height);
 
+  /*
+    Interleaved RGB or RGBA of nChannel samples per pixel to the planes of YUV420P in one pass, rows of rgb are rowStride bytes apart.
+    y and a are width x height, u and v are the rounded 2x2 box averages at max(1, width / 2) x max(1, height / 2).
+    a receives the fourth channel and may be null. Bands of rows run on the task pool, nThread 0 uses every worker and 1 only the caller.
+  */
+  LIGHTVIDEO_EXPORT void lvRGBI2YUV420P8(const uint8_t *rgb, int nChannel, int rowStride, uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a, int width, int height, int nThread);
+
   LIGHTVIDEO_EXPORT void lvYUVP2RGBI16(const uint16_t *y, const uint16_t *u, const uint16_t *v, uint16_t *rgb, int outputStride, int width, int height);
   LIGHTVIDEO_EXPORT void lvRGBI2YUVP16(const uint16_t *rgb, int inputStride, uint16_t *y, uint16_t *u, uint16_t *v, int width, int height);
 #ifdef __cplusplus
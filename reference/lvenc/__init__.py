@@ -1,6 +1,6 @@
 from .encoder import Encoder
 from .deccore import DecoderCore
 from . import struct
-from .cyuv import YUVPToRGBI, RGBIToYUVP
+from .cyuv import YUVPToRGBI, RGBIToYUVP, RGBIToYUV420P
 from .encaseq import EncoderASTCSeq
 from .decaseq import DecoderCoreASTCSeq
@@ -6,6 +6,10 @@ class _LZ4CompressionTask(ctypes.Structure):
     pass
 _pLZ4CompressionTask = ctypes.POINTER(_LZ4CompressionTask)
 
+class _LZ4SizeBound(ctypes.Structure):
+    pass
+_pLZ4SizeBound = ctypes.POINTER(_LZ4SizeBound)
+
 dll = ctypes.CDLL("lightvideo-encoder-helper.dll")
 
 COMPRESS_MODE_FAST = 0
@@ -13,6 +17,8 @@ COMPRESS_MODE_HC = 1
 
 COMPRESS_LEVEL_HC_MAX = 12
 
+MIN_CHUNK_SIZE = 4096
+
 TASK_NOTRUNNED = 0
 TASK_RUNNING = 1
 TASK_FINISHED = 2
@@ -21,6 +27,36 @@ lvCreateLZ4CompressionTask = dll.lvCreateLZ4CompressionTask
 lvCreateLZ4CompressionTask.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_bool]
 lvCreateLZ4CompressionTask.restype = _pLZ4CompressionTask
 
+lvCreateChunkedLZ4CompressionTask = dll.lvCreateChunkedLZ4CompressionTask
+lvCreateChunkedLZ4CompressionTask.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_bool]
+lvCreateChunkedLZ4CompressionTask.restype = _pLZ4CompressionTask
+
+_LZ4CompressionCallback = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_int, ctypes.c_uint)
+
+lvCreateLZ4CompressionTaskInto = dll.lvCreateLZ4CompressionTaskInto
+lvCreateLZ4CompressionTaskInto.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_bool, _LZ4CompressionCallback, ctypes.c_void_p]
+lvCreateLZ4CompressionTaskInto.restype = _pLZ4CompressionTask
+
+lvCreateBoundedLZ4CompressionTaskInto = dll.lvCreateBoundedLZ4CompressionTaskInto
+lvCreateBoundedLZ4CompressionTaskInto.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, _pLZ4SizeBound]
+lvCreateBoundedLZ4CompressionTaskInto.restype = _pLZ4CompressionTask
+
+lvCreateLZ4SizeBound = dll.lvCreateLZ4SizeBound
+lvCreateLZ4SizeBound.argtypes = []
+lvCreateLZ4SizeBound.restype = _pLZ4SizeBound
+
+lvGetLZ4SizeBound = dll.lvGetLZ4SizeBound
+lvGetLZ4SizeBound.argtypes = [_pLZ4SizeBound]
+lvGetLZ4SizeBound.restype = ctypes.c_int
+
+lvDestroyLZ4SizeBound = dll.lvDestroyLZ4SizeBound
+lvDestroyLZ4SizeBound.argtypes = [_pLZ4SizeBound]
+lvDestroyLZ4SizeBound.restype = None
+
+lvGetLZ4CompressBound = dll.lvGetLZ4CompressBound
+lvGetLZ4CompressBound.argtypes = [ctypes.c_int]
+lvGetLZ4CompressBound.restype = ctypes.c_int
+
 lvWaitLZ4CompressionTask = dll.lvWaitLZ4CompressionTask
 lvWaitLZ4CompressionTask.argtypes = [_pLZ4CompressionTask, ctypes.c_int]
 lvWaitLZ4CompressionTask.restype = ctypes.c_int
@@ -45,12 +81,15 @@ lvDecompressLZ4 = dll.lvDecompressLZ4
 lvDecompressLZ4.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_char_p, ctypes.c_int]
 lvDecompressLZ4.restype = ctypes.c_int
 
-def decompressLZ4(data, decompressedSize):
+def decompressLZ4(data, decompressedSize, exactSize = True):
+    # without exactSize, decompressedSize is only an upper bound
     assert decompressedSize > 0
     assert isinstance(data, bytes)
     assert len(data) > 0
     out = ctypes.create_string_buffer(decompressedSize)
     realDecompressedSize = lvDecompressLZ4(data, len(data), out, decompressedSize)
+    if(not exactSize and realDecompressedSize > 0):
+        return out.raw[:realDecompressedSize]
     if(realDecompressedSize != decompressedSize):
         raise ValueError("Invalid decompressedSize(expected %d, got %d)" % (decompressedSize, realDecompressedSize))
     return out.raw
@@ -95,3 +134,69 @@ class LZ4CompressionTask:
             return self._cache
         else:
             return self._cache
+
+class ChunkedLZ4CompressionTask(LZ4CompressionTask):
+    # result is a ChunkedLZ4Compression payload, chunks of chunkSize bytes are compressed in parallel
+    # only Packet Mode has it, the Encoder of lvenc writes Normal Mode and never uses it, see format.txt
+    def __init__(self, data, chunkSize, mode, level, calcAdler32 = False):
+        self.task = None
+        if(len(data) <= 0):
+            raise ValueError("Data size must be greater than 0.")
+        if(chunkSize < MIN_CHUNK_SIZE):
+            raise ValueError("Chunk size must be at least %d." % MIN_CHUNK_SIZE)
+        self.task = lvCreateChunkedLZ4CompressionTask(data, len(data), chunkSize, mode, level, calcAdler32)
+        self.calcAdler32 = calcAdler32
+        self._cache = None
+
+class LZ4SizeBound:
+    # smallest result of the tasks sharing it, bounded tasks that can't beat it abort early
+    def __init__(self):
+        self.bound = lvCreateLZ4SizeBound()
+
+    def __del__(self):
+        if(self.bound is not None):
+            lvDestroyLZ4SizeBound(self.bound)
+            self.bound = None
+
+    def get(self):
+        return lvGetLZ4SizeBound(self.bound)
+
+class BorrowedLZ4CompressionTask(LZ4CompressionTask):
+    # compresses a contiguous numpy array or bytes without copying it, data must not be modified until the task is finished
+    # with a bound, get() returns None if the task lost against it
+    def __init__(self, data, mode, level, calcAdler32 = False, bound = None):
+        self.task = None
+        if(bound is not None and calcAdler32):
+            raise ValueError("Bounded tasks don't calculate adler32.")
+        if(isinstance(data, np.ndarray)):
+            data = np.ascontiguousarray(data)
+            src, srcSize = data.ctypes.data, data.nbytes
+        else:
+            src, srcSize = ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p).value, len(data)
+        if(srcSize <= 0):
+            raise ValueError("Data size must be greater than 0.")
+        self._data = data
+        self._bound = bound
+        self._out = ctypes.create_string_buffer(lvGetLZ4CompressBound(srcSize))
+        if(bound is not None):
+            self.task = lvCreateBoundedLZ4CompressionTaskInto(src, srcSize, ctypes.addressof(self._out), len(self._out), mode, level, bound.bound)
+        else:
+            self.task = lvCreateLZ4CompressionTaskInto(src, srcSize, ctypes.addressof(self._out), len(self._out), mode, level, calcAdler32, _LZ4CompressionCallback(), None)
+        self.calcAdler32 = calcAdler32
+        self._cache = None
+
+    def get(self):
+        if(self.task is not None):
+            size = lvGetLZ4CompressionTaskResultSize(self.task)
+            if(size == 0 and self._bound is None):
+                raise ValueError("LZ4 compression failed.")
+            # only the compressed bytes are copied out of the bound sized buffer
+            data = ctypes.string_at(ctypes.addressof(self._out), size) if size > 0 else None
+            if(self.calcAdler32):
+                self._cache = (data, lvGetLZ4CompressionTaskResultAdler32(self.task))
+            else:
+                self._cache = data
+            lvDestroyLZ4CompressionTask(self.task)
+            self.task = None
+            self._data = self._out = self._bound = None
+        return self._cache
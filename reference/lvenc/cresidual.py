@@ -0,0 +1,42 @@
+import ctypes
+import numpy as np
+import numpy.ctypeslib as npct
+
+dll = ctypes.CDLL("lightvideo-encoder-helper.dll")
+uint8_p = npct.ndpointer(dtype = np.uint8, flags = "C")
+uint16_p = npct.ndpointer(dtype = np.uint16, flags = "C")
+
+lvComputeResidual8 = dll.lvComputeResidual8
+lvComputeResidual8.argtypes = [uint8_p, uint8_p, uint8_p, ctypes.c_void_p, ctypes.c_int64, ctypes.c_ubyte]
+lvComputeResidual8.restype = None
+lvComputeResidual16 = dll.lvComputeResidual16
+lvComputeResidual16.argtypes = [uint16_p, uint16_p, uint16_p, ctypes.c_void_p, ctypes.c_int64, ctypes.c_ushort]
+lvComputeResidual16.restype = None
+
+def _checkOutput(out, img):
+    if(out is None):
+        return np.empty_like(img)
+    if(out.shape != img.shape or out.dtype != img.dtype or not out.flags["C_CONTIGUOUS"]):
+        raise ValueError("Invalid output buffer")
+    return out
+
+def computeResidual(img, refImg, dropThreshold, residual = None, recon = None, needRecon = True):
+    # returns (residual, recon), recon is the reference the decoder reconstructs and None if not needed
+    # residual and recon are allocated unless preallocated arrays of the input shape are given
+    if(img.shape != refImg.shape):
+        raise ValueError("Invalid input shape")
+    if(img.dtype != refImg.dtype):
+        raise TypeError("Invalid input data type")
+    img = np.require(img, img.dtype, requirements = "C")
+    refImg = np.require(refImg, refImg.dtype, requirements = "C")
+    residual = _checkOutput(residual, img)
+    recon = _checkOutput(recon, img) if needRecon else None
+    reconPtr = recon.ctypes.data if recon is not None else None
+
+    if(img.dtype == np.uint8):
+        lvComputeResidual8(img, refImg, residual, reconPtr, img.size, dropThreshold)
+    elif(img.dtype == np.uint16):
+        lvComputeResidual16(img, refImg, residual, reconPtr, img.size, dropThreshold)
+    else:
+        raise TypeError("Invalid input data type")
+    return residual, recon
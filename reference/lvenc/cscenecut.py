@@ -0,0 +1,36 @@
+import ctypes
+import numpy as np
+import numpy.ctypeslib as npct
+
+dll = ctypes.CDLL("lightvideo-encoder-helper.dll")
+float_p = ctypes.POINTER(ctypes.c_float)
+uint8_p_3d = npct.ndpointer(dtype = np.uint8, ndim = 3, flags = "C")
+uint16_p_3d = npct.ndpointer(dtype = np.uint16, ndim = 3, flags = "C")
+
+lvSceneCutMetric8 = dll.lvSceneCutMetric8
+lvSceneCutMetric8.argtypes = [uint8_p_3d, uint8_p_3d, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, float_p, float_p]
+lvSceneCutMetric8.restype = None
+lvSceneCutMetric16 = dll.lvSceneCutMetric16
+lvSceneCutMetric16.argtypes = [uint16_p_3d, uint16_p_3d, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, float_p, float_p]
+lvSceneCutMetric16.restype = None
+
+def sceneCutMetric(img, refImg, step = 4):
+    if(img.ndim != 3 or img.shape != refImg.shape):
+        raise ValueError("Invalid input shape")
+    if(img.dtype != refImg.dtype):
+        raise TypeError("Invalid input data type")
+    height, width, nChannel = img.shape
+    if(height == 0 or width == 0):
+        raise ValueError("Input size cannot be zero")
+    img = np.require(img, img.dtype, requirements = "C")
+    refImg = np.require(refImg, refImg.dtype, requirements = "C")
+
+    histDiff = ctypes.c_float()
+    sad = ctypes.c_float()
+    if(img.dtype == np.uint8):
+        lvSceneCutMetric8(img, refImg, width, height, nChannel, step, ctypes.byref(histDiff), ctypes.byref(sad))
+    elif(img.dtype == np.uint16):
+        lvSceneCutMetric16(img, refImg, width, height, nChannel, step, ctypes.byref(histDiff), ctypes.byref(sad))
+    else:
+        raise TypeError("Invalid input data type")
+    return histDiff.value, sad.value
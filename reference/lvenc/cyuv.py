@@ -16,6 +16,9 @@ lvYUVP2RGBI8.restype = None
 lvRGBI2YUVP8 = dll.lvRGBI2YUVP8
 lvRGBI2YUVP8.argtypes = [uint8_p_3d, ctypes.c_int, uint8_p_2d, uint8_p_2d, uint8_p_2d, ctypes.c_int, ctypes.c_int]
 lvRGBI2YUVP8.restype = None
+lvRGBI2YUV420P8 = dll.lvRGBI2YUV420P8
+lvRGBI2YUV420P8.argtypes = [uint8_p_3d, ctypes.c_int, ctypes.c_int, uint8_p_2d, uint8_p_2d, uint8_p_2d, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+lvRGBI2YUV420P8.restype = None
 
 lvYUVP2RGBI16 = dll.lvYUVP2RGBI16
 lvYUVP2RGBI16.argtypes = [uint16_p_2d, uint16_p_2d, uint16_p_2d, uint16_p_3d, ctypes.c_int, ctypes.c_int, ctypes.c_int]
@@ -68,3 +71,23 @@ def RGBIToYUVP(rgb):
         return y, u, v, rgb[:,:,3].copy()
     else:
         return y, u, v
+
+def RGBIToYUV420P(rgb, nThread = 0):
+    height, width, channel = rgb.shape
+    assert channel == 3 or channel == 4
+    if(rgb.dtype != np.uint8):
+        raise TypeError("Only uint8 is supported")
+    if(height == 0 or width == 0):
+        raise ValueError("Input size cannot be zero")
+
+    data = np.require(rgb, rgb.dtype, requirements = "C")
+    halfWidth, halfHeight = max(1, width // 2), max(1, height // 2)
+    y = np.zeros((height, width), dtype = np.uint8)
+    u, v = np.zeros((halfHeight, halfWidth), dtype = np.uint8), np.zeros((halfHeight, halfWidth), dtype = np.uint8)
+    a = np.zeros((height, width), dtype = np.uint8) if channel == 4 else None
+    lvRGBI2YUV420P8(data, channel, width * channel, y, u, v, None if a is None else a.ctypes.data, width, height, nThread)
+
+    if(channel == 4):
+        return y, u, v, a
+    else:
+        return y, u, v
@@ -49,8 +49,41 @@ class DecoderCore:
         if(self.width <= 0 or self.width > 32767 or self.height <= 0 or self.height > 32767):
             raise ValueError("Invalid width or height(got w = %d, h = %d)" % (self.width, self.height))
         
+        self.nLongTermSlot = mainStruct.nLongTermSlot
+        if(self.nLongTermSlot > MAX_LONGTERM_SLOT):
+            raise ValueError("Invalid long-term slot count(got %d)" % self.nLongTermSlot)
+        
         self.prevImg = None
         self.prevFullImg = None
+        self.slotImg = [None] * self.nLongTermSlot
+
+    def expandSkipMap(self, vf, data):
+        h, w = self.height, self.width
+        hh, hw = max(1, h // 2), max(1, w // 2)
+        planeList = []
+        if(self.nFullSizeChannel > 0):
+            planeList.append((np.zeros((h, w, self.nFullSizeChannel), dtype = self.dtype), vf.intraMethod[0]))
+        if(self.nHalfSizeChannel > 0):
+            planeList.append((np.zeros((hh, hw, self.nHalfSizeChannel), dtype = self.dtype), vf.intraMethod[1]))
+        bitmapSize = getSkipBitmapSize(w, h, vf.skipBlockSize)
+        if(len(data) < bitmapSize):
+            raise ValueError("Invalid skip map size")
+        iRead = bitmapSize
+        for b, rangeList in iterSkipBlocks([(h, w)] + [plane.shape for plane, _ in planeList], vf.skipBlockSize):
+            if(data[b // 8] >> (b % 8) & 1):
+                continue
+            for (plane, intraMethod), (y0, y1, x0, x1) in zip(planeList, rangeList[1:]):
+                size = (y1 - y0) * (x1 - x0) * plane.shape[2] * self.itemsize
+                if(size == 0):
+                    continue
+                if(iRead + size > len(data)):
+                    raise ValueError("Invalid skip map size")
+                block = np.frombuffer(data[iRead:iRead + size], dtype = self.dtype).reshape(y1 - y0, x1 - x0, plane.shape[2])
+                plane[y0:y1, x0:x1] = defilterMethodDict[intraMethod](block) if intraMethod != FILTER_NONE else block
+                iRead += size
+        if(iRead != len(data)):
+            raise ValueError("Invalid skip map size")
+        return b"".join(plane.tobytes() for plane, _ in planeList)
     
     def readFrame(self):
         vf = VideoFrameStruct()
@@ -59,19 +92,40 @@ class DecoderCore:
         # check video frame data header
         if(vf.vfrm != b'VFRM'):
             raise ValueError("Invalid frame header")
+        if(not vf.referenceType in (REFERENCE_NONE, REFERENCE_PREVFULL, REFERENCE_PREV, REFERENCE_REPEAT, REFERENCE_LONGTERM)):
+            raise ValueError("Invalid referenceType(got 0x%s)" % hex(vf.referenceType))
+        if(vf.skipBlockSize >= len(skipBlockSizeStr) or (vf.skipBlockSize != SKIP_NONE and vf.referenceType in (REFERENCE_NONE, REFERENCE_REPEAT))):
+            raise ValueError("Invalid skipBlockSize(got %d)" % vf.skipBlockSize)
+        if(vf.referenceType == REFERENCE_LONGTERM and vf.referenceSlot >= self.nLongTermSlot):
+            raise ValueError("Invalid reference slot(got %d)" % vf.referenceSlot)
+        if(vf.storeSlotMask >> self.nLongTermSlot or (vf.storeSlotMask and vf.referenceType != REFERENCE_NONE)):
+            raise ValueError("Invalid store slot mask(got 0x%x)" % vf.storeSlotMask)
+
+        # repeated frame has no data
+        if(vf.referenceType == REFERENCE_REPEAT):
+            if(vf.size != 0):
+                raise ValueError("Invalid video frame data size")
+            if(self.prevImg is None):
+                raise ValueError("No previous image avialable.")
+            return (*self.prevImg,)
         if(vf.size <= 0):
             raise ValueError("Invalid video frame data size")
-        if(not vf.referenceType in (REFERENCE_NONE, REFERENCE_PREVFULL, REFERENCE_PREV)):
-            raise ValueError("Invalid referenceType(got 0x%s)" % hex(vf.referenceType))
         
         if(not (vf.intraMethod[0] in intraFilterMethodStr and vf.intraMethod[1] in intraFilterMethodStr)):
            raise ValueError("Invalid intra filter method")
+        if(vf.skipBlockSize != SKIP_NONE and (vf.intraMethod[0] & 0xf0 or vf.intraMethod[1] & 0xf0)):
+           raise ValueError("Invalid intra filter method for skip map")
         
         # decompress video frame data
         h, w = self.height, self.width
         hh, hw = max(1, h // 2), max(1, w // 2)
         decompressedSize = (self.nFullSizeChannel * h * w + self.nHalfSizeChannel * hh * hw) * self.itemsize
-        decompressedData = clz4.decompressLZ4(self.stream.read(vf.size), decompressedSize)
+        if(vf.skipBlockSize != SKIP_NONE):
+            # expanded to defiltered residual planes, unchanged blocks are zero
+            bitmapSize = getSkipBitmapSize(w, h, vf.skipBlockSize)
+            decompressedData = self.expandSkipMap(vf, clz4.decompressLZ4(self.stream.read(vf.size), bitmapSize + decompressedSize, False))
+        else:
+            decompressedData = clz4.decompressLZ4(self.stream.read(vf.size), decompressedSize)
 
         # read into array
         iRead = 0
@@ -88,10 +142,10 @@ class DecoderCore:
 
         # defilter intra
         if(self.nFullSizeChannel > 0):
-            if(vf.intraMethod[0] != FILTER_NONE):
+            if(vf.intraMethod[0] != FILTER_NONE and vf.skipBlockSize == SKIP_NONE):
                 fullSizeChannel[:,:,:] = defilterMethodDict[vf.intraMethod[0]](fullSizeChannel)
         if(self.nHalfSizeChannel > 0):
-            if(vf.intraMethod[1] != FILTER_NONE):
+            if(vf.intraMethod[1] != FILTER_NONE and vf.skipBlockSize == SKIP_NONE):
                 halfSizeChannel[:,:,:] = defilterMethodDict[vf.intraMethod[1]](halfSizeChannel)
         
         # defilter delta
@@ -105,7 +159,15 @@ class DecoderCore:
                 raise ValueError("No previous full image avialable.")
             for i, channel in enumerate(imgList):
                 channel += self.prevImg[i]
+        elif(vf.referenceType == REFERENCE_LONGTERM):
+            if(self.slotImg[vf.referenceSlot] is None):
+                raise ValueError("No long-term image avialable.")
+            for i, channel in enumerate(imgList):
+                channel += self.slotImg[vf.referenceSlot][i]
         self.prevImg = imgList
         if(vf.referenceType == REFERENCE_NONE):
             self.prevFullImg = self.prevImg
+        for slot in range(self.nLongTermSlot):
+            if(vf.storeSlotMask & (1 << slot)):
+                self.slotImg[slot] = self.prevImg
         return (*imgList,)
\ No newline at end of file
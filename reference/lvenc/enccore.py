@@ -1,10 +1,14 @@
 import numpy as np
+import io
 import scipy.optimize as so
 import cv2
-from . import cfilter, cresampler, clz4, report
+from . import cfilter, cresampler, clz4, cscenecut, cresidual, report
 from .struct import *
 
 _LZ4_COMPRESSION_LEVEL = 9
+# a cut also has to move this fraction of the threshold in mean absolute difference,
+# so a global brightness shift that only slides the histogram is not taken as one
+_SCENECUT_SAD_RATIO = 0.25
 
 def applyBestIntraCompression(img, dropThreshold, minRetSize, fastDecodeMode = 2):
     h, w, nChannel = img.shape
@@ -39,15 +43,16 @@ def applyBestIntraCompression(img, dropThreshold, minRetSize, fastDecodeMode = 2
         filterModeList.append((FILTER_SUBAVG, "filtered", cfilter.filterSubAvg, cfilter.defilterSubAvg))
     _addEx(filterModeList, FILTER_SUBLEFT, cfilter.filterSubLeft, cfilter.defilterSubLeft, 0)
     _addEx(filterModeList, FILTER_SUBAVG, cfilter.filterSubAvg, cfilter.defilterSubAvg, fastDecodeMode)
+    # candidates that start after a smaller one finished abort once they outgrow it, the smallest always completes
+    bound = clz4.LZ4SizeBound()
     resultList = []
     for intraMethod, hint, filterFunc, defilterFunc in filterModeList:
         filtered = filterFunc(img, dropThreshold)
-        data = filtered.tobytes()
-        task = clz4.LZ4CompressionTask(data, clz4.COMPRESS_MODE_HC, _LZ4_COMPRESSION_LEVEL)
-        resultList.append((filtered, data, task, intraMethod, hint, filterFunc, defilterFunc))
-        del filtered, data, task
+        task = clz4.BorrowedLZ4CompressionTask(filtered, clz4.COMPRESS_MODE_HC, _LZ4_COMPRESSION_LEVEL, bound = bound)
+        resultList.append((filtered, task, intraMethod, hint, filterFunc, defilterFunc))
+        del filtered, task
     
-    filtered, data, task, intraMethod, hint, filterFunc, defilterFunc = sorted(tuple(x for x in resultList), key = lambda x:len(x[2].get()))[0]
+    filtered, task, intraMethod, hint, filterFunc, defilterFunc = sorted(tuple(x for x in resultList if x[1].get() is not None), key = lambda x:len(x[1].get()))[0]
     bestSize = len(task.get())
     if(minRetSize == -1 or bestSize < minRetSize):
         return {
@@ -61,23 +66,95 @@ def applyBestIntraCompression(img, dropThreshold, minRetSize, fastDecodeMode = 2
         return None
 
 def applyDeltaCompression(channel, refChannel, dropThreshold, minRetSize):
-    if(dropThreshold > 0):
-        deltaedChannel = channel.astype(int) - refChannel.astype(int)
-        needDrop = np.logical_and(~np.logical_and(channel < dropThreshold, refChannel > dropThreshold), np.abs(deltaedChannel) <= dropThreshold)
-        deltaedChannel[needDrop] = 0
-        del needDrop
-        deltaedChannel = deltaedChannel.astype(channel.dtype)
-    else:
-        deltaedChannel = channel - refChannel
+    # residual and the decoded channel in one native pass, the drop rule keeps dark details
+    deltaedChannel, reconChannel = cresidual.computeResidual(channel, refChannel, dropThreshold)
 
     intraResult = applyBestIntraCompression(deltaedChannel, 0, minRetSize)
     if(intraResult is not None):
-        intraResult["decompressed"] += refChannel
+        intraResult["decompressed"] = reconChannel
+        intraResult["residual"] = deltaedChannel
         return intraResult
     else:
         return None
 
-def applyBestFilter(currImgList, prevFullImgList, prevImgList, dropThreshold):
+def isRepeatFrame(currImgList, prevImgList, dropThreshold):
+    # true if every delta against prev would be dropped, so decoding it from prev yields prev again
+    if(prevImgList is None):
+        return False
+    for i, img in enumerate(currImgList):
+        refChannel = prevImgList[i]
+        if(dropThreshold > 0):
+            deltaedChannel = np.abs(img.astype(int) - refChannel.astype(int))
+            keep = np.logical_or(np.logical_and(img < dropThreshold, refChannel > dropThreshold), deltaedChannel > dropThreshold)
+            if(keep.any()):
+                return False
+            del deltaedChannel, keep
+        elif(not np.array_equal(img, refChannel)):
+            return False
+    return True
+
+def isSceneCut(currImgList, prevImgList, threshold):
+    # histogram distance and SAD on a sample grid, far cheaper than the delta trials in applyBestFilter
+    if(prevImgList is None or threshold <= 0):
+        return False
+    histDiff, sad, nSample = 0.0, 0.0, 0
+    for i, img in enumerate(currImgList):
+        h, d = cscenecut.sceneCutMetric(img, prevImgList[i])
+        histDiff += h * img.size
+        sad += d * img.size
+        nSample += img.size
+    histDiff /= nSample
+    sad /= nSample
+    report.do("Scene cut metric: hist %f, sad %f" % (histDiff, sad))
+    return histDiff >= threshold and sad >= threshold * _SCENECUT_SAD_RATIO
+
+# blocks of a skip map are filtered one by one, Ex methods need widths a block may not have
+_blockFilterDict = {
+    FILTER_NONE: lambda x, d:x.copy(),
+    FILTER_SUBTOP: cfilter.filterSubTop,
+    FILTER_SUBLEFT: cfilter.filterSubLeft,
+    FILTER_SUBAVG: cfilter.filterSubAvg,
+}
+
+def applySkipMap(deltaResult, skipBlockSize):
+    # bitmap and changed blocks of a delta result, each channel part filtered lossless with the base method of its channel
+    intraMethodList = [x["intraMethod"] & 0x0f for x in deltaResult]
+    residualList = [x["residual"] for x in deltaResult]
+    h, w = residualList[0].shape[:2]
+    bitmap = np.zeros(getSkipBitmapSize(w, h, skipBlockSize), dtype = np.uint8)
+    data = io.BytesIO()
+    nSkipped = 0
+    for b, rangeList in iterSkipBlocks([x.shape for x in residualList], skipBlockSize):
+        partList = [residual[y0:y1, x0:x1] for residual, (y0, y1, x0, x1) in zip(residualList, rangeList)]
+        if(not any(np.any(part) for part in partList)):
+            bitmap[b // 8] |= 1 << (b % 8)
+            nSkipped += 1
+            continue
+        for part, intraMethod in zip(partList, intraMethodList):
+            if(part.size > 0):
+                data.write(_blockFilterDict[intraMethod](part, 0).tobytes())
+    if(nSkipped == 0):
+        return None
+    return {
+        "data": bitmap.tobytes() + data.getvalue(),
+        "intraMethod": intraMethodList,
+        "skippedCount": nSkipped,
+    }
+
+def findClosestSlot(currImgList, slotImgList):
+    # mean absolute difference on every 4th sample, cheap enough to run on every slot
+    bestSlot, bestDiff = -1, None
+    for slot, slotImg in enumerate(slotImgList):
+        if(slotImg is None):
+            continue
+        diff = 0.0
+        for i, img in enumerate(currImgList):
+            diff += np.mean(np.abs(img[::4, ::4].astype(int) - slotImg[i][::4, ::4].astype(int)))
+        if(bestDiff is None or diff < bestDiff):
+            bestSlot, bestDiff = slot, diff
+    return bestSlot
+
+def applyBestFilter(currImgList, prevFullImgList, prevImgList, dropThreshold, slotImgList = None):
     assert len(currImgList) == 2
     assert prevFullImgList is None or len(prevFullImgList) == 2
     assert prevImgList is None or len(prevImgList) == 2
@@ -86,6 +163,7 @@ def applyBestFilter(currImgList, prevFullImgList, prevImgList, dropThreshold):
     bestResult = []
     bestSize = -1
     bestMethod = REFERENCE_NONE
+    bestSlot = 0
     # full
     for img in currImgList:
         bestResult.append(applyBestIntraCompression(img, dropThreshold, -1))
@@ -119,6 +197,22 @@ def applyBestFilter(currImgList, prevFullImgList, prevImgList, dropThreshold):
             bestMethod = REFERENCE_PREV
         report.do("Prev: intra %s, size %d" % (str([intraFilterMethodStr[x["intraMethod"]] for x in resultList]), size))
         del resultList, size
+
+    # long-term, only the closest slot is tried
+    slot = findClosestSlot(currImgList, slotImgList) if slotImgList else -1
+    if(slot >= 0):
+        resultList = []
+        size = 0
+        for i, img in enumerate(currImgList):
+            resultList.append(applyDeltaCompression(img, slotImgList[slot][i], dropThreshold, -1))
+            size += resultList[-1]["compressedSize"]
+        if(size < bestSize):
+            bestResult = resultList
+            bestSize = size
+            bestMethod = REFERENCE_LONGTERM
+            bestSlot = slot
+        report.do("LongTerm %d: intra %s, size %d" % (slot, str([intraFilterMethodStr[x["intraMethod"]] for x in resultList]), size))
+        del resultList, size
     
     report.do("Best delta method is %s" % (referenceMethodStr[bestMethod]))
     
@@ -126,6 +220,7 @@ def applyBestFilter(currImgList, prevFullImgList, prevImgList, dropThreshold):
         "bestResult": bestResult,
         "bestSize": bestSize,
         "deltaMethod": bestMethod,
+        "referenceSlot": bestSlot,
     }
     
 
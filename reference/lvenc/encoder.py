@@ -34,6 +34,13 @@ class Encoder:
         self.userData = np.uint64(kwargs.get("userData", 0))
 
         self.dropThreshold = int(kwargs.get("dropThreshold", 1 if self.dtype == np.uint8 else 128))
+        # delta frames leave out unchanged blocks of this size when it makes them smaller, SKIP_NONE disables it
+        self.skipBlockSize = int(kwargs.get("skipBlockSize", SKIP_BLOCK_16))
+        self.nLongTermSlot = int(kwargs.get("nLongTermSlot", 0))
+        # frames after a key frame before the next one is forced, 0 means unbounded
+        self.maxChainLength = int(kwargs.get("maxChainLength", 0))
+        # histogram distance in [0, 1] above which a frame starts a new scene, 0 disables detection
+        self.sceneCutThreshold = float(kwargs.get("sceneCutThreshold", 0.0))
 
         if(not self.dtype in (np.uint8, np.uint16)):
             raise TypeError("Only uint8 and uint16 is supported")
@@ -57,11 +64,27 @@ class Encoder:
 
         elif(self.dropThreshold > 65535):
             raise ValueError("dropThreshold for 16bit color format must be less than 65536")
+
+        if(not self.skipBlockSize in (SKIP_NONE, SKIP_BLOCK_16, SKIP_BLOCK_32)):
+            raise ValueError("Invalid skipBlockSize")
+
+        if(self.nLongTermSlot < 0 or self.nLongTermSlot > MAX_LONGTERM_SLOT):
+            raise ValueError("nLongTermSlot must be in range [0, %d]" % MAX_LONGTERM_SLOT)
+
+        if(self.maxChainLength < 0):
+            raise ValueError("maxChainLength must not be negative")
+
+        if(self.sceneCutThreshold < 0.0 or self.sceneCutThreshold > 1.0):
+            raise ValueError("sceneCutThreshold must be in range [0, 1]")
         
         self.prevImgList = None
         self.prevFullImgList = None
+        # key frames are kept in long-term slots, the least recently used slot is replaced
+        self.slotImgList = [None] * self.nLongTermSlot
+        self.slotLastUse = [-1] * self.nLongTermSlot
 
         self.nFrame = 0
+        self.chainLength = 0
 
     def __enter__(self):
         return self
@@ -77,6 +100,7 @@ class Encoder:
             mainStruct.width = self.width
             mainStruct.height = self.height
             mainStruct.nFrame = self.nFrame
+            mainStruct.nLongTermSlot = self.nLongTermSlot
             mainStruct.userData = np.uint64(self.userData)
             
             self.stream.write(mainStruct)
@@ -103,13 +127,46 @@ class Encoder:
             iHalf = 1
             imgList = [halfImg]
 
+        # a key frame is forced once the chain is at its limit or at a scene cut, without trying any delta
+        forceKeyFrame = self.maxChainLength > 0 and self.chainLength >= self.maxChainLength
+        if(forceKeyFrame):
+            report.do("Chain length limit reached")
+        elif(enccore.isSceneCut(imgList, self.prevImgList, self.sceneCutThreshold)):
+            report.do("Scene cut")
+            forceKeyFrame = True
+
+        # a frame identical to the previous one is written as a bare header
+        if(not forceKeyFrame and enccore.isRepeatFrame(imgList, self.prevImgList, self.dropThreshold)):
+            report.do("Repeat previous frame")
+            vf = VideoFrameStruct()
+            vf.vfrm = b'VFRM'
+            vf.referenceType = REFERENCE_REPEAT
+            vf.size = 0
+            with DelayedKeyboardInterrupt():
+                self.stream.write(vf)
+                self.nFrame += 1
+                self.chainLength += 1
+            report.leave()
+            return
+
         # do filter
-        result = enccore.applyBestFilter(imgList, self.prevFullImgList, self.prevImgList, self.dropThreshold)
+        if(forceKeyFrame):
+            result = enccore.applyBestFilter(imgList, None, None, self.dropThreshold)
+        else:
+            result = enccore.applyBestFilter(imgList, self.prevFullImgList, self.prevImgList, self.dropThreshold, self.slotImgList)
 
         # serialize and compress
         vf = VideoFrameStruct()
         vf.vfrm = b'VFRM'
         vf.referenceType = result["deltaMethod"]
+        if(result["deltaMethod"] == REFERENCE_LONGTERM):
+            vf.referenceSlot = result["referenceSlot"]
+            self.slotLastUse[vf.referenceSlot] = self.nFrame
+        storeSlot = -1
+        if(result["deltaMethod"] == REFERENCE_NONE and self.nLongTermSlot > 0):
+            storeSlot = int(np.argmin(self.slotLastUse))
+            vf.storeSlotMask = 1 << storeSlot
+            self.slotLastUse[storeSlot] = self.nFrame
         if(fullImg is not None):
             vf.intraMethod[0] = result["bestResult"][iFull]["intraMethod"]
         if(halfImg is not None):
@@ -122,17 +179,34 @@ class Encoder:
         
         # write
         data = clz4.LZ4CompressionTask(data.getvalue(), clz4.COMPRESS_MODE_HC, _LZ4_COMPRESSION_LEVEL).get()
+        if(result["deltaMethod"] != REFERENCE_NONE and self.skipBlockSize != SKIP_NONE):
+            skipResult = enccore.applySkipMap(result["bestResult"], self.skipBlockSize)
+            if(skipResult is not None):
+                skipData = clz4.LZ4CompressionTask(skipResult["data"], clz4.COMPRESS_MODE_HC, _LZ4_COMPRESSION_LEVEL).get()
+                if(len(skipData) < len(data)):
+                    report.do("Skip map: %d blocks unchanged, size %d" % (skipResult["skippedCount"], len(skipData)))
+                    data = skipData
+                    vf.skipBlockSize = self.skipBlockSize
+                    if(fullImg is not None):
+                        vf.intraMethod[0] = skipResult["intraMethod"][iFull]
+                    if(halfImg is not None):
+                        vf.intraMethod[1] = skipResult["intraMethod"][iHalf]
+                del skipData
+            del skipResult
         vf.size = len(data)
         with DelayedKeyboardInterrupt():
             self.stream.write(vf)
             self.stream.write(data)
             self.nFrame += 1
+            self.chainLength = 0 if result["deltaMethod"] == REFERENCE_NONE else self.chainLength + 1
 
         self.prevImgList = []
         for channelResult in result["bestResult"]:
             self.prevImgList.append(channelResult["decompressed"])
         if(result["deltaMethod"] == REFERENCE_NONE):
             self.prevFullImgList = self.prevImgList
+        if(storeSlot >= 0):
+            self.slotImgList[storeSlot] = self.prevImgList
 
         # clean up
         report.leave()
\ No newline at end of file
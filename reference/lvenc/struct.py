@@ -10,7 +10,8 @@ class MainStruct(ctypes.Structure):
         ("width", ctypes.c_uint32),
         ("height", ctypes.c_uint32),
         ("nFrame", ctypes.c_uint32),
-        ("_reserved_0", ctypes.c_char * 4),
+        ("nLongTermSlot", ctypes.c_uint8),
+        ("_reserved_0", ctypes.c_char * 3),
         ("userData", ctypes.c_uint64),
     ]
 
@@ -19,7 +20,10 @@ class VideoFrameStruct(ctypes.Structure):
         ("vfrm", ctypes.c_char * 4),
         ("referenceType", ctypes.c_uint8),
         ("intraMethod", ctypes.c_uint8 * 2),
-        ("_reserved_0", ctypes.c_char * 5),
+        ("referenceSlot", ctypes.c_uint8),
+        ("storeSlotMask", ctypes.c_uint8),
+        ("_reserved_0", ctypes.c_char * 2),
+        ("skipBlockSize", ctypes.c_uint8),
         ("size", ctypes.c_uint32),
     ]
 
@@ -47,7 +51,35 @@ class VideoFrameStructASTCSeq(ctypes.Structure):
 REFERENCE_NONE = 0x0
 REFERENCE_PREVFULL = 0x1
 REFERENCE_PREV = 0x2
-referenceMethodStr = ("REFERENCE_NONE", "REFERENCE_PREVFULL", "REFERENCE_PREV")
+REFERENCE_REPEAT = 0x3
+REFERENCE_LONGTERM = 0x4
+referenceMethodStr = ("REFERENCE_NONE", "REFERENCE_PREVFULL", "REFERENCE_PREV", "REFERENCE_REPEAT", "REFERENCE_LONGTERM")
+
+MAX_LONGTERM_SLOT = 4
+
+SKIP_NONE = 0x0
+SKIP_BLOCK_16 = 0x1
+SKIP_BLOCK_32 = 0x2
+skipBlockSizeStr = ("SKIP_NONE", "SKIP_BLOCK_16", "SKIP_BLOCK_32")
+
+def iterSkipBlocks(shapeList, skipBlockSize):
+    # yields every block in raster order with its (y0, y1, x0, x1) in each image, half size images get half of the full size block
+    h, w = shapeList[0][:2]
+    length = 8 << skipBlockSize
+    nBlockX, nBlockY = (w + length - 1) // length, (h + length - 1) // length
+    def _map(begin, end, size, imgSize):
+        if(imgSize == size):
+            return begin, end
+        return min(imgSize, begin // 2), (imgSize if end == size else min(imgSize, end // 2))
+    for by in range(nBlockY):
+        for bx in range(nBlockX):
+            y0, y1 = by * length, min(h, (by + 1) * length)
+            x0, x1 = bx * length, min(w, (bx + 1) * length)
+            yield (by * nBlockX + bx, [(*_map(y0, y1, h, shape[0]), *_map(x0, x1, w, shape[1])) for shape in shapeList])
+
+def getSkipBitmapSize(width, height, skipBlockSize):
+    length = 8 << skipBlockSize
+    return (((width + length - 1) // length) * ((height + length - 1) // length) + 7) // 8
 
 FILTER_NONE = 0x00
 FILTER_SUBTOP = 0x01
@@ -23,11 +23,11 @@ def main():
             halfHeight = max(1, enc.height // 2)
             for path in inputFileList[2048:2048+16]:
                 print(path)
-                y, u, v = lvenc.RGBIToYUVP(cv2.imread(path)[:, :, (2, 1, 0)])
+                y, u, v = lvenc.RGBIToYUV420P(cv2.imread(path)[:, :, (2, 1, 0)])
                 fImg = y.reshape(h, w, 1)
                 hImg = np.zeros((halfHeight, halfWidth, 2), dtype = np.uint8)
-                hImg[:,:,0] = cv2.resize(u, (halfWidth, halfHeight), cv2.INTER_AREA)
-                hImg[:,:,1] = cv2.resize(v, (halfWidth, halfHeight), cv2.INTER_AREA)
+                hImg[:,:,0] = u
+                hImg[:,:,1] = v
                 enc.feedFrame(fImg, hImg)
 #profile.run("main()")
 main()